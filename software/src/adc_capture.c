@@ -0,0 +1,134 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * adc_capture.c: Raw ADC sample capture for debugging
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "adc_capture.h"
+
+#include <string.h>
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/utility/util_definitions.h"
+
+#include "evse.h"
+#include "iec61851.h"
+
+// The capture buffer records every CP and PP conversion of the ADS1118 task
+// together with the resistance, duty cycle and state it resulted in. Conversions
+// that are ignored by the settle detection and the high rate conversions before
+// the decimation are recorded too, they are marked by the flags.
+// On a trigger (IEC61851 state change or on demand) the configured number of
+// post-trigger samples is recorded and the buffer is frozen until it is re-armed.
+// Adding a sample is O(1) and only writes to the static buffer.
+
+ADCCapture adc_capture;
+
+void adc_capture_add(const uint8_t channel, const uint16_t adc_value, const uint32_t resistance, const uint8_t flags) {
+	if(adc_capture.state == ADC_CAPTURE_STATE_DONE) {
+		return;
+	}
+
+	ADCCaptureSample *sample = &adc_capture.samples[adc_capture.index];
+	sample->time             = system_timer_get_ms();
+	sample->adc_value        = adc_value;
+	sample->resistance       = MIN(0xFFFF, resistance);
+	sample->duty_cycle       = evse_get_cp_duty_cycle();
+	sample->channel          = channel;
+	sample->iec61851_state   = iec61851.state;
+	sample->flags            = flags;
+
+	adc_capture.index = (adc_capture.index + 1) & ADC_CAPTURE_SAMPLES_MASK;
+	if(adc_capture.count < ADC_CAPTURE_SAMPLES_NUM) {
+		adc_capture.count++;
+	}
+
+	if(adc_capture.state == ADC_CAPTURE_STATE_TRIGGERED) {
+		if(adc_capture.post_trigger_remaining > 0) {
+			adc_capture.post_trigger_remaining--;
+		}
+		if(adc_capture.post_trigger_remaining == 0) {
+			adc_capture.state = ADC_CAPTURE_STATE_DONE;
+		}
+	}
+}
+
+void adc_capture_arm(void) {
+	adc_capture.index                  = 0;
+	adc_capture.count                  = 0;
+	adc_capture.trigger_time           = 0;
+	adc_capture.post_trigger_remaining = 0;
+	adc_capture.state                  = ADC_CAPTURE_STATE_RUNNING;
+}
+
+void adc_capture_trigger(void) {
+	if(adc_capture.state != ADC_CAPTURE_STATE_RUNNING) {
+		return;
+	}
+
+	adc_capture.trigger_time           = system_timer_get_ms();
+	adc_capture.post_trigger_remaining = adc_capture.post_trigger_samples;
+	adc_capture.state                  = (adc_capture.post_trigger_samples == 0) ? ADC_CAPTURE_STATE_DONE : ADC_CAPTURE_STATE_TRIGGERED;
+}
+
+void adc_capture_handle_state_change(void) {
+	if(adc_capture.trigger_on_state_change) {
+		adc_capture_trigger();
+	}
+}
+
+// The data can only be read out after the capture is done,
+// otherwise the buffer would change between two chunks.
+uint16_t adc_capture_get_length(void) {
+	if(adc_capture.state != ADC_CAPTURE_STATE_DONE) {
+		return 0;
+	}
+
+	return adc_capture.count*sizeof(ADCCaptureSample);
+}
+
+// Copy ADC_CAPTURE_CHUNK_SIZE bytes starting at byte offset (oldest sample first),
+// bytes after the end of the capture are filled with 0.
+void adc_capture_read(const uint16_t offset, uint8_t *data) {
+	memset(data, 0, ADC_CAPTURE_CHUNK_SIZE);
+
+	const uint16_t length = adc_capture_get_length();
+	if(offset >= length) {
+		return;
+	}
+
+	const uint16_t to_copy = MIN(ADC_CAPTURE_CHUNK_SIZE, length - offset);
+	const uint8_t oldest   = (adc_capture.index - adc_capture.count) & ADC_CAPTURE_SAMPLES_MASK;
+	uint8_t sample_index   = (oldest + offset/sizeof(ADCCaptureSample)) & ADC_CAPTURE_SAMPLES_MASK;
+	uint8_t byte_index     = offset % sizeof(ADCCaptureSample);
+
+	for(uint16_t i = 0; i < to_copy; i++) {
+		data[i] = ((const uint8_t*)&adc_capture.samples[sample_index])[byte_index];
+		byte_index++;
+		if(byte_index == sizeof(ADCCaptureSample)) {
+			byte_index   = 0;
+			sample_index = (sample_index + 1) & ADC_CAPTURE_SAMPLES_MASK;
+		}
+	}
+}
+
+void adc_capture_init(void) {
+	memset(&adc_capture, 0, sizeof(ADCCapture));
+	adc_capture.post_trigger_samples = ADC_CAPTURE_SAMPLES_NUM/2;
+	adc_capture_arm();
+}
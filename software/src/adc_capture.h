@@ -0,0 +1,75 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * adc_capture.h: Raw ADC sample capture for debugging
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef ADC_CAPTURE_H
+#define ADC_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ADC_CAPTURE_SAMPLES_NUM  128 // Has to be power of 2
+#define ADC_CAPTURE_SAMPLES_MASK (ADC_CAPTURE_SAMPLES_NUM - 1)
+#define ADC_CAPTURE_CHUNK_SIZE   60
+
+typedef enum {
+    ADC_CAPTURE_STATE_RUNNING = 0,   // Pre-trigger, the oldest samples are overwritten
+    ADC_CAPTURE_STATE_TRIGGERED = 1, // Recording the post-trigger samples
+    ADC_CAPTURE_STATE_DONE = 2,      // Buffer is frozen and can be read out
+} ADCCaptureState;
+
+#define ADC_CAPTURE_FLAG_REJECTED        (1 << 0) // Ignored by the settle detection, no resistance
+#define ADC_CAPTURE_FLAG_DECIMATOR_INPUT (1 << 1) // High rate CP conversion before decimation, no resistance
+#define ADC_CAPTURE_FLAG_DECIMATED       (1 << 2) // adc_value is the output of the CP decimation
+
+typedef struct {
+    uint32_t time;           // system timer in ms
+    uint16_t adc_value;      // ADS1118 conversion result (decimator output if ADC_CAPTURE_FLAG_DECIMATED)
+    uint16_t resistance;     // Resistance derived from this sample (not averaged), saturated to 0xFFFF, 0 if there is none
+    uint16_t duty_cycle;     // CP PWM duty cycle in 1/10 %
+    uint8_t  channel;        // ADS1118_CHANNEL_CP or ADS1118_CHANNEL_PP
+    uint8_t  iec61851_state;
+    uint8_t  flags;          // ADC_CAPTURE_FLAG_*
+} __attribute__((__packed__)) ADCCaptureSample;
+
+typedef struct {
+    ADCCaptureSample samples[ADC_CAPTURE_SAMPLES_NUM];
+    uint8_t index; // Next sample is written here
+    uint8_t count; // Number of valid samples
+
+    ADCCaptureState state;
+    uint32_t trigger_time;
+    uint8_t post_trigger_remaining;
+
+    bool trigger_on_state_change;
+    uint8_t post_trigger_samples;
+} ADCCapture;
+
+extern ADCCapture adc_capture;
+
+void adc_capture_init(void);
+void adc_capture_add(const uint8_t channel, const uint16_t adc_value, const uint32_t resistance, const uint8_t flags);
+void adc_capture_arm(void);
+void adc_capture_trigger(void);
+void adc_capture_handle_state_change(void);
+uint16_t adc_capture_get_length(void);
+void adc_capture_read(const uint16_t offset, uint8_t *data);
+
+#endif
@@ -22,21 +22,30 @@
 #include "ads1118.h"
 #include "configs/config_ads1118.h"
 
-#include <stdlib.h>
+#include <string.h>
 
 #include "bricklib2/utility/util_definitions.h"
 #include "bricklib2/utility/moving_average.h"
 #include "bricklib2/os/coop_task.h"
 #include "bricklib2/logging/logging.h"
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/hal/ccu4_pwm/ccu4_pwm.h"
 
 #define ADS1118_MOVING_AVERAGE_LENGTH 4
 #define ADS1118_CONFIGURE_TIMEOUT 200
 
+// Data rate and decimation for high rate measurement mode
+#define ADS1118_CP_HIGH_RATE_DATA_RATE ADS1118_CONFIG_DATA_RATE_860SPS
+#define ADS1118_CP_DECIMATION_SHIFT    3
+#define ADS1118_CP_DECIMATION_FACTOR   (1 << ADS1118_CP_DECIMATION_SHIFT)
+
 #include "configs/config_evse.h"
+#include "xmc_ccu4.h"
 
 #include "evse.h"
 #include "iec61851.h"
 #include "button.h"
+#include "adc_capture.h"
 
 CoopTask ads1118_task;
 ADS1118 ads1118;
@@ -75,66 +84,224 @@ static void ads1118_init_spi(void) {
 	spi_fifo_init(&ads1118.spi_fifo);
 }
 
-// channel 0 = measure CP
-// channel 1 = measure PP
-// channel 2 = measure temperature
-uint8_t *ads1118_get_config_for_mosi(const uint8_t channel, const bool normal) {
-	static uint8_t mosi[2] = {0, 0};
-
-	uint16_t config = 0;
-	if(normal) { // normal loop
-		config = ADS1118_CONFIG_SINGLE_SHOT | ADS1118_CONFIG_POWER_DOWN | ADS1118_CONFIG_GAIN_4_096V | ADS1118_CONFIG_DATA_RATE_8SPS  | ADS1118_CONFIG_PULL_UP_ENABLE | ADS1118_CONFIG_NOP;
-	} else { // fast loop
-		config = /* continous mode */                                     ADS1118_CONFIG_GAIN_4_096V | ADS1118_CONFIG_DATA_RATE_32SPS | ADS1118_CONFIG_PULL_UP_ENABLE | ADS1118_CONFIG_NOP;
-	}
+#define ADS1118_CONFIG_LOOP_NORMAL    (ADS1118_CONFIG_SINGLE_SHOT | ADS1118_CONFIG_POWER_DOWN | ADS1118_CONFIG_GAIN_4_096V | ADS1118_CONFIG_DATA_RATE_8SPS  | ADS1118_CONFIG_PULL_UP_ENABLE | ADS1118_CONFIG_NOP)
+#define ADS1118_CONFIG_LOOP_FAST      (/* continous mode */                                     ADS1118_CONFIG_GAIN_4_096V | ADS1118_CONFIG_DATA_RATE_32SPS | ADS1118_CONFIG_PULL_UP_ENABLE | ADS1118_CONFIG_NOP)
+#define ADS1118_CONFIG_LOOP_SYNC      (ADS1118_CONFIG_SINGLE_SHOT | ADS1118_CONFIG_POWER_DOWN | ADS1118_CONFIG_GAIN_4_096V | ADS1118_CONFIG_DATA_RATE_32SPS | ADS1118_CONFIG_PULL_UP_ENABLE | ADS1118_CONFIG_NOP)
+#define ADS1118_CONFIG_LOOP_HIGH_RATE (/* continous mode */                                     ADS1118_CONFIG_GAIN_4_096V | ADS1118_CP_HIGH_RATE_DATA_RATE     | ADS1118_CONFIG_PULL_UP_ENABLE | ADS1118_CONFIG_NOP)
+
+// Version testing is done by measuring between IN1 and GND on all hardware versions
+#define ADS1118_CONFIG_CHANNELS_V14(loop) { \
+	[ADS1118_CHANNEL_CP]          = (loop) | ADS1118_CONFIG_INP_IS_IN0_AND_INN_IS_IN3, \
+	[ADS1118_CHANNEL_PP]          = (loop) | ADS1118_CONFIG_INP_IS_IN2_AND_INN_IS_IN3, \
+	[ADS1118_CHANNEL_TEMPERATURE] = (loop) | ADS1118_CONFIG_TEMPERATURE_MODE, \
+	[ADS1118_CHANNEL_VERSION]     = (loop) | ADS1118_CONFIG_INP_IS_IN1_AND_INN_IS_GND, \
+}
 
-	if(channel == 3) { 
-		// We use channel 3 for version testing, version testing is done by measuring between IN1 and GND
-		config |= ADS1118_CONFIG_INP_IS_IN1_AND_INN_IS_GND;
-	} else {
-		if(ads1118.is_v15) {
-			switch(channel) {
-				case 0: config |= ADS1118_CONFIG_INP_IS_IN1_AND_INN_IS_GND; break;
-				case 1: config |= ADS1118_CONFIG_INP_IS_IN2_AND_INN_IS_IN3; break;
-				case 2: config |= ADS1118_CONFIG_TEMPERATURE_MODE;          break;
-				default: break;
-			}
-		} else {
-			switch(channel) {
-				case 0: config |= ADS1118_CONFIG_INP_IS_IN0_AND_INN_IS_IN3; break;
-				case 1: config |= ADS1118_CONFIG_INP_IS_IN2_AND_INN_IS_IN3; break;
-				case 2: config |= ADS1118_CONFIG_TEMPERATURE_MODE;          break;
-				default: break;
-			}
-		}
-	}
+#define ADS1118_CONFIG_CHANNELS_V15(loop) { \
+	[ADS1118_CHANNEL_CP]          = (loop) | ADS1118_CONFIG_INP_IS_IN1_AND_INN_IS_GND, \
+	[ADS1118_CHANNEL_PP]          = (loop) | ADS1118_CONFIG_INP_IS_IN2_AND_INN_IS_IN3, \
+	[ADS1118_CHANNEL_TEMPERATURE] = (loop) | ADS1118_CONFIG_TEMPERATURE_MODE, \
+	[ADS1118_CHANNEL_VERSION]     = (loop) | ADS1118_CONFIG_INP_IS_IN1_AND_INN_IS_GND, \
+}
 
+// ADS1118 config words for [hardware version][loop][channel].
+// The loop is ADS1118_LOOP_NORMAL or ADS1118_LOOP_FAST + ADS1118CPMeasurementMode.
+// The schedules get a pointer to their row in ads1118_schedule_update,
+// so there is no config assembly or version check per sample.
+static const uint16_t ads1118_config_table[ADS1118_HARDWARE_VERSION_NUM][ADS1118_CONFIG_LOOP_NUM][ADS1118_CHANNEL_NUM] = {
+	[ADS1118_HARDWARE_VERSION_V14] = {
+		ADS1118_CONFIG_CHANNELS_V14(ADS1118_CONFIG_LOOP_NORMAL),
+		ADS1118_CONFIG_CHANNELS_V14(ADS1118_CONFIG_LOOP_FAST),
+		ADS1118_CONFIG_CHANNELS_V14(ADS1118_CONFIG_LOOP_SYNC),
+		ADS1118_CONFIG_CHANNELS_V14(ADS1118_CONFIG_LOOP_HIGH_RATE),
+	},
+	[ADS1118_HARDWARE_VERSION_V15] = {
+		ADS1118_CONFIG_CHANNELS_V15(ADS1118_CONFIG_LOOP_NORMAL),
+		ADS1118_CONFIG_CHANNELS_V15(ADS1118_CONFIG_LOOP_FAST),
+		ADS1118_CONFIG_CHANNELS_V15(ADS1118_CONFIG_LOOP_SYNC),
+		ADS1118_CONFIG_CHANNELS_V15(ADS1118_CONFIG_LOOP_HIGH_RATE),
+	},
+};
+
+static inline void ads1118_config_to_mosi(const uint16_t config, uint8_t *mosi) {
 	mosi[0] = (config >> 8) & 0xFF;
 	mosi[1] = (config >> 0) & 0xFF;
-	return mosi;
 }
 
 void ads1118_cp_adc_avg_queue_add(uint16_t value) {
+	const uint16_t old_value = ads1118.cp_adc_avg_queue[ads1118.cp_adc_avg_queue_pos];
 	ads1118.cp_adc_avg_queue[ads1118.cp_adc_avg_queue_pos] = value;
 	ads1118.cp_adc_avg_queue_pos = (ads1118.cp_adc_avg_queue_pos + 1) % ADS1118_CP_ADC_AVG_NUM;
-}
 
-int ads1118_sort_compare( const void* a, const void* b) {
-   uint16_t int_a = *((uint16_t*)a);
-   uint16_t int_b = *((uint16_t*)b);
+	// Keep the sorted copy of the queue up to date:
+	// Find the evicted value and move the new value from there to its sorted position.
+	uint8_t i = 0;
+	while((i < ADS1118_CP_ADC_AVG_NUM-1) && (ads1118.cp_adc_avg_sorted[i] != old_value)) {
+		i++;
+	}
 
-   return (int_a > int_b) - (int_a < int_b);
+	if(value > old_value) {
+		while((i < ADS1118_CP_ADC_AVG_NUM-1) && (ads1118.cp_adc_avg_sorted[i+1] < value)) {
+			ads1118.cp_adc_avg_sorted[i] = ads1118.cp_adc_avg_sorted[i+1];
+			i++;
+		}
+	} else {
+		while((i > 0) && (ads1118.cp_adc_avg_sorted[i-1] > value)) {
+			ads1118.cp_adc_avg_sorted[i] = ads1118.cp_adc_avg_sorted[i-1];
+			i--;
+		}
+	}
+	ads1118.cp_adc_avg_sorted[i] = value;
 }
 
 uint16_t ads1118_cp_adc_avg_queue_get(void) {
-	uint16_t tmp[ADS1118_CP_ADC_AVG_NUM];
-	memcpy(tmp, ads1118.cp_adc_avg_queue, sizeof(uint16_t)*ADS1118_CP_ADC_AVG_NUM);
+	// Return the value at 1/3 above the median
+	return ads1118.cp_adc_avg_sorted[ADS1118_CP_ADC_AVG_NUM*2/3];
+}
 
-	// Sort the queue
-	qsort(tmp, ADS1118_CP_ADC_AVG_NUM, sizeof(uint16_t), ads1118_sort_compare);
+// Upper 32 bit of the 64 bit product. The Cortex-M0 only has a 32x32->32 bit multiply,
+// this is done with four 16x16 bit multiplies instead of a call to __aeabi_lmul.
+static inline uint32_t ads1118_mulhi_u32(const uint32_t a, const uint32_t b) {
+	const uint32_t a_lo = a & 0xFFFF;
+	const uint32_t a_hi = a >> 16;
+	const uint32_t b_lo = b & 0xFFFF;
+	const uint32_t b_hi = b >> 16;
 
-	// Return the value at 1/3 above the median
-	return tmp[ADS1118_CP_ADC_AVG_NUM*2/3];
+	const uint32_t lo_lo = a_lo*b_lo;
+	const uint32_t hi_lo = a_hi*b_lo;
+	const uint32_t lo_hi = a_lo*b_hi;
+	const uint32_t cross = (lo_lo >> 16) + (hi_lo & 0xFFFF) + lo_hi;
+
+	return a_hi*b_hi + (hi_lo >> 16) + (cross >> 16);
+}
+
+// Division by an invariant integer (Granlund/Montgomery, round-up variant as in libdivide).
+// The magic number is calculated once, afterwards every division is exact for all 32 bit
+// numerators and only needs a multiply and shifts.
+void ads1118_divider_init(ADS1118Divider *divider, const uint16_t divisor) {
+	uint8_t log2 = 0;
+	while((divisor >> (log2 + 1)) != 0) {
+		log2++;
+	}
+
+	if((divisor & (divisor - 1)) == 0) {
+		divider->magic = 0;
+		divider->shift = log2;
+		divider->add   = false;
+		return;
+	}
+
+	// magic = 2^(32+log2)/divisor, long division with 32 bit remainder (divisor < 2^16)
+	uint32_t magic     = 0;
+	uint32_t remainder = 1 << log2;
+	for(uint8_t i = 0; i < 32; i++) {
+		remainder <<= 1;
+		magic     <<= 1;
+		if(remainder >= divisor) {
+			remainder -= divisor;
+			magic     |= 1;
+		}
+	}
+
+	if((divisor - remainder) < (1u << log2)) {
+		divider->add = false;
+	} else {
+		// Magic number needs 33 bit, the 33th bit is added in ads1118_divide_u32
+		magic += magic;
+		if(remainder*2 >= divisor) {
+			magic++;
+		}
+		divider->add = true;
+	}
+
+	divider->magic = magic + 1;
+	divider->shift = log2;
+}
+
+static inline uint32_t ads1118_divide_u32(const uint32_t numerator, const ADS1118Divider *divider) {
+	if(divider->magic == 0) {
+		return numerator >> divider->shift;
+	}
+
+	const uint32_t q = ads1118_mulhi_u32(divider->magic, numerator);
+	if(divider->add) {
+		return (((numerator - q) >> 1) + q) >> divider->shift;
+	}
+
+	return q >> divider->shift;
+}
+
+// Same result as numerator/divisor (rounded towards zero)
+int32_t ads1118_divide(const int32_t numerator, const ADS1118Divider *divider) {
+	if(numerator < 0) {
+		return -(int32_t)ads1118_divide_u32(-(uint32_t)numerator, divider);
+	}
+
+	return ads1118_divide_u32(numerator, divider);
+}
+
+// ads1118_divider_init(&divider, 31643-6574)
+static const ADS1118Divider ads1118_cp_adc_divider = {
+	.magic = 0xA74F7549,
+	.shift = 14,
+	.add   = false
+};
+
+// 0.8217V => -12V
+// 3.9554V =>  12V
+// 1 LSB = 125uV
+// ===>
+// 6574 LSB  => -12V
+// 31643 LSB =>  12V
+// Same result as SCALE(adc_value, 6574, 31643, -12000, 12000)
+int16_t ads1118_cp_voltage_from_adc(const uint16_t adc_value) {
+	return ads1118_divide((((int32_t)adc_value) - 6574)*24000, &ads1118_cp_adc_divider) - 12000;
+}
+
+// Same result as voltage*cp_cal_mul/cp_cal_div (or user calibration)
+int16_t ads1118_cp_voltage_calibrate(const int16_t voltage) {
+	return ads1118_divide(voltage*ads1118.cp_cal_context.voltage_mul, &ads1118.cp_cal_context.voltage_div);
+}
+
+// Same result as (voltage_calibrated - min_voltage)*1000/duty_cycle + min_voltage
+int16_t ads1118_cp_high_voltage(const int16_t voltage_calibrated, const int16_t min_voltage) {
+	return ads1118_divide((voltage_calibrated - min_voltage)*1000, &ads1118.cp_cal_context.duty_cycle_div) + min_voltage;
+}
+
+// Rebuild the precomputed calibration factors.
+// This is the only place where we calculate divisors, it runs only if the calibration,
+// the CP duty cycle or the max current (880 ohm calibration index) changes.
+void ads1118_cp_cal_context_update(const uint16_t duty_cycle, const uint32_t ma) {
+	ADS1118CPCalContext *ctx = &ads1118.cp_cal_context;
+
+	int16_t mul = ads1118.cp_user_cal_active ? ads1118.cp_user_cal_mul : ads1118.cp_cal_mul;
+	int16_t div = ads1118.cp_user_cal_active ? ads1118.cp_user_cal_div : ads1118.cp_cal_div;
+	if(div == 0) {
+		mul = 1;
+		div = 1;
+	}
+
+	// The sign of the divisor is moved to the multiplier
+	ctx->voltage_mul  = (div < 0) ? -mul : mul;
+	ctx->diff_voltage = ads1118.cp_user_cal_active ? ads1118.cp_user_cal_diff_voltage : ads1118.cp_cal_diff_voltage;
+	ads1118_divider_init(&ctx->voltage_div, ABS(div));
+	ads1118_divider_init(&ctx->duty_cycle_div, MAX(duty_cycle, 1));
+
+	if(duty_cycle == 1000) { // w/o PWM
+		ctx->resistance_offset = ads1118.cp_user_cal_active ? ads1118.cp_user_cal_2700ohm : ads1118.cp_cal_2700ohm;
+	} else { // w/ PWM
+		const uint32_t index = SCALE(BETWEEN(6000, ma, 32000), 6000, 32000, 0, ADS1118_880OHM_CAL_NUM-1);
+		ctx->resistance_offset = ads1118.cp_user_cal_active ? ads1118.cp_user_cal_880ohm[index] : ads1118.cp_cal_880ohm[index];
+	}
+
+	ctx->duty_cycle = duty_cycle;
+	ctx->ma         = ma;
+	ctx->valid      = true;
+}
+
+// Has to be called whenever the calibration or user calibration changes
+void ads1118_cp_cal_context_invalidate(void) {
+	ads1118.cp_cal_context.valid = false;
 }
 
 void ads1118_cp_handle_continuous_calibration(const uint16_t adc_value) {
@@ -145,7 +312,7 @@ void ads1118_cp_handle_continuous_calibration(const uint16_t adc_value) {
 
 	// If the adc value is below 11.75V, we ignore it.
 	// We don't accept a voltage this small as max cp voltage
-	const int16_t voltage = SCALE(adc_value, 6574, 31643, -12000, 12000);
+	const int16_t voltage = ads1118_cp_voltage_from_adc(adc_value);
 	if(voltage < 11750) {
 		return;
 	}
@@ -157,7 +324,8 @@ void ads1118_cp_handle_continuous_calibration(const uint16_t adc_value) {
 			ads1118.moving_average_cp_adc_12v_new = false;
 			moving_average_init(&ads1118.moving_average_cp_adc_12v, adc_value, ADS1118_MOVING_AVERAGE_LENGTH);
 			for(uint8_t i = 0; i < ADS1118_CP_ADC_AVG_NUM; i++) {
-				ads1118.cp_adc_avg_queue[i] = adc_value;
+				ads1118.cp_adc_avg_queue[i]  = adc_value;
+				ads1118.cp_adc_avg_sorted[i] = adc_value;
 			}
 		} else {
 			moving_average_handle_value(&ads1118.moving_average_cp_adc_12v, adc_value);
@@ -173,48 +341,79 @@ void ads1118_cp_handle_continuous_calibration(const uint16_t adc_value) {
 		adc_max_value_avg = ads1118_cp_adc_avg_queue_get();
 
 		// The voltage in the queue is the continuous calibrated max voltage (ADC value),
-		int16_t voltage = SCALE(adc_max_value_avg, 6574, 31643, -12000, 12000);
+		const int16_t voltage_max = ads1118_cp_voltage_from_adc(adc_max_value_avg);
 
 		// Apply additional ADC calibration
-		if(ads1118.cp_user_cal_active) {
-			ads1118.cp_cal_max_voltage = voltage * ads1118.cp_user_cal_mul / ads1118.cp_user_cal_div;
-		} else {
-			ads1118.cp_cal_max_voltage = voltage * ads1118.cp_cal_mul / ads1118.cp_cal_div;
-		}
+		ads1118.cp_cal_max_voltage = ads1118_cp_voltage_calibrate(voltage_max);
 
 		// For the min voltage we use a fixed difference that is calibrated on intial flashing
-		if(ads1118.cp_user_cal_active) {
-			ads1118.cp_cal_min_voltage = -ads1118.cp_cal_max_voltage + ads1118.cp_user_cal_diff_voltage;
-		} else {
-			ads1118.cp_cal_min_voltage = -ads1118.cp_cal_max_voltage + ads1118.cp_cal_diff_voltage;
-		}
+		ads1118.cp_cal_min_voltage = -ads1118.cp_cal_max_voltage + ads1118.cp_cal_context.diff_voltage;
 	}
 }
 
-void ads1118_cp_voltage_from_miso(const uint8_t *miso) {
-	ads1118.cp_adc_value = (miso[1] | (miso[0] << 8));
+// In the PWM synchronous mode the conversion starts after the 16 bit config transfer
+// (CP PWM timer runs with EVSE_CP_PWM_PERIOD*1000 ticks per second)
+#define ADS1118_PWM_SYNC_START_TICKS (16*(EVSE_CP_PWM_PERIOD*1000/ADS1118_SPI_BAUDRATE))
+
+// CP PWM high time in [0, timer) of a period.
+// The output is high from the compare value to the end of the period.
+static inline uint32_t ads1118_pwm_sync_high_ticks(const uint32_t timer, const uint32_t compare) {
+	return (timer > compare) ? (timer - compare) : 0;
+}
+
+// High voltage from the measured integration window of a PWM synchronous conversion.
+// Returns false if the window is unknown or there is no high time.
+// The window changes with every conversion, so this needs a division per sample.
+static bool ads1118_pwm_sync_high_voltage(const int16_t voltage_calibrated, const int16_t min_voltage, int16_t *high_voltage) {
+	if(!ads1118.pwm_sync_window_valid) {
+		return false;
+	}
+
+	const uint32_t compare = MIN(ccu4_pwm_get_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER), EVSE_CP_PWM_PERIOD);
+	const uint32_t periods = ads1118.pwm_sync_window_periods;
+	const uint32_t end     = ads1118.pwm_sync_window_end_timer;
+
+	const uint32_t window_ticks = periods*EVSE_CP_PWM_PERIOD + end - ADS1118_PWM_SYNC_START_TICKS;
+	const uint32_t high_ticks   = periods*(EVSE_CP_PWM_PERIOD - compare)
+	                            + ads1118_pwm_sync_high_ticks(end, compare)
+	                            - ads1118_pwm_sync_high_ticks(ADS1118_PWM_SYNC_START_TICKS, compare);
+
+	// Window and high time in 1/64 ticks (ticks >> 6), the product with the voltage has to fit in 32 bit
+	const uint32_t window_div64 = window_ticks >> 6;
+	const uint32_t high_div64   = high_ticks >> 6;
+	if((window_div64 > 0xFFFF) || (high_div64 == 0) || (high_div64 > window_div64)) {
+		return false;
+	}
+
+	const int32_t diff = voltage_calibrated - min_voltage;
+	const int32_t high = (int32_t)(ABS(diff)*window_div64/high_div64);
+	*high_voltage = ((diff < 0) ? -high : high) + min_voltage;
+	return true;
+}
+
+void ads1118_cp_voltage_from_adc_value(const uint16_t adc_value) {
+	const uint16_t current_cp_duty_cycle = evse_get_cp_duty_cycle();
+	const uint32_t ma = (current_cp_duty_cycle == 1000) ? 0 : iec61851_get_max_ma();
+	if(!ads1118.cp_cal_context.valid || (ads1118.cp_cal_context.duty_cycle != current_cp_duty_cycle) || (ads1118.cp_cal_context.ma != ma)) {
+		ads1118_cp_cal_context_update(current_cp_duty_cycle, ma);
+	}
+
+	ads1118.cp_adc_value = adc_value;
 	ads1118_cp_handle_continuous_calibration(ads1118.cp_adc_value);
 
 	// adc_sum and adc_sum_count is used during calibration and otherwise ignored
     ads1118.cp_adc_sum += ads1118.cp_adc_value;
     ads1118.cp_adc_sum_count++;
 
-	// 0.8217V => -12V
-	// 3.9554V =>  12V
-	// 1 LSB = 125uV
-	// ===>
-	// 6574 LSB  => -12V
-	// 31643 LSB =>  12V
-	
-	ads1118.cp_voltage = SCALE(ads1118.cp_adc_value, 6574, 31643, -12000, 12000);
-	if(ads1118.cp_user_cal_active) {
-		ads1118.cp_voltage_calibrated = ads1118.cp_voltage * ads1118.cp_user_cal_mul / ads1118.cp_user_cal_div;
-	} else {
-		ads1118.cp_voltage_calibrated = ads1118.cp_voltage * ads1118.cp_cal_mul / ads1118.cp_cal_div;
-	}
-	const uint16_t current_cp_duty_cycle = evse_get_cp_duty_cycle();
-	ads1118.cp_high_voltage = (ads1118.cp_voltage_calibrated - ads1118.cp_cal_min_voltage)*1000/current_cp_duty_cycle + ads1118.cp_cal_min_voltage;
+	ads1118.cp_voltage            = ads1118_cp_voltage_from_adc(ads1118.cp_adc_value);
+	ads1118.cp_voltage_calibrated = ads1118_cp_voltage_calibrate(ads1118.cp_voltage);
 
+	// In the PWM synchronous mode the high fraction of the integration window is measured,
+	// otherwise the whole window is assumed to have the duty cycle of the CP PWM
+	if(!ads1118_pwm_sync_high_voltage(ads1118.cp_voltage_calibrated, ads1118.cp_cal_min_voltage, &ads1118.cp_high_voltage)) {
+		ads1118.cp_high_voltage = ads1118_cp_high_voltage(ads1118.cp_voltage_calibrated, ads1118.cp_cal_min_voltage);
+	}
+	ads1118.pwm_sync_window_valid = false;
 
 	// If the measured high voltage is near the calibration max voltage
 	// we assume that there is no resistance
@@ -236,36 +435,12 @@ void ads1118_cp_voltage_from_miso(const uint8_t *miso) {
 		// resistance divider, 910 ohm on EVSE
 		// diode voltage drop 650mV (value is educated guess)
 		// voltage drop of opamp under with 880 ohm load: 617mV
-		if(current_cp_duty_cycle == 1000) { // w/o PWM
-			if(ads1118.cp_user_cal_active) {
-				if(ads1118.cp_high_voltage > (ads1118.cp_cal_max_voltage - ads1118.cp_user_cal_2700ohm)) {
-					new_resistance = 0xFFFF;
-				} else {
-					new_resistance = 910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP)/((ads1118.cp_cal_max_voltage - ads1118.cp_user_cal_2700ohm) - ads1118.cp_high_voltage);
-				}
-			} else {
-				if(ads1118.cp_high_voltage > (ads1118.cp_cal_max_voltage - ads1118.cp_cal_2700ohm)) {
-					new_resistance = 0xFFFF;
-				} else {
-					new_resistance = 910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP)/((ads1118.cp_cal_max_voltage - ads1118.cp_cal_2700ohm) - ads1118.cp_high_voltage);
-				}
-			}
-		} else { // w/ PWM
-			uint32_t ma = iec61851_get_max_ma();
-			uint32_t index = SCALE(ma, 6000, 32000, 0, ADS1118_880OHM_CAL_NUM-1);
-			if(ads1118.cp_user_cal_active) {
-				if(ads1118.cp_high_voltage > (ads1118.cp_cal_max_voltage - ads1118.cp_user_cal_880ohm[index])) {
-					new_resistance = 0xFFFF;
-				} else {
-					new_resistance = 910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP)/((ads1118.cp_cal_max_voltage - ads1118.cp_user_cal_880ohm[index])  - ads1118.cp_high_voltage);
-				}
-			} else {
-				if(ads1118.cp_high_voltage > (ads1118.cp_cal_max_voltage - ads1118.cp_cal_880ohm[index])) {
-					new_resistance = 0xFFFF;
-				} else {
-					new_resistance = 910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP)/((ads1118.cp_cal_max_voltage - ads1118.cp_cal_880ohm[index])  - ads1118.cp_high_voltage);
-				}
-			}
+		// The calibrated voltage offset for 2700 ohm (w/o PWM) or 880 ohm (w/ PWM) is taken from the calibration context.
+		const int32_t voltage_open = ads1118.cp_cal_max_voltage - ads1118.cp_cal_context.resistance_offset;
+		if(ads1118.cp_high_voltage > voltage_open) {
+			new_resistance = 0xFFFF;
+		} else {
+			new_resistance = 910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP)/(voltage_open - ads1118.cp_high_voltage);
 		}
 		new_resistance = MIN(0xFFFF, new_resistance);
 	}
@@ -277,7 +452,99 @@ void ads1118_cp_voltage_from_miso(const uint8_t *miso) {
 		moving_average_handle_value(&ads1118.moving_average_cp, new_resistance);
 	}
 
-	ads1118.cp_pe_resistance = moving_average_get(&ads1118.moving_average_cp);
+	if(!ads1118.replay_active) {
+		ads1118.cp_pe_resistance = moving_average_get(&ads1118.moving_average_cp);
+	}
+	adc_capture_add(ADS1118_CHANNEL_CP, adc_value, new_resistance, ads1118.schedule_current->decimate_cp ? ADC_CAPTURE_FLAG_DECIMATED : 0);
+
+	// Remember the first sample that shows that the car left state C while the contactor is still on.
+	// The time until the contactor is turned off is measured in evse_set_output. It is measured from
+	// the start of the integration window of the sample (the whole decimation window in high rate mode),
+	// so it includes the conversion, the decimation and the moving average before the state machine.
+	// A single sample in state C does not clear it, only ADS1118_MOVING_AVERAGE_LENGTH successive
+	// samples in state C do (the moving average is back in state C by then).
+	if(XMC_GPIO_GetInput(EVSE_RELAY_PIN) && (new_resistance > IEC61851_CP_RESISTANCE_STATE_B)) {
+		ads1118.cp_state_c_return_count = 0;
+		if(ads1118.cp_state_c_exit_time == 0) {
+			ads1118.cp_state_c_exit_time = MAX(1, ads1118.cp_sample_start_time);
+		}
+	} else if(ads1118.cp_state_c_exit_time != 0) {
+		ads1118.cp_state_c_return_count++;
+		if(ads1118.cp_state_c_return_count >= ADS1118_MOVING_AVERAGE_LENGTH) {
+			ads1118.cp_state_c_exit_time    = 0;
+			ads1118.cp_state_c_return_count = 0;
+		}
+	}
+}
+
+void ads1118_cp_voltage_from_miso(const uint8_t *miso) {
+	ads1118_cp_voltage_from_adc_value(miso[1] | (miso[0] << 8));
+}
+
+void ads1118_settle_start(ADS1118Settle *settle, const uint8_t max_samples) {
+	settle->invalid_counter = MAX(max_samples, settle->invalid_counter);
+	settle->reference_valid = false;
+	if(settle->start_time == 0) {
+		settle->start_time = MAX(1, system_timer_get_ms());
+	}
+}
+
+// Returns true if the sample has to be ignored.
+// The first sample after settle start is only used as reference, since its
+// conversion may have started before the change. After that a sample is accepted
+// as soon as it agrees with the previous one within the tolerance.
+static bool ads1118_settle_handle(ADS1118Settle *settle, const uint16_t adc_value, const uint16_t tolerance) {
+	if(settle->invalid_counter > 0) {
+		if(!settle->reference_valid || (ABS((int32_t)adc_value - (int32_t)settle->reference) > tolerance)) {
+			settle->reference       = adc_value;
+			settle->reference_valid = true;
+			settle->invalid_counter--;
+			return true;
+		}
+
+		// Settled, the upper bound would have ignored this sample and invalid_counter-1 more
+		settle->saved_samples  += settle->invalid_counter;
+		settle->invalid_counter = 0;
+		settle->reference_valid = false;
+	}
+
+	if(settle->start_time != 0) {
+		settle->last_blind_time = system_timer_get_ms() - settle->start_time;
+		settle->start_time      = 0;
+	}
+
+	return false;
+}
+
+// First order CIC (sum over ADS1118_CP_DECIMATION_FACTOR samples) for the high rate mode.
+// With 860SPS and a factor of 8 the decimated sample rate is ~107Hz and every
+// output averages over ~9.3 CP PWM periods.
+void ads1118_cp_decimate_from_miso(const uint8_t *miso) {
+	const uint16_t raw_value = miso[1] | (miso[0] << 8);
+	adc_capture_add(ADS1118_CHANNEL_CP, raw_value, 0, ADC_CAPTURE_FLAG_DECIMATOR_INPUT);
+
+	if(ads1118.cp_decimation_count == 0) {
+		ads1118.cp_decimation_start_time = ads1118.result_time;
+	}
+	ads1118.cp_decimation_sum += raw_value;
+	ads1118.cp_decimation_count++;
+
+	if(ads1118.cp_decimation_count < ADS1118_CP_DECIMATION_FACTOR) {
+		return;
+	}
+
+	const uint16_t adc_value = ads1118.cp_decimation_sum >> ADS1118_CP_DECIMATION_SHIFT;
+	ads1118.cp_decimation_sum    = 0;
+	ads1118.cp_decimation_count  = 0;
+	ads1118.cp_sample_start_time = ads1118.cp_decimation_start_time;
+
+	// The settle detection is applied to the decimated samples, this way
+	// a window that saw a contactor or PWM change is always thrown away
+	if(ads1118_settle_handle(&ads1118.cp_settle, adc_value, ADS1118_CP_SETTLE_TOLERANCE)) {
+		adc_capture_add(ADS1118_CHANNEL_CP, adc_value, 0, ADC_CAPTURE_FLAG_DECIMATED | ADC_CAPTURE_FLAG_REJECTED);
+	} else {
+		ads1118_cp_voltage_from_adc_value(adc_value);
+	}
 }
 
 void ads1118_pp_voltage_from_miso(const uint8_t *miso) {
@@ -302,170 +569,401 @@ void ads1118_pp_voltage_from_miso(const uint8_t *miso) {
 		moving_average_handle_value(&ads1118.moving_average_pp, new_resistance);
 	}
 
-	ads1118.pp_pe_resistance = moving_average_get(&ads1118.moving_average_pp);
+	if(!ads1118.replay_active) {
+		ads1118.pp_pe_resistance = moving_average_get(&ads1118.moving_average_pp);
+	}
+	adc_capture_add(ADS1118_CHANNEL_PP, ads1118.pp_adc_value, new_resistance, 0);
 }
 
-// ADS1118 runs with 8 samples per second, so each loop takes about 250ms
-uint32_t ads1118_task_normal_loop(uint32_t configure_time) {
-	const XMC_GPIO_CONFIG_t config_low = {
-		.mode         = XMC_GPIO_MODE_OUTPUT_PUSH_PULL,
-		.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
-	};
+// PWM synchronous mode:
+// The CP conversion is started by the period match IRQ of the CP PWM timer, so the
+// integration window always starts at the same point of the PWM waveform. The same
+// IRQ counts the PWM periods until DRDY, where the timer value is captured. With the
+// start and end of the window known in CP PWM timer ticks we know exactly how much of
+// the window the CP was on its high plateau, independent of the oscillator of the ADS1118.
+// The ADS1118 can't sample a plateau directly, its shortest conversion (860SPS) is longer
+// than a whole PWM period.
+
+#define ads1118_pwm_sync_irq_handler IRQ_Hdlr_21
+
+void __attribute__((optimize("-O3"))) __attribute__ ((section (".ram_code"))) ads1118_pwm_sync_irq_handler(void) {
+	if(ads1118.pwm_sync_state == ADS1118_PWM_SYNC_CONVERTING) {
+		ads1118.pwm_sync_periods++;
+	} else if(ads1118.pwm_sync_state == ADS1118_PWM_SYNC_START) {
+		// Chip select is controlled by the USIC here, ads1118_read_on_drdy waits for the start
+		spi_fifo_transceive(&ads1118.spi_fifo, 2, ads1118.pwm_sync_mosi);
+		ads1118.pwm_sync_periods = 0;
+		ads1118.pwm_sync_state   = ADS1118_PWM_SYNC_CONVERTING;
+	} else {
+		XMC_CCU4_SLICE_DisableEvent(EVSE_CP_PWM_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	}
+}
 
-	const XMC_GPIO_CONFIG_t config_select = {
-		.mode         = ADS1118_SELECT_PIN_MODE,
-		.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
-	};
+// Called from DRDY IRQ: Capture the end of the integration window
+static void __attribute__((optimize("-O3"))) __attribute__ ((section (".ram_code"))) ads1118_pwm_sync_capture(void) {
+	__disable_irq();
+	uint16_t periods     = ads1118.pwm_sync_periods;
+	const uint16_t timer = XMC_CCU4_SLICE_GetTimerValue(EVSE_CP_PWM_SLICE);
 
-	uint8_t miso[2] = {0, 0};
+	// The timer may have wrapped after the last period match IRQ was handled
+	if(NVIC_GetPendingIRQ(ADS1118_PWM_SYNC_IRQ) && (timer < EVSE_CP_PWM_PERIOD/2)) {
+		periods++;
+	}
 
-	// Wait for DRDY
-	coop_task_sleep_ms(10);
-	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
+	XMC_CCU4_SLICE_DisableEvent(EVSE_CP_PWM_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	ads1118.pwm_sync_state = ADS1118_PWM_SYNC_IDLE;
+	__enable_irq();
 
-	configure_time = system_timer_get_ms();
-	while(XMC_GPIO_GetInput(ADS1118_MISO_PORT, ADS1118_MISO_PIN)) {
-		if(system_timer_is_time_elapsed_ms(configure_time, ADS1118_CONFIGURE_TIMEOUT)) {
-			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-			spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(0, true), miso);
-			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
-			configure_time = system_timer_get_ms();
+	ads1118.pwm_sync_window_periods   = periods;
+	ads1118.pwm_sync_window_end_timer = timer;
+	ads1118.pwm_sync_window_valid     = true;
+}
+
+// The next CP PWM period match starts a conversion with the given config
+static void ads1118_pwm_sync_arm(const uint16_t config) {
+	ads1118_config_to_mosi(config, ads1118.pwm_sync_mosi);
+
+	__disable_irq();
+	ads1118.pwm_sync_state = ADS1118_PWM_SYNC_START;
+	XMC_CCU4_SLICE_ClearEvent(EVSE_CP_PWM_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	NVIC_ClearPendingIRQ(ADS1118_PWM_SYNC_IRQ);
+	XMC_CCU4_SLICE_EnableEvent(EVSE_CP_PWM_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	__enable_irq();
+}
+
+static void ads1118_pwm_sync_disarm(void) {
+	__disable_irq();
+	XMC_CCU4_SLICE_DisableEvent(EVSE_CP_PWM_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	ads1118.pwm_sync_state = ADS1118_PWM_SYNC_IDLE;
+	NVIC_ClearPendingIRQ(ADS1118_PWM_SYNC_IRQ);
+	__enable_irq();
+}
+
+// Wait until a conversion that is armed with ads1118_pwm_sync_arm is started.
+// This takes at most one PWM period (1ms) plus the config transfer.
+static void ads1118_pwm_sync_wait_for_start(void) {
+	const uint32_t start_time = system_timer_get_ms();
+	while((ads1118.pwm_sync_state == ADS1118_PWM_SYNC_START) || (spi_fifo_next_state(&ads1118.spi_fifo) == SPI_FIFO_STATE_TRANSCEIVE)) {
+		if(system_timer_is_time_elapsed_ms(start_time, ADS1118_CONFIGURE_TIMEOUT)) {
+			// Conversion is started again on DRDY timeout
+			ads1118_pwm_sync_disarm();
+			spi_fifo_init(&ads1118.spi_fifo);
+			return;
 		}
 		coop_task_yield();
 	}
-	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-	// Read CP -> Configure PP
-	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(1, true), miso);
-	if(ads1118.cp_invalid_counter > 0) {
-		ads1118.cp_invalid_counter--;
-	} else {
-		ads1118_cp_voltage_from_miso(miso);
-	}
+}
 
-	// Wait for DRDY
-	coop_task_sleep_ms(10);
-	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
+#define ads1118_drdy_irq_handler IRQ_Hdlr_5
 
-	configure_time = system_timer_get_ms();
-	while(XMC_GPIO_GetInput(ADS1118_MISO_PORT, ADS1118_MISO_PIN)) {
-		if(system_timer_is_time_elapsed_ms(configure_time, ADS1118_CONFIGURE_TIMEOUT)) {
-			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-			spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(1, true), miso);
-			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
-			configure_time = system_timer_get_ms();
-		}
-		coop_task_yield();
+// Chip select is switched between GPIO (output level is low, see ads1118_init_drdy)
+// and USIC select output by only changing the pin mode.
+#define ads1118_select_low()  XMC_GPIO_SetMode(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, XMC_GPIO_MODE_OUTPUT_PUSH_PULL)
+#define ads1118_select_usic() XMC_GPIO_SetMode(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, ADS1118_SELECT_PIN_MODE)
+
+// Called from DRDY IRQ or with IRQs disabled.
+// Gives chip select back to the USIC and starts the read of the conversion result right away.
+// The next configuration is written in the same transfer.
+static void __attribute__((optimize("-O3"))) __attribute__ ((section (".ram_code"))) ads1118_drdy_start_read(void) {
+	XMC_ERU_ETL_DisableOutputTrigger(ADS1118_DRDY_ERU, ADS1118_DRDY_ERU_ETL_CHANNEL);
+	ads1118.drdy_armed = false;
+
+	ads1118_select_usic();
+	spi_fifo_transceive(&ads1118.spi_fifo, 4, ads1118.drdy_mosi);
+}
+
+void __attribute__((optimize("-O3"))) __attribute__ ((section (".ram_code"))) ads1118_drdy_irq_handler(void) {
+	// Ignore falling edges that are caused by SPI traffic
+	if(!ads1118.drdy_armed) {
+		return;
 	}
-	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-	// Read PP -> Configure CP
-	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(0, true), miso);
-	if(ads1118.pp_invalid_counter > 0) {
-		ads1118.pp_invalid_counter--;
-	} else {
-		ads1118_pp_voltage_from_miso(miso);
+
+	if(ads1118.pwm_sync_state == ADS1118_PWM_SYNC_CONVERTING) {
+		ads1118_pwm_sync_capture();
 	}
 
-	return configure_time;
+	ads1118_drdy_start_read();
 }
 
-// ADS1118 runs with 32 samples per second, so each loop takes about 31.25ms
-uint32_t ads1118_task_fast_loop(uint32_t configure_time) {
-	const XMC_GPIO_CONFIG_t config_low = {
-		.mode         = XMC_GPIO_MODE_OUTPUT_PUSH_PULL,
-		.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
-	};
+static void ads1118_drdy_arm(void) {
+	__disable_irq();
+	ads1118.drdy_armed = true;
+	NVIC_ClearPendingIRQ(ADS1118_DRDY_IRQ);
+	XMC_ERU_ETL_EnableOutputTrigger(ADS1118_DRDY_ERU, ADS1118_DRDY_ERU_ETL_CHANNEL);
 
-	const XMC_GPIO_CONFIG_t config_select = {
-		.mode         = ADS1118_SELECT_PIN_MODE,
-		.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
-	};
+	// If DRDY is already low there will be no falling edge
+	if(!XMC_GPIO_GetInput(ADS1118_MISO_PORT, ADS1118_MISO_PIN)) {
+		ads1118_drdy_start_read();
+	}
+	__enable_irq();
+}
 
-	uint8_t miso[2] = {0, 0};
+static void ads1118_drdy_disarm(void) {
+	__disable_irq();
+	XMC_ERU_ETL_DisableOutputTrigger(ADS1118_DRDY_ERU, ADS1118_DRDY_ERU_ETL_CHANNEL);
+	ads1118.drdy_armed = false;
+	NVIC_ClearPendingIRQ(ADS1118_DRDY_IRQ);
+	__enable_irq();
+}
 
-	// Wait for DRDY
-	coop_task_sleep_ms(1);
-	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
+// Compare the config register readback with the config in drdy_mosi
+static bool ads1118_config_readback_ok(const uint16_t config_readback) {
+	const uint16_t config_written = (ads1118.drdy_mosi[0] << 8) | ads1118.drdy_mosi[1];
+	return ((config_written ^ config_readback) & ADS1118_CONFIG_READBACK_MASK) == 0;
+}
 
-	configure_time = system_timer_get_ms();
-	while(XMC_GPIO_GetInput(ADS1118_MISO_PORT, ADS1118_MISO_PIN)) {
+// Wait for DRDY of conversion on channel and read the result.
+// The ADS1118 is configured for next_channel in the same transfer.
+// We use the 32 bit transfer with config readback: The result and the
+// written config are read back in one FIFO transaction. The second config word
+// is written as 0 (NOP = 00), which is ignored by the ADS1118.
+// Returns false if no valid result could be read.
+static bool ads1118_read_on_drdy(const uint8_t channel, const uint8_t next_channel, const ADS1118Schedule *schedule, uint8_t *miso) {
+	const uint16_t next_config = schedule->configs[next_channel];
+
+	// In PWM synchronous mode the next CP conversion is not started by the read,
+	// it is started by the next CP PWM period match.
+	const bool pwm_synchronous = schedule->pwm_synchronous_cp && (next_channel == ADS1118_CHANNEL_CP);
+	ads1118_config_to_mosi(pwm_synchronous ? (next_config & ~ADS1118_CONFIG_SINGLE_SHOT) : next_config, ads1118.drdy_mosi);
+	ads1118.drdy_mosi[2] = 0;
+	ads1118.drdy_mosi[3] = 0;
+
+	// Chip select has to stay with the USIC until the conversion is started
+	ads1118_pwm_sync_wait_for_start();
+	ads1118.pwm_sync_window_valid = false;
+
+	// With chip select low, DOUT goes low as soon as the conversion is ready.
+	// The DRDY IRQ then starts the SPI transfer without waiting for the main loop.
+	ads1118_select_low();
+	ads1118_drdy_arm();
+
+	uint32_t configure_time = system_timer_get_ms();
+	while(ads1118.drdy_armed) {
 		if(system_timer_is_time_elapsed_ms(configure_time, ADS1118_CONFIGURE_TIMEOUT)) {
-			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-			spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(0, false), miso);
-			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
+			// If the configured channel is unknown we start a conversion on next_channel,
+			// the result is ignored either way.
+			uint8_t mosi[2] = {0, 0};
+			ads1118_config_to_mosi(schedule->configs[(channel < ADS1118_CHANNEL_NUM) ? channel : next_channel], mosi);
+
+			ads1118_drdy_disarm();
+			ads1118_pwm_sync_disarm();
+			ads1118_select_usic();
+			spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, mosi, miso);
+			ads1118_select_low();
+			ads1118_drdy_arm();
 			configure_time = system_timer_get_ms();
 		}
 		coop_task_yield();
 	}
-	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
 
-	// Read / Configure CP
-	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(0, false), miso);
-	if(ads1118.cp_invalid_counter > 0) {
-		ads1118.cp_invalid_counter--;
-	} else {
-		ads1118_cp_voltage_from_miso(miso);
+	// Transfer is already running, wait until it is finished
+	while(true) {
+		const SPIFifoState state = spi_fifo_next_state(&ads1118.spi_fifo);
+		if(state & SPI_FIFO_STATE_ERROR) {
+			ads1118.spi_error_count++;
+			ads1118.channel_configured = ADS1118_CHANNEL_INVALID;
+			spi_fifo_init(&ads1118.spi_fifo);
+			return false;
+		}
+
+		if(state == SPI_FIFO_STATE_TRANSCEIVE_READY) {
+			uint8_t data[4] = {0, 0, 0, 0};
+			if(spi_fifo_read_fifo(&ads1118.spi_fifo, data, 4) != 4) {
+				ads1118.spi_error_count++;
+				ads1118.channel_configured = ADS1118_CHANNEL_INVALID;
+				return false;
+			}
+
+			// If the readback does not match, the config is written once more right away.
+			// This also starts the conversion again, so we don't run into the DRDY timeout
+			// (in the PWM synchronous mode the config that is written here does not start a
+			// conversion, the conversion is started by the CP PWM period match in any case).
+			// If it still does not match we don't know which config the ADS1118 uses,
+			// the result of the next conversion is ignored in this case.
+			bool config_ok = ads1118_config_readback_ok((data[2] << 8) | data[3]);
+			if(!config_ok) {
+				ads1118.config_error_count++;
+
+				uint8_t retry[4] = {0, 0, 0, 0};
+				if(spi_fifo_coop_transceive(&ads1118.spi_fifo, 4, ads1118.drdy_mosi, retry)) {
+					config_ok = ads1118_config_readback_ok((retry[2] << 8) | retry[3]);
+				} else {
+					ads1118.spi_error_count++;
+				}
+			}
+
+			ads1118.channel_configured = config_ok ? next_channel : ADS1118_CHANNEL_INVALID;
+			if(pwm_synchronous) {
+				ads1118_pwm_sync_arm(next_config);
+			}
+
+			miso[0] = data[0];
+			miso[1] = data[1];
+			return true;
+		}
+
+		coop_task_yield();
 	}
+}
+
+// Select the channel for the next conversion.
+// The first entry is the base channel, it is measured whenever no other channel is due.
+// After a conversion of a low rate channel the next conversion is always the base channel,
+// so there is never more than one other conversion between two base channel conversions.
+static uint8_t ads1118_schedule_next_channel(ADS1118Schedule *schedule) {
+	bool due_found = false;
+	uint8_t channel = schedule->entries[0].channel;
+
+	for(uint8_t i = 1; i < schedule->num_entries; i++) {
+		ADS1118ScheduleEntry *entry = &schedule->entries[i];
+		if(entry->interval == 0) {
+			continue;
+		}
 
-	return configure_time;
+		if(entry->countdown > 0) {
+			entry->countdown--;
+		}
+
+		if(!due_found && !schedule->last_was_low_rate && (entry->countdown == 0)) {
+			entry->countdown = entry->interval;
+			channel          = entry->channel;
+			due_found        = true;
+		}
+	}
+
+	schedule->last_was_low_rate = due_found;
+	return channel;
 }
 
-uint32_t ads1118_task_fast_find_version(uint32_t configure_time) {
-	const XMC_GPIO_CONFIG_t config_low = {
-		.mode         = XMC_GPIO_MODE_OUTPUT_PUSH_PULL,
-		.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
-	};
+static void ads1118_schedule_init(ADS1118Schedule *schedule, const uint8_t loop, const uint8_t sleep_ms) {
+	const uint8_t hardware_version = ads1118.is_v15 ? ADS1118_HARDWARE_VERSION_V15 : ADS1118_HARDWARE_VERSION_V14;
 
-	const XMC_GPIO_CONFIG_t config_select = {
-		.mode         = ADS1118_SELECT_PIN_MODE,
-		.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
-	};
+	memset(schedule, 0, sizeof(ADS1118Schedule));
+	schedule->configs  = ads1118_config_table[hardware_version][loop];
+	schedule->sleep_ms = sleep_ms;
+}
 
-	uint8_t miso[2] = {0, 0};
+static void ads1118_schedule_add(ADS1118Schedule *schedule, const uint8_t channel, const uint8_t interval) {
+	if(schedule->num_entries >= ADS1118_SCHEDULE_MAX_ENTRIES) {
+		return;
+	}
 
-	// Wait for DRDY
-	coop_task_sleep_ms(1);
-	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
+	schedule->entries[schedule->num_entries].channel   = channel;
+	schedule->entries[schedule->num_entries].interval  = interval;
+	schedule->entries[schedule->num_entries].countdown = interval;
+	schedule->num_entries++;
+}
 
-	configure_time = system_timer_get_ms();
-	while(XMC_GPIO_GetInput(ADS1118_MISO_PORT, ADS1118_MISO_PIN)) {
-		if(system_timer_is_time_elapsed_ms(configure_time, ADS1118_CONFIGURE_TIMEOUT)) {
-			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-			spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(3, true), miso);
-			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
-			configure_time = system_timer_get_ms();
+// Has to be called whenever the hardware version, the CP measurement mode or the channel intervals change
+void ads1118_schedule_update(void) {
+	// Version test: Only measure IN1 vs GND until the version is found
+	ads1118_schedule_init(&ads1118.schedule_version, ADS1118_LOOP_NORMAL, 1);
+	ads1118_schedule_add(&ads1118.schedule_version, ADS1118_CHANNEL_VERSION, 1);
+
+	// Normal loop: ADS1118 runs with 8 samples per second, CP and PP alternating.
+	ads1118_schedule_init(&ads1118.schedule_normal, ADS1118_LOOP_NORMAL, 10);
+	ads1118_schedule_add(&ads1118.schedule_normal, ADS1118_CHANNEL_CP, 1);
+	ads1118_schedule_add(&ads1118.schedule_normal, ADS1118_CHANNEL_PP, 2);
+
+	// Fast loop: ADS1118 runs with 32 samples per second (860 in high rate mode).
+	// CP is measured with full rate, PP and temperature are interleaved with a low rate.
+	const bool high_rate = ads1118.cp_measurement_mode == ADS1118_CP_MEASUREMENT_MODE_HIGH_RATE;
+	ads1118_schedule_init(&ads1118.schedule_fast, ADS1118_LOOP_FAST + ads1118.cp_measurement_mode, high_rate ? 0 : 1);
+	ads1118.schedule_fast.decimate_cp        = high_rate;
+	ads1118.schedule_fast.pwm_synchronous_cp = ads1118.cp_measurement_mode == ADS1118_CP_MEASUREMENT_MODE_PWM_SYNCHRONOUS;
+	ads1118_schedule_add(&ads1118.schedule_fast, ADS1118_CHANNEL_CP, 1);
+	ads1118_schedule_add(&ads1118.schedule_fast, ADS1118_CHANNEL_PP, ads1118.fast_pp_interval);
+	ads1118_schedule_add(&ads1118.schedule_fast, ADS1118_CHANNEL_TEMPERATURE, ads1118.fast_temperature_interval);
+}
+
+static void ads1118_handle_result(const uint8_t channel, const uint8_t *miso) {
+	switch(channel) {
+		case ADS1118_CHANNEL_CP: {
+			const uint16_t adc_value = miso[1] | (miso[0] << 8);
+			if(ads1118.schedule_current->decimate_cp) {
+				ads1118_cp_decimate_from_miso(miso);
+			} else if(ads1118_settle_handle(&ads1118.cp_settle, adc_value, ADS1118_CP_SETTLE_TOLERANCE)) {
+				adc_capture_add(ADS1118_CHANNEL_CP, adc_value, 0, ADC_CAPTURE_FLAG_REJECTED);
+			} else {
+				ads1118.cp_sample_start_time = ads1118.result_time;
+				ads1118_cp_voltage_from_miso(miso);
+			}
+			break;
 		}
-		coop_task_yield();
+
+		case ADS1118_CHANNEL_PP: {
+			const uint16_t adc_value = miso[1] | (miso[0] << 8);
+			if(ads1118_settle_handle(&ads1118.pp_settle, adc_value, ADS1118_PP_SETTLE_TOLERANCE)) {
+				adc_capture_add(ADS1118_CHANNEL_PP, adc_value, 0, ADC_CAPTURE_FLAG_REJECTED);
+			} else {
+				ads1118_pp_voltage_from_miso(miso);
+			}
+			break;
+		}
+
+		case ADS1118_CHANNEL_TEMPERATURE: {
+			// 14 bit left-justified, 1 LSB = 0.03125°C
+			const int16_t value = (int16_t)(miso[1] | (miso[0] << 8)) >> 2;
+			ads1118.temperature = (value*25) >> 3; // 1/100 °C
+			break;
+		}
+
+		case ADS1118_CHANNEL_VERSION: {
+			if(ads1118.cp_settle.invalid_counter > 0) {
+				ads1118.cp_settle.invalid_counter--;
+				break;
+			}
+
+			// To find out if the EVSE is hardware version 1.5 we measure between IN1 und GND.
+			// In version 1.4 and lower in1 is connected to GND and we will measure something near 0.
+			// In version 1.5 in1 is used for the CP/PE measurement and we expect a value > 0.
+			const uint16_t in1_vs_gnd = (miso[1] | (miso[0] << 8));
+			ads1118.is_v15            = in1_vs_gnd > 128;
+			ads1118.version_found     = true;
+			ads1118_schedule_update();
+
+			// Invalidate the next measurement on both channels,
+			// to make sure that this can't be mixed up with the version test measurements
+			ads1118_settle_start(&ads1118.pp_settle, 1);
+			ads1118_settle_start(&ads1118.cp_settle, 1);
+			break;
+		}
+
+		default: break;
 	}
-	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
+}
 
-	// Read / Configure CP
-	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(3, true), miso);
-	if(ads1118.cp_invalid_counter > 0) {
-		ads1118.cp_invalid_counter--;
-	} else {
-		// To find out if the EVSE is hardware version 1.5 we measure between IN1 und GND.
-		// In version 1.4 and lower in1 is connected to GND and we will measure something near 0.
-		// In version 1.5 in1 is used for the CP/PE measurement and we expect a value > 0.
-		const uint16_t in1_vs_gnd = (miso[1] | (miso[0] << 8));
-		ads1118.is_v15            = in1_vs_gnd > 128;
-		ads1118.version_found     = true;
+// Read the result of the currently configured channel
+// and configure the next channel of the given schedule.
+void ads1118_task_schedule_step(ADS1118Schedule *schedule) {
+	uint8_t miso[2] = {0, 0};
 
-		// Invalidate the next measurement on both channels,
-		// to make sure that this can't be mixed up with the version test measurements
-		ads1118.pp_invalid_counter = MAX(ads1118.pp_invalid_counter, 1);
-		ads1118.cp_invalid_counter = MAX(ads1118.cp_invalid_counter, 1);
+	// The result that we read next may still be from the previous schedule,
+	// it always belongs to the channel that was configured last.
+	ads1118.schedule_current   = schedule;
+	const uint8_t channel      = ads1118.channel_configured;
+	const uint8_t next_channel = ads1118_schedule_next_channel(schedule);
+
+	// Wait for DRDY
+	if(schedule->sleep_ms > 0) {
+		coop_task_sleep_ms(schedule->sleep_ms);
 	}
 
-	return configure_time;
+	if(ads1118_read_on_drdy(channel, next_channel, schedule, miso)) {
+		ads1118_handle_result(channel, miso);
+		ads1118.sample_sequence++;
+		ads1118.result_time = system_timer_get_ms();
+	}
 }
 
 void ads1118_task_tick(void) {
+	uint8_t mosi[2] = {0, 0};
 	uint8_t miso[2] = {0, 0};
 
 	// Configure for find version
-	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(3, true), miso);
-
-	uint32_t configure_time = 0;
+	ads1118_config_to_mosi(ads1118.schedule_version.configs[ADS1118_CHANNEL_VERSION], mosi);
+	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, mosi, miso);
+	ads1118.channel_configured = ADS1118_CHANNEL_VERSION;
 
 	while(true) {
 		// Switch between normal loop and fast loop depending on IEC61851 state.
@@ -474,25 +972,51 @@ void ads1118_task_tick(void) {
 		// With the normal loop we have an ADC integration time of 250ms, so we
 		// can't possibly react fast enough.
 		// To fix this we have a "fast loop" that is used in state C.
-		// The fast loop measures with an integration time of ~31ms and it only
-		// measures the voltage between CP/PE.
-		// The voltage between PP/PE is ignored (the cable obviously can't be
-		// changed out while a car is charging, so it is save to ignore the
-		// PP/PE voltage while in state C).
+		// The fast loop measures with an integration time of ~31ms and it
+		// mostly measures the voltage between CP/PE.
+		// The voltage between PP/PE (and optionally the temperature) is only
+		// measured with a low rate in between (see ads1118_schedule_update).
 		if(ads1118.version_found) {
 			if(XMC_GPIO_GetInput(EVSE_RELAY_PIN)) {
-				configure_time = ads1118_task_fast_loop(configure_time);
+				ads1118_task_schedule_step(&ads1118.schedule_fast);
 			} else {
-				configure_time = ads1118_task_normal_loop(configure_time);
+				ads1118_task_schedule_step(&ads1118.schedule_normal);
 			}
 		} else {
-			configure_time = ads1118_task_fast_find_version(configure_time);
+			ads1118_task_schedule_step(&ads1118.schedule_version);
 		}
 
 		coop_task_yield();
 	}
 }
 
+static void ads1118_init_drdy(void) {
+	// Output level that is used while chip select is in GPIO mode
+	XMC_GPIO_SetOutputLow(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN);
+
+	XMC_ERU_ETL_CONFIG_t etl_config = {
+		.input_b                = ADS1118_DRDY_ERU_INPUT,
+		.source                 = XMC_ERU_ETL_SOURCE_B,
+		.edge_detection         = XMC_ERU_ETL_EDGE_DETECTION_FALLING,
+		.status_flag_mode       = XMC_ERU_ETL_STATUS_FLAG_MODE_HWCTRL,
+		.enable_output_trigger  = false, // Only enabled while waiting for DRDY
+		.output_trigger_channel = ADS1118_DRDY_ERU_TRIGGER
+	};
+
+	XMC_ERU_ETL_Init(ADS1118_DRDY_ERU, ADS1118_DRDY_ERU_ETL_CHANNEL, &etl_config);
+	XMC_ERU_OGU_SetServiceRequestMode(ADS1118_DRDY_ERU, ADS1118_DRDY_ERU_OGU_CHANNEL, XMC_ERU_OGU_SERVICE_REQUEST_ON_TRIGGER);
+
+	NVIC_SetPriority(ADS1118_DRDY_IRQ, ADS1118_DRDY_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ(ADS1118_DRDY_IRQ);
+	NVIC_EnableIRQ(ADS1118_DRDY_IRQ);
+
+	// CP PWM period match, the event itself is only enabled in the PWM synchronous mode
+	XMC_CCU4_SLICE_SetInterruptNode(EVSE_CP_PWM_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH, ADS1118_PWM_SYNC_SR);
+	NVIC_SetPriority(ADS1118_PWM_SYNC_IRQ, ADS1118_PWM_SYNC_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ(ADS1118_PWM_SYNC_IRQ);
+	NVIC_EnableIRQ(ADS1118_PWM_SYNC_IRQ);
+}
+
 void ads1118_init(void) {
 	// Temporarily save calibration
 	int16_t tmp_diff = ads1118.cp_cal_diff_voltage;
@@ -531,10 +1055,54 @@ void ads1118_init(void) {
 	ads1118.moving_average_cp_new         = true;
 	ads1118.moving_average_pp_new         = true;
 
+	ads1118.fast_pp_interval              = ADS1118_FAST_PP_INTERVAL_DEFAULT;
+	ads1118.fast_temperature_interval     = 0;
+	ads1118_schedule_update();
+
 	ads1118_init_spi();
+	ads1118_init_drdy();
 	coop_task_init(&ads1118_task, ads1118_task_tick);
 }
 
+// Replay of recorded resistances (see tests/replay.py).
+// While a replay is active the ADC keeps running, but the IEC61851 state machine
+// only sees the given resistances and the contactor is only switched virtually
+// (see evse_set_output). The replay ends if there is no new sample for ADS1118_REPLAY_TIMEOUT.
+void ads1118_replay_sample(const uint32_t cp_pe_resistance, const uint32_t pp_pe_resistance) {
+	if(!ads1118.replay_active) {
+		ads1118.replay_cp_duty_cycle = evse_get_cp_duty_cycle();
+	}
+
+	ads1118.replay_active    = true;
+	ads1118.replay_time      = system_timer_get_ms();
+	ads1118.cp_pe_resistance = cp_pe_resistance;
+	ads1118.pp_pe_resistance = pp_pe_resistance;
+	ads1118.sample_sequence++;
+}
+
+void ads1118_replay_stop(void) {
+	if(!ads1118.replay_active) {
+		return;
+	}
+
+	ads1118.replay_active         = false;
+	ads1118.moving_average_cp_new = true;
+	ads1118.moving_average_pp_new = true;
+	evse.replay_contactor         = false;
+
+	// The state machine starts over from state A with the real measurements,
+	// like after the contactor is switched we wait for them to settle.
+	iec61851_set_state(IEC61851_STATE_A);
+	evse_set_cp_duty_cycle(ads1118.replay_cp_duty_cycle);
+	ads1118_settle_start(&ads1118.cp_settle, 4);
+	ads1118_settle_start(&ads1118.pp_settle, 4);
+	iec61851_request_evaluation();
+}
+
 void ads1118_tick(void) {
 	coop_task_tick(&ads1118_task);
+
+	if(ads1118.replay_active && system_timer_is_time_elapsed_ms(ads1118.replay_time, ADS1118_REPLAY_TIMEOUT)) {
+		ads1118_replay_stop();
+	}
 }
\ No newline at end of file
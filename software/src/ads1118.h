@@ -31,6 +31,90 @@
 #define ADS1118_DIODE_DROP 650 // educated guess for diode drop of diode in car between CP/PE
 #define ADS1118_880OHM_CAL_NUM 14
 
+#define ADS1118_CHANNEL_CP          0
+#define ADS1118_CHANNEL_PP          1
+#define ADS1118_CHANNEL_TEMPERATURE 2
+#define ADS1118_CHANNEL_VERSION     3
+#define ADS1118_CHANNEL_NUM         4
+#define ADS1118_CHANNEL_INVALID     0xFF // Configuration unknown, result is ignored
+
+#define ADS1118_HARDWARE_VERSION_V14 0
+#define ADS1118_HARDWARE_VERSION_V15 1
+#define ADS1118_HARDWARE_VERSION_NUM 2
+#define ADS1118_LOOP_NORMAL          0
+#define ADS1118_LOOP_FAST            1 // + ADS1118CPMeasurementMode
+#define ADS1118_CONFIG_LOOP_NUM      4
+
+#define ADS1118_SCHEDULE_MAX_ENTRIES     3
+#define ADS1118_FAST_PP_INTERVAL_DEFAULT 32 // PP once per ~second in state C, CP rate is lowered by ~3%
+
+typedef struct {
+    uint8_t channel;
+    uint8_t interval;  // Measure channel every interval-th conversion, 0 = never
+    uint8_t countdown;
+} ADS1118ScheduleEntry;
+
+// Conversion schedule, the first entry is the base channel that is measured
+// whenever no other channel is due (see ads1118_schedule_next_channel)
+typedef struct {
+    ADS1118ScheduleEntry entries[ADS1118_SCHEDULE_MAX_ENTRIES];
+    uint8_t num_entries;
+    const uint16_t *configs; // ADS1118 config word per channel (row of ads1118_config_table)
+    bool decimate_cp;        // CP samples are decimated (high rate mode)
+    bool pwm_synchronous_cp; // CP conversions are started by the CP PWM period match (fast loop only)
+    uint8_t sleep_ms;        // Sleep before waiting for DRDY
+    bool last_was_low_rate;
+} ADS1118Schedule;
+
+#define ADS1118_REPLAY_TIMEOUT 1000 // ms without replay sample until the ADC measurements are used again
+
+#define ADS1118_CP_SETTLE_TOLERANCE 250 // ADC LSB, ~240mV at CP
+#define ADS1118_PP_SETTLE_TOLERANCE 80  // ADC LSB, 10mV at PP
+
+// Settle detection after contactor or PWM changes.
+// Samples are ignored until two successive samples agree within the tolerance,
+// but at most invalid_counter samples.
+typedef struct {
+    uint8_t  invalid_counter;  // Upper bound of samples that are still ignored
+    bool     reference_valid;
+    uint16_t reference;        // Last ignored sample
+    uint32_t start_time;       // Start of current blind window, 0 = not settling
+    uint32_t last_blind_time;  // Duration of last blind window in ms
+    uint32_t saved_samples;    // Sum of samples accepted earlier than with the upper bound alone
+} ADS1118Settle;
+
+typedef enum {
+    ADS1118_CP_MEASUREMENT_MODE_FREE_RUNNING = 0,    // Conversions are started independent of CP PWM
+    ADS1118_CP_MEASUREMENT_MODE_PWM_SYNCHRONOUS = 1, // CP conversions are started at the beginning of a CP PWM period
+    ADS1118_CP_MEASUREMENT_MODE_HIGH_RATE = 2,       // CP is sampled with 860SPS in state C and decimated in firmware
+} ADS1118CPMeasurementMode;
+
+typedef enum {
+    ADS1118_PWM_SYNC_IDLE = 0,
+    ADS1118_PWM_SYNC_START,      // The next CP PWM period match starts the CP conversion
+    ADS1118_PWM_SYNC_CONVERTING, // Conversion is running, CP PWM periods are counted until DRDY
+} ADS1118PWMSyncState;
+
+// Division by an invariant integer as multiplication with a magic number (see ads1118_divider_init)
+typedef struct {
+    uint32_t magic; // 0 = divisor is a power of two, only shifted
+    uint8_t  shift;
+    bool     add;
+} ADS1118Divider;
+
+// Calibration factors that are precomputed for the per-sample path,
+// so that a CP sample can be converted without division.
+typedef struct {
+    int32_t        voltage_mul;       // cp_cal_mul (or user calibration), with the sign of the divisor
+    ADS1118Divider voltage_div;       // |cp_cal_div| (or user calibration)
+    ADS1118Divider duty_cycle_div;    // duty_cycle
+    int16_t        diff_voltage;      // cp_cal_diff_voltage (or user calibration)
+    int16_t        resistance_offset; // 2700 ohm (w/o PWM) or 880 ohm (w/ PWM) calibration value
+    uint16_t       duty_cycle;        // duty cycle the context was built for
+    uint32_t       ma;                // max current the context was built for (selects 880 ohm calibration index)
+    bool           valid;
+} ADS1118CPCalContext;
+
 typedef struct {
     uint16_t cp_adc_value;
     uint32_t cp_adc_sum;
@@ -54,16 +138,31 @@ typedef struct {
     int16_t  cp_user_cal_2700ohm;      // Calibration done by user through API
     int16_t  cp_user_cal_880ohm[ADS1118_880OHM_CAL_NUM]; // Calibration done by user through API
 
-    uint8_t  cp_invalid_counter;
+    ADS1118CPCalContext cp_cal_context;
+
+    ADS1118Settle cp_settle;
 
     uint16_t pp_adc_value;
     int16_t  pp_voltage;
     uint32_t pp_pe_resistance;
-    uint8_t  pp_invalid_counter;
+    ADS1118Settle pp_settle;
+
+    int16_t  temperature; // 1/100 °C, only measured if fast_temperature_interval != 0
+
+    uint32_t sample_sequence; // Incremented after every ADC result, see iec61851_tick
+
+    ADS1118Schedule schedule_version;
+    ADS1118Schedule schedule_normal;
+    ADS1118Schedule schedule_fast;
+    ADS1118Schedule *schedule_current;
+    uint8_t  channel_configured;
+    uint8_t  fast_pp_interval;
+    uint8_t  fast_temperature_interval;
 
 	SPIFifo  spi_fifo;
 
     uint16_t cp_adc_avg_queue[ADS1118_CP_ADC_AVG_NUM];
+    uint16_t cp_adc_avg_sorted[ADS1118_CP_ADC_AVG_NUM]; // Same values as cp_adc_avg_queue, kept in ascending order
     uint8_t cp_adc_avg_queue_pos;
 
     bool moving_average_cp_adc_12v_active;
@@ -75,14 +174,54 @@ typedef struct {
     bool moving_average_cp_new;
     bool moving_average_pp_new;
 
+    ADS1118CPMeasurementMode cp_measurement_mode;
+    uint32_t cp_decimation_sum;
+    uint8_t  cp_decimation_count;
+    uint32_t cp_decimation_start_time; // Start of the first conversion of the current decimation window
+    uint32_t cp_sample_start_time;     // Start of the integration window of the current CP sample
+    uint32_t result_time;              // Time of the last ADC result, the next conversion starts there
+    uint32_t cp_state_c_exit_time;     // Start of first sample that shows that the car left state C while contactor is on
+    uint8_t  cp_state_c_return_count;  // Successive samples in state C since cp_state_c_exit_time was set
+
+    // PWM synchronous mode, see ads1118_pwm_sync_irq_handler
+    volatile ADS1118PWMSyncState pwm_sync_state;
+    volatile uint16_t pwm_sync_periods;    // CP PWM periods since the conversion start
+    uint8_t  pwm_sync_mosi[2];             // Config that starts the CP conversion
+    bool     pwm_sync_window_valid;        // Integration window of the last CP conversion is known
+    uint16_t pwm_sync_window_periods;      // Whole CP PWM periods in the integration window
+    uint16_t pwm_sync_window_end_timer;    // CP PWM timer value at the end of the integration window
+
     bool version_found;
     bool is_v15;
+
+    volatile bool drdy_armed;
+    uint8_t drdy_mosi[4];
+
+    uint32_t spi_error_count;
+    uint32_t config_error_count;
+
+    bool     replay_active; // Resistances are given through the API instead of the ADC (see ads1118_replay_sample)
+    uint32_t replay_time;   // Time of the last replay sample
+    uint16_t replay_cp_duty_cycle; // CP duty cycle before the replay, restored by ads1118_replay_stop
 } ADS1118;
 
 extern ADS1118 ads1118;
 
 void ads1118_init(void);
 void ads1118_tick(void);
+void ads1118_cp_cal_context_invalidate(void);
+void ads1118_cp_cal_context_update(const uint16_t duty_cycle, const uint32_t ma);
+void ads1118_divider_init(ADS1118Divider *divider, const uint16_t divisor);
+int32_t ads1118_divide(const int32_t numerator, const ADS1118Divider *divider);
+int16_t ads1118_cp_voltage_from_adc(const uint16_t adc_value);
+int16_t ads1118_cp_voltage_calibrate(const int16_t voltage);
+int16_t ads1118_cp_high_voltage(const int16_t voltage_calibrated, const int16_t min_voltage);
+void ads1118_schedule_update(void);
+void ads1118_settle_start(ADS1118Settle *settle, const uint8_t max_samples);
+void ads1118_cp_adc_avg_queue_add(uint16_t value);
+uint16_t ads1118_cp_adc_avg_queue_get(void);
+void ads1118_replay_sample(const uint32_t cp_pe_resistance, const uint32_t pp_pe_resistance);
+void ads1118_replay_stop(void);
 
 #define ADS1118_CONFIG_SINGLE_SHOT               (1     << 15)
 #define ADS1118_CONFIG_INP_IS_IN0_AND_INN_IS_IN1 (0b000 << 12)
@@ -112,4 +251,8 @@ void ads1118_tick(void);
 #define ADS1118_CONFIG_PULL_UP_ENABLE            (1     <<  3)
 #define ADS1118_CONFIG_NOP                       (0b01  <<  1)
 
+// Bits of the config register readback that have to match the written config
+// (single-shot bit always reads back as 0, NOP and reserved bits are fixed)
+#define ADS1118_CONFIG_READBACK_MASK             0x7FF8
+
 #endif
\ No newline at end of file
@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include "bricklib2/utility/util_definitions.h"
+#include "bricklib2/hal/system_timer/system_timer.h"
 
 #include "button.h"
 #include "communication.h"
@@ -46,6 +47,58 @@ uint32_t charging_slot_get_ma_incoming_cable(void) {
 	}
 }
 
+// Full scan of all slots, only necessary if the limiting slot is raised or deactivated
+static void charging_slot_update_limit(void) {
+    charging_slot.limiting_slot = CHARGING_SLOT_NONE;
+
+    for(uint8_t i = 0; i < CHARGING_SLOT_NUM; i++) {
+        if(charging_slot.active[i]) {
+            if((charging_slot.limiting_slot == CHARGING_SLOT_NONE) || (charging_slot.max_current[i] < charging_slot.max_current[charging_slot.limiting_slot])) {
+                charging_slot.limiting_slot = i;
+            }
+        }
+    }
+
+    if(charging_slot.limiting_slot == CHARGING_SLOT_NONE) {
+        charging_slot.effective_max_current = 0;
+    } else {
+        charging_slot.effective_max_current = charging_slot.max_current[charging_slot.limiting_slot];
+    }
+}
+
+// Update of the limit after max current or active of one slot changed
+static void charging_slot_handle_change(const uint8_t slot) {
+    if(charging_slot.limiting_slot == slot) {
+        // The limiting slot may have been raised or deactivated
+        charging_slot_update_limit();
+    } else if(charging_slot.active[slot]) {
+        if((charging_slot.limiting_slot == CHARGING_SLOT_NONE) ||
+           (charging_slot.max_current[slot] < charging_slot.effective_max_current) ||
+           ((charging_slot.max_current[slot] == charging_slot.effective_max_current) && (slot < charging_slot.limiting_slot))) {
+            charging_slot.limiting_slot         = slot;
+            charging_slot.effective_max_current = charging_slot.max_current[slot];
+        }
+    }
+}
+
+void charging_slot_set_max_current(const uint8_t slot, const uint16_t max_current) {
+    if(charging_slot.max_current[slot] == max_current) {
+        return;
+    }
+
+    charging_slot.max_current[slot] = max_current;
+    charging_slot_handle_change(slot);
+}
+
+void charging_slot_set_active(const uint8_t slot, const bool active) {
+    if(charging_slot.active[slot] == active) {
+        return;
+    }
+
+    charging_slot.active[slot] = active;
+    charging_slot_handle_change(slot);
+}
+
 void charging_slot_init(void) {
     // Incoming cable
     charging_slot.max_current[CHARGING_SLOT_INCOMING_CABLE]         = charging_slot_get_ma_incoming_cable();
@@ -62,38 +115,83 @@ void charging_slot_init(void) {
         charging_slot.active[i+2]              = charging_slot.active_default[i];
         charging_slot.clear_on_disconnect[i+2] = charging_slot.clear_on_disconnect_default[i];
     }
+
+    charging_slot_update_limit();
 }
 
-void charging_slot_tick(void) {
-    charging_slot.max_current[CHARGING_SLOT_OUTGOING_CABLE] = iec61851_get_ma_from_pp_resistance();
+void charging_slot_set_ttl(const uint8_t slot, const uint32_t ttl, const uint16_t expired_current) {
+    // The cable slots are read-only, they are set by the firmware
+    if((slot == CHARGING_SLOT_INCOMING_CABLE) || (slot == CHARGING_SLOT_OUTGOING_CABLE)) {
+        return;
+    }
+
+    charging_slot.ttl[slot]                 = ttl;
+    charging_slot.ttl_expired_current[slot] = expired_current;
+    charging_slot.ttl_pending              &= ~(1 << slot);
+
+    // Setting the TTL counts as write
+    charging_slot_refresh_ttl(slot);
 }
 
-uint16_t charging_slot_get_max_current(void) {
-    uint16_t max_current = 0xFFFF;
+// Called on every write to a slot through the API
+void charging_slot_refresh_ttl(const uint8_t slot) {
+    if(charging_slot.ttl[slot] == 0) {
+        return;
+    }
 
+    charging_slot.ttl_write_time[slot] = system_timer_get_ms();
+    charging_slot.ttl_pending         |= 1 << slot;
+}
+
+static void charging_slot_handle_ttl(void) {
     for(uint8_t i = 0; i < CHARGING_SLOT_NUM; i++) {
-        if(charging_slot.active[i]) {
-            max_current = MIN(max_current, charging_slot.max_current[i]);
+        if((charging_slot.ttl_pending & (1 << i)) && system_timer_is_time_elapsed_ms(charging_slot.ttl_write_time[i], charging_slot.ttl[i])) {
+            charging_slot.ttl_pending &= ~(1 << i);
+
+            // An expired TTL can only lower the current. Same as for the API:
+            // If button is pressed (key switch is turned off) the button slot is not changed.
+            if((i == CHARGING_SLOT_BUTTON) && (button.state == BUTTON_STATE_PRESSED)) {
+                continue;
+            }
+
+            charging_slot_set_max_current(i, MIN(charging_slot.max_current[i], charging_slot.ttl_expired_current[i]));
+            if((i == CHARGING_SLOT_BUTTON) && (charging_slot.max_current[i] == 0)) {
+                button.was_pressed = true;
+            }
+            iec61851_request_evaluation();
         }
     }
+}
+
+void charging_slot_tick(void) {
+    charging_slot_set_max_current(CHARGING_SLOT_OUTGOING_CABLE, iec61851_get_ma_from_pp_resistance());
 
-    if(max_current == 0xFFFF) {
-        return 0;
+    // Only slots with a running TTL are checked
+    if(charging_slot.ttl_pending != 0) {
+        charging_slot_handle_ttl();
     }
+}
+
+// Minimum current of all active slots, 0 if no slot is active
+uint16_t charging_slot_get_max_current(void) {
+    return charging_slot.effective_max_current;
+}
 
-    return max_current;
+// Returns the index of the active slot with the lowest current (lowest index on a tie)
+uint8_t charging_slot_get_limiting_slot(void) {
+    return charging_slot.limiting_slot;
 }
 
 void charging_slot_handle_disconnect(void) {
     for(uint8_t i = 0; i < CHARGING_SLOT_NUM; i++) {
         if(charging_slot.clear_on_disconnect[i]) {
-            charging_slot.max_current[i] = 0;
+            charging_slot_set_max_current(i, 0);
         }
     }
 }
 
 void charging_slot_stop_charging_by_button(void) {
-    charging_slot.max_current[CHARGING_SLOT_BUTTON] = 0;
+    charging_slot_set_max_current(CHARGING_SLOT_BUTTON, 0);
 }
 
 void charging_slot_start_charging_by_button(void) {
@@ -104,5 +202,5 @@ void charging_slot_start_charging_by_button(void) {
         return;
     }
 
-    charging_slot.max_current[CHARGING_SLOT_BUTTON] = 32000;
+    charging_slot_set_max_current(CHARGING_SLOT_BUTTON, 32000);
 }
\ No newline at end of file
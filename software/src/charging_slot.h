@@ -34,14 +34,28 @@
 #define CHARGING_SLOT_INPUT1         3
 #define CHARGING_SLOT_BUTTON         4
 
+#define CHARGING_SLOT_NONE           0xFF
+
 typedef struct {
     uint16_t max_current_default[CHARGING_SLOT_DEFAULT_NUM];
     bool active_default[CHARGING_SLOT_DEFAULT_NUM];
     bool clear_on_disconnect_default[CHARGING_SLOT_DEFAULT_NUM];
 
+    // max_current and active have to be changed through
+    // charging_slot_set_max_current/charging_slot_set_active
     uint16_t max_current[CHARGING_SLOT_NUM];
     bool active[CHARGING_SLOT_NUM];
     bool clear_on_disconnect[CHARGING_SLOT_NUM];
+
+    uint16_t effective_max_current; // Minimum of all active slots, 0 if no slot is active
+    uint8_t limiting_slot;          // Active slot with the lowest current (lowest index on a tie), CHARGING_SLOT_NONE if no slot is active
+
+    // Optional time-to-live per slot, refreshed by every write through the API.
+    // If it expires, max_current is set to ttl_expired_current.
+    uint32_t ttl[CHARGING_SLOT_NUM];                 // ms, 0 = disabled
+    uint16_t ttl_expired_current[CHARGING_SLOT_NUM];
+    uint32_t ttl_write_time[CHARGING_SLOT_NUM];
+    uint32_t ttl_pending;                            // Bitmask of slots with running TTL
 } ChargingSlot;
 
 extern ChargingSlot charging_slot;
@@ -49,6 +63,11 @@ extern ChargingSlot charging_slot;
 void charging_slot_init(void);
 void charging_slot_tick(void);
 uint16_t charging_slot_get_max_current(void);
+uint8_t charging_slot_get_limiting_slot(void);
+void charging_slot_set_max_current(const uint8_t slot, const uint16_t max_current);
+void charging_slot_set_active(const uint8_t slot, const bool active);
+void charging_slot_set_ttl(const uint8_t slot, const uint32_t ttl, const uint16_t expired_current);
+void charging_slot_refresh_ttl(const uint8_t slot);
 void charging_slot_start_charging_by_button(void);
 void charging_slot_stop_charging_by_button(void);
 void charging_slot_handle_disconnect(void);
@@ -21,6 +21,8 @@
 
 #include "communication.h"
 
+#include <stddef.h>
+
 #include "bricklib2/utility/communication_callback.h"
 #include "bricklib2/protocols/tfp/tfp.h"
 #include "bricklib2/hal/system_timer/system_timer.h"
@@ -38,14 +40,55 @@
 #include "lock.h"
 #include "button.h"
 #include "charging_slot.h"
+#include "adc_capture.h"
+#include "state_journal.h"
 
 #define LOW_LEVEL_PASSWORD 0x4223B00B
 
-BootloaderHandleMessageResponse handle_message(const void *message, void *response) {
-	// Restart communication watchdog timer.
-	evse.communication_watchdog_time = system_timer_get_ms();
+static CallbackConfiguration state_callback_configuration;
+static CallbackConfiguration button_state_callback_configuration;
+
+// Number of calls and CPU cycles spent per function ID (see handle_message)
+static HandlerStatistics handler_statistics[COMMUNICATION_FID_NUM];
+
+// Field groups of get_all_data_1 for get_all_data_1_delta.
+// Offset of first field in payload, a group ends where the next one starts.
+#define ALL_DATA_1_OFFSET(field) (offsetof(GetAllData1_Response, field) - sizeof(TFPMessageHeader))
+static const uint8_t all_data_1_group_offset[ALL_DATA_1_GROUP_NUM + 1] = {
+	ALL_DATA_1_OFFSET(iec61851_state),          // get_state
+	ALL_DATA_1_OFFSET(jumper_configuration),    // get_hardware_configuration
+	ALL_DATA_1_OFFSET(led_state),               // LED state, CP duty cycle
+	ALL_DATA_1_OFFSET(adc_values),              // ADC values, voltages, resistances
+	ALL_DATA_1_OFFSET(gpio),
+	ALL_DATA_1_OFFSET(charging_time),
+	ALL_DATA_1_OFFSET(time_since_state_change),
+	ALL_DATA_1_OFFSET(uptime),
+	ALL_DATA_1_OFFSET(indication),              // get_indicator_led
+	ALL_DATA_1_OFFSET(button_press_time),       // get_button_state
+	ALL_DATA_1_OFFSET(boost_mode_enabled),      // get_boost_mode
+	sizeof(GetAllData1_Response) - sizeof(TFPMessageHeader)
+};
+
+static GetAllData1_Response all_data_1_last;
+static uint32_t all_data_1_epoch; // 0 = not chosen yet
+static uint32_t all_data_1_generation;
+static uint32_t all_data_1_group_generation[ALL_DATA_1_GROUP_NUM];
+
+// CPU cycle counter derived from the system timer (SysTick runs with the CPU clock).
+// Wraps around after 2^32 cycles, only to be used for differences.
+static uint32_t communication_get_cycles(void) {
+	uint32_t ms;
+	uint32_t value;
+	do {
+		ms    = system_timer_get_ms();
+		value = SysTick->VAL;
+	} while(ms != system_timer_get_ms());
+
+	return ms*(SysTick->LOAD + 1) + (SysTick->LOAD - value);
+}
 
-	switch(tfp_get_fid_from_message(message)) {
+static BootloaderHandleMessageResponse handle_message_fid(const uint8_t fid, const void *message, void *response) {
+	switch(fid) {
 		case FID_GET_STATE: return get_state(message, response);
 		case FID_GET_HARDWARE_CONFIGURATION: return get_hardware_configuration(message, response);
 		case FID_GET_LOW_LEVEL_STATE: return get_low_level_state(message, response);
@@ -73,35 +116,118 @@ BootloaderHandleMessageResponse handle_message(const void *message, void *respon
 		case FID_GET_BOOST_CURRENT: return get_boost_current(message, response);
 		case FID_SET_PWM_OVERRIDE: return set_pwm_override(message);
 		case FID_GET_PWM_OVERRIDE: return get_pwm_override(message, response);
+		case FID_SET_CP_MEASUREMENT_MODE: return set_cp_measurement_mode(message);
+		case FID_GET_CP_MEASUREMENT_MODE: return get_cp_measurement_mode(message, response);
+		case FID_SET_ADC_CHANNEL_INTERVALS: return set_adc_channel_intervals(message);
+		case FID_GET_ADC_CHANNEL_INTERVALS: return get_adc_channel_intervals(message, response);
+		case FID_SET_ADC_CAPTURE_CONFIG: return set_adc_capture_config(message);
+		case FID_GET_ADC_CAPTURE_CONFIG: return get_adc_capture_config(message, response);
+		case FID_ARM_ADC_CAPTURE: return arm_adc_capture(message);
+		case FID_TRIGGER_ADC_CAPTURE: return trigger_adc_capture(message);
+		case FID_GET_ADC_CAPTURE_STATE: return get_adc_capture_state(message, response);
+		case FID_GET_ADC_CAPTURE_LOW_LEVEL: return get_adc_capture_low_level(message, response);
+		case FID_GET_ADC_ERROR_COUNT: return get_adc_error_count(message, response);
+		case FID_GET_CONTACTOR_OFF_LATENCY: return get_contactor_off_latency(message, response);
+		case FID_RESET_CONTACTOR_OFF_LATENCY: return reset_contactor_off_latency(message);
+		case FID_GET_STATE_JOURNAL_STATE: return get_state_journal_state(message, response);
+		case FID_GET_STATE_JOURNAL_LOW_LEVEL: return get_state_journal_low_level(message, response);
+		case FID_RESET_STATE_JOURNAL: return reset_state_journal(message);
+		case FID_REPLAY_SAMPLE: return replay_sample(message, response);
+		case FID_STOP_REPLAY: return stop_replay(message);
+		case FID_SET_STATE_CALLBACK_CONFIGURATION: return set_state_callback_configuration(message);
+		case FID_GET_STATE_CALLBACK_CONFIGURATION: return get_state_callback_configuration(message, response);
+		case FID_SET_BUTTON_STATE_CALLBACK_CONFIGURATION: return set_button_state_callback_configuration(message);
+		case FID_GET_BUTTON_STATE_CALLBACK_CONFIGURATION: return get_button_state_callback_configuration(message, response);
+		case FID_GET_ALL_DATA_1_DELTA: return get_all_data_1_delta(message, response);
+		case FID_GET_HANDLER_STATISTICS: return get_handler_statistics(message, response);
+		case FID_RESET_HANDLER_STATISTICS: return reset_handler_statistics(message);
+		case FID_SET_CHARGING_SLOTS: return set_charging_slots(message);
+		case FID_GET_LIMITING_CHARGING_SLOT: return get_limiting_charging_slot(message, response);
+		case FID_SET_CHARGING_SLOT_TTL: return set_charging_slot_ttl(message);
+		case FID_GET_CHARGING_SLOT_TTL: return get_charging_slot_ttl(message, response);
 
 		default: return HANDLE_MESSAGE_RESPONSE_NOT_SUPPORTED;
 	}
 }
 
+BootloaderHandleMessageResponse handle_message(const void *message, void *response) {
+	// Restart communication watchdog timer.
+	evse.communication_watchdog_time = system_timer_get_ms();
 
-BootloaderHandleMessageResponse get_state(const GetState *data, GetState_Response *response) {
-	response->header.length            = sizeof(GetState_Response);
-	response->iec61851_state           = iec61851.state;
-	response->contactor_state          = contactor_check.state;
-	response->contactor_error          = contactor_check.error;
-	response->allowed_charging_current = iec61851_get_max_ma();
-	response->error_state              = led.state == LED_STATE_BLINKING ? led.blink_num : 0;
-	response->lock_state               = lock.state;
+	const uint8_t fid                         = tfp_get_fid_from_message(message);
+	const uint32_t start                      = communication_get_cycles();
+	const BootloaderHandleMessageResponse ret = handle_message_fid(fid, message, response);
+	const uint32_t cycles                     = communication_get_cycles() - start;
+
+	if(fid < COMMUNICATION_FID_NUM) {
+		HandlerStatistics *statistics = &handler_statistics[fid];
+		if(statistics->count == 0) {
+			statistics->avg_cycles_x16 = cycles << 4;
+		} else {
+			statistics->avg_cycles_x16 = statistics->avg_cycles_x16 - (statistics->avg_cycles_x16 >> 4) + cycles;
+		}
+		statistics->count++;
+		statistics->max_cycles = MAX(statistics->max_cycles, cycles);
+	}
 
-	if(response->error_state != 0) {
-		response->charger_state = EVSE_CHARGER_STATE_ERROR;
+	return ret;
+}
+
+
+// The following helpers are shared between the single getters and get_all_data_1.
+// All of them are called from handle_message, the EVSE state can not change in between
+// (the ADS1118 task and the IEC61851 state machine only run in the main loop).
+
+static uint8_t communication_get_error_state(void) {
+	return led.state == LED_STATE_BLINKING ? led.blink_num : 0;
+}
+
+static uint8_t communication_get_charger_state(const uint8_t error_state) {
+	if(error_state != 0) {
+		return EVSE_CHARGER_STATE_ERROR;
 	} else if(iec61851.state == IEC61851_STATE_C) {
-		response->charger_state = EVSE_CHARGER_STATE_CHARGING;
+		return EVSE_CHARGER_STATE_CHARGING;
 	} else if(iec61851.state == IEC61851_STATE_B) {
 		if(charging_slot_get_max_current() == 0) {
-			response->charger_state = EVSE_CHARGER_STATE_WAITING_FOR_CHARGE_RELEASE;
+			return EVSE_CHARGER_STATE_WAITING_FOR_CHARGE_RELEASE;
 		} else {
-			response->charger_state = EVSE_CHARGER_STATE_READY_TO_CHARGE;
+			return EVSE_CHARGER_STATE_READY_TO_CHARGE;
 		}
-	} else { 
-		response->charger_state = EVSE_CHARGER_STATE_NOT_CONNECTED;
 	}
 
+	return EVSE_CHARGER_STATE_NOT_CONNECTED;
+}
+
+static uint8_t communication_get_gpio(void) {
+	return XMC_GPIO_GetInput(EVSE_INPUT_GP_PIN) | (XMC_GPIO_GetInput(EVSE_OUTPUT_GP_PIN) << 1) | (XMC_GPIO_GetInput(EVSE_MOTOR_INPUT_SWITCH_PIN) << 2) | (XMC_GPIO_GetInput(EVSE_RELAY_PIN) << 3) | (XMC_GPIO_GetInput(EVSE_MOTOR_FAULT_PIN) << 4);
+}
+
+static uint32_t communication_get_charging_time(const uint32_t now) {
+	if(evse.charging_time == 0) {
+		return 0;
+	}
+
+	return now - evse.charging_time;
+}
+
+static uint16_t communication_get_indicator_duration(const uint32_t now) {
+	if((led.api_duration == 0) || system_timer_is_time_elapsed_ms(led.api_start, led.api_duration)) {
+		return 0;
+	}
+
+	return led.api_duration - ((uint32_t)(now - led.api_start));
+}
+
+BootloaderHandleMessageResponse get_state(const GetState *data, GetState_Response *response) {
+	response->header.length            = sizeof(GetState_Response);
+	response->iec61851_state           = iec61851.state;
+	response->contactor_state          = contactor_check.state;
+	response->contactor_error          = contactor_check.error;
+	response->allowed_charging_current = iec61851_get_max_ma();
+	response->error_state              = communication_get_error_state();
+	response->lock_state               = lock.state;
+	response->charger_state            = communication_get_charger_state(response->error_state);
+
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
@@ -125,74 +251,107 @@ BootloaderHandleMessageResponse get_low_level_state(const GetLowLevelState *data
 	response->voltages[2]              = ads1118.cp_high_voltage;
 	response->resistances[0]           = ads1118.cp_pe_resistance;
 	response->resistances[1]           = ads1118.pp_pe_resistance;
-	response->gpio[0]                  = XMC_GPIO_GetInput(EVSE_INPUT_GP_PIN) | (XMC_GPIO_GetInput(EVSE_OUTPUT_GP_PIN) << 1) | (XMC_GPIO_GetInput(EVSE_MOTOR_INPUT_SWITCH_PIN) << 2) | (XMC_GPIO_GetInput(EVSE_RELAY_PIN) << 3) | (XMC_GPIO_GetInput(EVSE_MOTOR_FAULT_PIN) << 4);
-
-	if(evse.charging_time == 0) {
-		response->charging_time        = 0;
-	} else {
-		response->charging_time        = system_timer_get_ms() - evse.charging_time;
-	}
+	response->gpio[0]                  = communication_get_gpio();
 	response->uptime                   = system_timer_get_ms();
+	response->charging_time            = communication_get_charging_time(response->uptime);
 	response->time_since_state_change  = response->uptime - iec61851.last_state_change;
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
-BootloaderHandleMessageResponse set_charging_slot(const SetChargingSlot *data) {
+static bool communication_charging_slot_is_valid(const uint8_t slot, const uint16_t max_current) {
 	// The first two slots are read-only
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
-		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	if((slot < 2) || (slot >= CHARGING_SLOT_NUM)) {
+		return false;
 	}
 
-	if((data->max_current > 0) && ((data->max_current < 6000) || (data->max_current > 32000))) {
-		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	if((max_current > 0) && ((max_current < 6000) || (max_current > 32000))) {
+		return false;
 	}
 
+	return true;
+}
+
+static void communication_charging_slot_apply(const uint8_t slot, const uint16_t max_current, const bool active, const bool clear_on_disconnect) {
 	// If button is pressed (key switch is turned off) we don't allow to change the max current in the button slot
-	if((data->slot != CHARGING_SLOT_BUTTON) || (button.state != BUTTON_STATE_PRESSED)) {
-		charging_slot.max_current[data->slot]     = data->max_current;
+	if((slot != CHARGING_SLOT_BUTTON) || (button.state != BUTTON_STATE_PRESSED)) {
+		charging_slot_set_max_current(slot, max_current);
 	}
-	charging_slot.active[data->slot]              = data->active;
-	charging_slot.clear_on_disconnect[data->slot] = data->clear_on_disconnect;
+	charging_slot_set_active(slot, active);
+	charging_slot.clear_on_disconnect[slot] = clear_on_disconnect;
+	charging_slot_refresh_ttl(slot);
+}
+
+BootloaderHandleMessageResponse set_charging_slot(const SetChargingSlot *data) {
+	if(!communication_charging_slot_is_valid(data->slot, data->max_current)) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	communication_charging_slot_apply(data->slot, data->max_current, data->active, data->clear_on_disconnect);
+
+	iec61851_request_evaluation();
 
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
-BootloaderHandleMessageResponse set_charging_slot_max_current(const SetChargingSlotMaxCurrent *data) {
-	// The first two slots are read-only
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
+// Sets up to SET_CHARGING_SLOTS_MAX_NUM slots at once. Either all slots are valid
+// and changed or nothing is changed. The handler runs between two IEC61851 ticks,
+// so the state machine (and the PWM) only sees the complete new combination.
+BootloaderHandleMessageResponse set_charging_slots(const SetChargingSlots *data) {
+	if(data->slot_count > SET_CHARGING_SLOTS_MAX_NUM) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
-	if((data->max_current > 0) && ((data->max_current < 6000) || (data->max_current > 32000))) {
+	for(uint8_t i = 0; i < data->slot_count; i++) {
+		if(!communication_charging_slot_is_valid(data->slot[i], data->max_current[i])) {
+			return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+		}
+	}
+
+	// If a slot is given more than once, the last one wins
+	for(uint8_t i = 0; i < data->slot_count; i++) {
+		communication_charging_slot_apply(data->slot[i], data->max_current[i], data->active_and_clear_on_disconnect[i] & 1, data->active_and_clear_on_disconnect[i] & 2);
+	}
+
+	iec61851_request_evaluation();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse set_charging_slot_max_current(const SetChargingSlotMaxCurrent *data) {
+	if(!communication_charging_slot_is_valid(data->slot, data->max_current)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
 	// If button is pressed (key switch is turned off) we don't allow to change the max current in the button slot
 	if((data->slot != CHARGING_SLOT_BUTTON) || (button.state != BUTTON_STATE_PRESSED)) {
-		charging_slot.max_current[data->slot] = data->max_current;
+		charging_slot_set_max_current(data->slot, data->max_current);
 		if((data->slot == CHARGING_SLOT_BUTTON) && (charging_slot.max_current[data->slot] == 0)) {
 			button.was_pressed = true;
 		}
 	}
+	charging_slot_refresh_ttl(data->slot);
+
+	iec61851_request_evaluation();
 
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
 BootloaderHandleMessageResponse set_charging_slot_active(const SetChargingSlotActive *data) {
-	// The first two slots are read-only
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
+	if(!communication_charging_slot_is_valid(data->slot, 0)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
-	charging_slot.active[data->slot] = data->active;
+	charging_slot_set_active(data->slot, data->active);
+	charging_slot_refresh_ttl(data->slot);
+
+	iec61851_request_evaluation();
 
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
 BootloaderHandleMessageResponse set_charging_slot_clear_on_disconnect(const SetChargingSlotClearOnDisconnect *data) {
-	// The first two slots are read-only
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
+	if(!communication_charging_slot_is_valid(data->slot, 0)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
@@ -201,6 +360,48 @@ BootloaderHandleMessageResponse set_charging_slot_clear_on_disconnect(const SetC
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
+BootloaderHandleMessageResponse get_limiting_charging_slot(const GetLimitingChargingSlot *data, GetLimitingChargingSlot_Response *response) {
+	response->header.length = sizeof(GetLimitingChargingSlot_Response);
+	response->max_current   = charging_slot_get_max_current();
+	response->slot          = charging_slot_get_limiting_slot();
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse set_charging_slot_ttl(const SetChargingSlotTTL *data) {
+	// The first two slots are read-only, a TTL would overwrite the current of the cables
+	if((data->slot == CHARGING_SLOT_INCOMING_CABLE) || (data->slot == CHARGING_SLOT_OUTGOING_CABLE)) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	// The expired current is checked like a max current of set_charging_slot
+	if(!communication_charging_slot_is_valid(data->slot, data->expired_current)) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	charging_slot_set_ttl(data->slot, data->ttl, data->expired_current);
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_charging_slot_ttl(const GetChargingSlotTTL *data, GetChargingSlotTTL_Response *response) {
+	if(data->slot >= CHARGING_SLOT_NUM) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	response->header.length   = sizeof(GetChargingSlotTTL_Response);
+	response->ttl             = charging_slot.ttl[data->slot];
+	response->expired_current = charging_slot.ttl_expired_current[data->slot];
+	if(charging_slot.ttl_pending & (1 << data->slot)) {
+		const uint32_t elapsed   = system_timer_get_ms() - charging_slot.ttl_write_time[data->slot];
+		response->time_remaining = (elapsed >= charging_slot.ttl[data->slot]) ? 0 : (charging_slot.ttl[data->slot] - elapsed);
+	} else {
+		response->time_remaining = 0;
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
 BootloaderHandleMessageResponse get_charging_slot(const GetChargingSlot *data, GetChargingSlot_Response *response) {
 	if(data->slot >= CHARGING_SLOT_NUM) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
@@ -225,11 +426,7 @@ BootloaderHandleMessageResponse get_all_charging_slots(const GetAllChargingSlots
 }
 
 BootloaderHandleMessageResponse set_charging_slot_default(const SetChargingSlotDefault *data) {
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
-		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
-	}
-
-	if((data->max_current > 0) && ((data->max_current < 6000) || (data->max_current > 32000))) {
+	if(!communication_charging_slot_is_valid(data->slot, data->max_current)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
@@ -272,12 +469,14 @@ BootloaderHandleMessageResponse calibrate(const Calibrate *data, Calibrate_Respo
 	    evse.calibration_state = 1;
 		ads1118.cp_cal_mul = data->value;        // multiply by calibrated voltage
 		ads1118.cp_cal_div = ads1118.cp_voltage; // divide by uncalibrated voltage
+		ads1118_cp_cal_context_invalidate();
 
 		response->success = true;
 		logd("cal mul %d, div %d\n\r", ads1118.cp_cal_mul, ads1118.cp_cal_div);
 	} else if((evse.calibration_state == 1) && (data->state == 2)) {
 	    evse.calibration_state = 2;
 		ads1118.cp_cal_2700ohm = ads1118.cp_cal_max_voltage - (910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP) + 2700*ads1118.cp_high_voltage)/2700;
+		ads1118_cp_cal_context_invalidate();
 
 		response->success = true;
 		logd("cal 2700ohm %d\n\r", ads1118.cp_cal_2700ohm);
@@ -286,6 +485,7 @@ BootloaderHandleMessageResponse calibrate(const Calibrate *data, Calibrate_Respo
 		ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, 64000 - dc*64);
 	} else if((evse.calibration_state >= 2) && (evse.calibration_state <= 15) && (data->state == (evse.calibration_state + 1))) {
 		ads1118.cp_cal_880ohm[evse.calibration_state-2] = ads1118.cp_cal_max_voltage - (910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP) + 880*ads1118.cp_high_voltage)/880;
+		ads1118_cp_cal_context_invalidate();
 
 		response->success = true;
 		logd("cal 880ohm %d -> %d\n\r", evse.calibration_state-2, ads1118.cp_cal_880ohm[evse.calibration_state-2]);
@@ -301,6 +501,7 @@ BootloaderHandleMessageResponse calibrate(const Calibrate *data, Calibrate_Respo
 	} else if((evse.calibration_state == 16) && (data->state == 17)) {
 	    evse.calibration_state = 0;
 		ads1118.cp_cal_diff_voltage = data->value;
+		ads1118_cp_cal_context_invalidate();
 
 		// Set duty cycle back to 100%
 		ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, 64000 - 1000*64);
@@ -374,6 +575,7 @@ BootloaderHandleMessageResponse set_user_calibration(const SetUserCalibration *d
 			ads1118.cp_user_cal_880ohm[i] = 0;
 		}
 	}
+	ads1118_cp_cal_context_invalidate();
 	evse_save_user_calibration();
 
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
@@ -403,12 +605,7 @@ BootloaderHandleMessageResponse set_data_storage(const SetDataStorage *data) {
 BootloaderHandleMessageResponse get_indicator_led(const GetIndicatorLED *data, GetIndicatorLED_Response *response) {
 	response->header.length = sizeof(GetIndicatorLED_Response);
 	response->indication    = led.api_indication;
-	if((led.api_duration == 0) || system_timer_is_time_elapsed_ms(led.api_start, led.api_duration)) {
-		response->duration  = 0;
-	} else {
-		response->duration  = led.api_duration - ((uint32_t)(system_timer_get_ms() - led.api_start));
-	}
-
+	response->duration      = communication_get_indicator_duration(system_timer_get_ms());
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
@@ -476,27 +673,51 @@ BootloaderHandleMessageResponse get_button_state(const GetButtonState *data, Get
 }
 
 BootloaderHandleMessageResponse get_all_data_1(const GetAllData1 *data, GetAllData1_Response *response) {
-	response->header.length = sizeof(GetAllData1_Response);
+	// Filled in one pass with one timestamp, the order of the fields is the same as in the single getters
+	const uint32_t now = system_timer_get_ms();
 
-	TFPMessageFull parts;
+	response->header.length            = sizeof(GetAllData1_Response);
 
-	get_state(NULL, (GetState_Response*)&parts);
-	memcpy(&response->iec61851_state, parts.data, sizeof(GetState_Response) - sizeof(TFPMessageHeader));
+	// get_state
+	response->iec61851_state           = iec61851.state;
+	response->contactor_state          = contactor_check.state;
+	response->contactor_error          = contactor_check.error;
+	response->allowed_charging_current = iec61851_get_max_ma();
+	response->error_state              = communication_get_error_state();
+	response->lock_state               = lock.state;
+	response->charger_state            = communication_get_charger_state(response->error_state);
 
-	get_hardware_configuration(NULL, (GetHardwareConfiguration_Response*)&parts);
-	memcpy(&response->jumper_configuration, parts.data, sizeof(GetHardwareConfiguration_Response) - sizeof(TFPMessageHeader));
+	// get_hardware_configuration
+	response->jumper_configuration     = evse.config_jumper_current;
+	response->has_lock_switch          = evse.has_lock_switch;
+	response->evse_version             = ads1118.is_v15 ? 15 : 14;
 
-	get_low_level_state(NULL, (GetLowLevelState_Response*)&parts);
-	memcpy(&response->led_state, parts.data, sizeof(GetLowLevelState_Response) - sizeof(TFPMessageHeader));
+	// get_low_level_state
+	response->led_state                = led.state;
+	response->cp_pwm_duty_cycle        = evse_get_cp_duty_cycle();
+	response->adc_values[0]            = ads1118.cp_adc_value;
+	response->adc_values[1]            = ads1118.pp_adc_value;
+	response->voltages[0]              = ads1118.cp_voltage_calibrated;
+	response->voltages[1]              = ads1118.pp_voltage;
+	response->voltages[2]              = ads1118.cp_high_voltage;
+	response->resistances[0]           = ads1118.cp_pe_resistance;
+	response->resistances[1]           = ads1118.pp_pe_resistance;
+	response->gpio[0]                  = communication_get_gpio();
+	response->charging_time            = communication_get_charging_time(now);
+	response->time_since_state_change  = now - iec61851.last_state_change;
+	response->uptime                   = now;
 
-	get_indicator_led(NULL, (GetIndicatorLED_Response*)&parts);
-	memcpy(&response->indication, parts.data, sizeof(GetIndicatorLED_Response) - sizeof(TFPMessageHeader));
+	// get_indicator_led
+	response->indication               = led.api_indication;
+	response->duration                 = communication_get_indicator_duration(now);
 
-	get_button_state(NULL, (GetButtonState_Response*)&parts);
-	memcpy(&response->button_press_time, parts.data, sizeof(GetButtonState_Response) - sizeof(TFPMessageHeader));
+	// get_button_state
+	response->button_press_time        = button.press_time;
+	response->button_release_time      = button.release_time;
+	response->button_pressed           = button.state == BUTTON_STATE_PRESSED;
 
-	get_boost_mode(NULL, (GetBoostMode_Response*)&parts);
-	memcpy(&response->boost_mode_enabled, parts.data, sizeof(GetBoostMode_Response) - sizeof(TFPMessageHeader));
+	// get_boost_mode
+	response->boost_mode_enabled       = evse.boost_mode_enabled;
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
@@ -514,6 +735,8 @@ BootloaderHandleMessageResponse set_boost_mode(const SetBoostMode *data) {
 	evse.boost_mode_enabled = data->boost_mode_enabled;
 	evse_save_config();
 
+	iec61851_request_evaluation();
+
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
@@ -527,6 +750,8 @@ BootloaderHandleMessageResponse get_boost_mode(const GetBoostMode *data, GetBoos
 BootloaderHandleMessageResponse set_boost_current(const SetBoostCurrent *data) {
 	evse.boost_current = MIN(data->boost_current, 1200);
 
+	iec61851_request_evaluation();
+
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
@@ -540,6 +765,8 @@ BootloaderHandleMessageResponse get_boost_current(const GetBoostCurrent *data, G
 BootloaderHandleMessageResponse set_pwm_override(const SetPWMOverride *data) {
 	evse.pwm_override = MIN(data->pwm_override, 1000);
 
+	iec61851_request_evaluation();
+
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
@@ -550,11 +777,383 @@ BootloaderHandleMessageResponse get_pwm_override(const GetPWMOverride *data, Get
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
+BootloaderHandleMessageResponse set_cp_measurement_mode(const SetCPMeasurementMode *data) {
+	if(data->mode > EVSE_CP_MEASUREMENT_MODE_HIGH_RATE) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	if(ads1118.cp_measurement_mode != data->mode) {
+		ads1118.cp_measurement_mode = data->mode;
+		ads1118.cp_decimation_sum   = 0;
+		ads1118.cp_decimation_count = 0;
+		ads1118_schedule_update();
+
+		// The next measurement may still be started in the old mode
+		ads1118_settle_start(&ads1118.cp_settle, 2);
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_cp_measurement_mode(const GetCPMeasurementMode *data, GetCPMeasurementMode_Response *response) {
+	response->header.length = sizeof(GetCPMeasurementMode_Response);
+	response->mode          = ads1118.cp_measurement_mode;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse set_adc_channel_intervals(const SetADCChannelIntervals *data) {
+	// PP has to stay fresh in state C, so it can't be turned off completely
+	if(data->pp_interval == 0) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	ads1118.fast_pp_interval          = data->pp_interval;
+	ads1118.fast_temperature_interval = data->temperature_interval;
+	ads1118_schedule_update();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_adc_channel_intervals(const GetADCChannelIntervals *data, GetADCChannelIntervals_Response *response) {
+	response->header.length        = sizeof(GetADCChannelIntervals_Response);
+	response->pp_interval          = ads1118.fast_pp_interval;
+	response->temperature_interval = ads1118.fast_temperature_interval;
+	response->temperature          = ads1118.temperature;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse set_adc_capture_config(const SetADCCaptureConfig *data) {
+	if(data->post_trigger_samples > ADC_CAPTURE_SAMPLES_NUM) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	adc_capture.trigger_on_state_change = data->trigger_on_state_change;
+	adc_capture.post_trigger_samples    = data->post_trigger_samples;
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_adc_capture_config(const GetADCCaptureConfig *data, GetADCCaptureConfig_Response *response) {
+	response->header.length           = sizeof(GetADCCaptureConfig_Response);
+	response->trigger_on_state_change = adc_capture.trigger_on_state_change;
+	response->post_trigger_samples    = adc_capture.post_trigger_samples;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse arm_adc_capture(const ArmADCCapture *data) {
+	adc_capture_arm();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse trigger_adc_capture(const TriggerADCCapture *data) {
+	adc_capture_trigger();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_adc_capture_state(const GetADCCaptureState *data, GetADCCaptureState_Response *response) {
+	response->header.length = sizeof(GetADCCaptureState_Response);
+	response->state         = adc_capture.state;
+	response->trigger_time  = adc_capture.trigger_time;
+	response->sample_count  = adc_capture.count;
+	response->sample_size   = sizeof(ADCCaptureSample);
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_adc_capture_low_level(const GetADCCaptureLowLevel *data, GetADCCaptureLowLevel_Response *response) {
+	response->header.length       = sizeof(GetADCCaptureLowLevel_Response);
+	response->stream_length       = adc_capture_get_length();
+	response->stream_chunk_offset = data->stream_chunk_offset;
+	adc_capture_read(data->stream_chunk_offset, response->stream_chunk_data);
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_adc_error_count(const GetADCErrorCount *data, GetADCErrorCount_Response *response) {
+	response->header.length      = sizeof(GetADCErrorCount_Response);
+	response->spi_error_count    = ads1118.spi_error_count;
+	response->config_error_count = ads1118.config_error_count;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_contactor_off_latency(const GetContactorOffLatency *data, GetContactorOffLatency_Response *response) {
+	response->header.length        = sizeof(GetContactorOffLatency_Response);
+	response->latency_last         = evse.contactor_off_latency_last;
+	response->latency_max          = evse.contactor_off_latency_max;
+	response->decision_latency_max = evse.contactor_off_decision_latency_max;
+	response->output_latency_max   = evse.contactor_off_output_latency_max;
+	memcpy(response->histogram, evse.contactor_off_latency_histogram, sizeof(response->histogram));
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse reset_contactor_off_latency(const ResetContactorOffLatency *data) {
+	evse_reset_contactor_off_latency();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_state_journal_state(const GetStateJournalState *data, GetStateJournalState_Response *response) {
+	response->header.length = sizeof(GetStateJournalState_Response);
+	response->frozen        = state_journal.frozen;
+	response->freeze_reason = state_journal.freeze_reason;
+	response->freeze_time   = state_journal.freeze_time;
+	response->total_count   = state_journal.total_count;
+	response->ram_length    = state_journal_get_length(STATE_JOURNAL_SOURCE_RAM);
+	response->eeprom_length = state_journal_get_length(STATE_JOURNAL_SOURCE_EEPROM);
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_state_journal_low_level(const GetStateJournalLowLevel *data, GetStateJournalLowLevel_Response *response) {
+	if(data->source > EVSE_STATE_JOURNAL_SOURCE_EEPROM) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	response->header.length       = sizeof(GetStateJournalLowLevel_Response);
+	response->stream_length       = state_journal_get_length(data->source);
+	response->stream_chunk_offset = data->stream_chunk_offset;
+	state_journal_read(data->source, data->stream_chunk_offset, response->stream_chunk_data);
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse reset_state_journal(const ResetStateJournal *data) {
+	state_journal_reset(data->clear_eeprom);
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse replay_sample(const ReplaySample *data, ReplaySample_Response *response) {
+	response->header.length = sizeof(ReplaySample_Response);
+
+	// A replay can only be started while the relay is off and no vehicle is connected
+	const bool start_possible = !XMC_GPIO_GetInput(EVSE_RELAY_PIN) && (ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_A);
+	if((data->password != LOW_LEVEL_PASSWORD) || (!ads1118.replay_active && !start_possible)) {
+		response->success = false;
+	} else {
+		ads1118_replay_sample(data->cp_pe_resistance, data->pp_pe_resistance);
+		response->success = true;
+	}
+
+	// The sample is evaluated in the next iec61851_tick,
+	// the state in the response belongs to evaluated_sample_sequence
+	response->iec61851_state            = iec61851.state;
+	response->cp_pwm_duty_cycle         = evse_get_cp_duty_cycle();
+	response->contactor                 = evse_get_contactor();
+	response->sample_sequence           = ads1118.sample_sequence;
+	response->evaluated_sample_sequence = iec61851.last_sample_sequence;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse stop_replay(const StopReplay *data) {
+	ads1118_replay_stop();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+
+BootloaderHandleMessageResponse set_state_callback_configuration(const SetStateCallbackConfiguration *data) {
+	state_callback_configuration.period              = data->period;
+	state_callback_configuration.value_has_to_change = data->value_has_to_change;
+	state_callback_configuration.resend              = true;
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_state_callback_configuration(const GetStateCallbackConfiguration *data, GetStateCallbackConfiguration_Response *response) {
+	response->header.length       = sizeof(GetStateCallbackConfiguration_Response);
+	response->period              = state_callback_configuration.period;
+	response->value_has_to_change = state_callback_configuration.value_has_to_change;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse set_button_state_callback_configuration(const SetButtonStateCallbackConfiguration *data) {
+	button_state_callback_configuration.period              = data->period;
+	button_state_callback_configuration.value_has_to_change = data->value_has_to_change;
+	button_state_callback_configuration.resend              = true;
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_button_state_callback_configuration(const GetButtonStateCallbackConfiguration *data, GetButtonStateCallbackConfiguration_Response *response) {
+	response->header.length       = sizeof(GetButtonStateCallbackConfiguration_Response);
+	response->period              = button_state_callback_configuration.period;
+	response->value_has_to_change = button_state_callback_configuration.value_has_to_change;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+// The generations start at 1 after every reset, the epoch tells the host which reset they belong to.
+// There is no random number generator, the epoch is taken from the CPU cycle counter at the first
+// query (the host message does not arrive synchronous to the CPU clock) mixed with the UID.
+static uint32_t all_data_1_get_epoch(void) {
+	if(all_data_1_epoch == 0) {
+		all_data_1_epoch = MAX(1, communication_get_cycles() ^ (bootloader_get_uid()*2654435761u));
+	}
+
+	return all_data_1_epoch;
+}
+
+// The data of get_all_data_1 is compared group by group with the data of the previous query.
+// Each changed group gets a new generation. The response contains all groups that changed
+// after last_generation (all groups if last_generation is 0 or from another epoch, e.g. after a reset).
+//
+// Only the state at the time of a query is compared, a value that changes and changes back
+// between two queries is not reported (e.g. a short button press or a state that was left again).
+// Use the state and button callbacks if such changes must not be missed.
+BootloaderHandleMessageResponse get_all_data_1_delta(const GetAllData1Delta *data, GetAllData1Delta_Response *response) {
+	GetAllData1_Response current;
+	get_all_data_1(NULL, &current);
+
+	const uint8_t *current_data = ((const uint8_t*)&current) + sizeof(TFPMessageHeader);
+	const uint8_t *last_data    = ((const uint8_t*)&all_data_1_last) + sizeof(TFPMessageHeader);
+
+	bool changed = false;
+	for(uint8_t i = 0; i < ALL_DATA_1_GROUP_NUM; i++) {
+		const uint8_t offset = all_data_1_group_offset[i];
+		const uint8_t length = all_data_1_group_offset[i+1] - offset;
+		if(memcmp(current_data + offset, last_data + offset, length) != 0) {
+			if(!changed) {
+				all_data_1_generation++;
+				changed = true;
+			}
+			all_data_1_group_generation[i] = all_data_1_generation;
+		}
+	}
+	all_data_1_last = current;
+
+	const uint32_t epoch     = all_data_1_get_epoch();
+	const bool send_all      = (data->last_epoch != epoch) || (data->last_generation == 0) || (data->last_generation > all_data_1_generation);
+	response->epoch          = epoch;
+	response->generation     = all_data_1_generation;
+	response->changed_groups = 0;
+
+	uint8_t length = 0;
+	for(uint8_t i = 0; i < ALL_DATA_1_GROUP_NUM; i++) {
+		if(send_all || (all_data_1_group_generation[i] > data->last_generation)) {
+			const uint8_t offset       = all_data_1_group_offset[i];
+			const uint8_t group_length = all_data_1_group_offset[i+1] - offset;
+			memcpy(response->data + length, current_data + offset, group_length);
+			length                   += group_length;
+			response->changed_groups |= 1 << i;
+		}
+	}
+
+	response->header.length = sizeof(GetAllData1Delta_Response) - sizeof(response->data) + length;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_handler_statistics(const GetHandlerStatistics *data, GetHandlerStatistics_Response *response) {
+	if(data->function_id >= COMMUNICATION_FID_NUM) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	const HandlerStatistics *statistics = &handler_statistics[data->function_id];
+	response->header.length = sizeof(GetHandlerStatistics_Response);
+	response->count         = statistics->count;
+	response->max_cycles    = statistics->max_cycles;
+	response->avg_cycles    = (statistics->avg_cycles_x16 + 8) >> 4;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse reset_handler_statistics(const ResetHandlerStatistics *data) {
+	memset(handler_statistics, 0, sizeof(handler_statistics));
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+// Returns true if a callback with the given value is to be sent now.
+// value and last_value are the callback payloads (without header).
+static bool callback_is_due(CallbackConfiguration *config, const uint8_t *value, uint8_t *last_value, const uint8_t length) {
+	if((config->period == 0) || !system_timer_is_time_elapsed_ms(config->last_time, config->period)) {
+		return false;
+	}
+
+	if(config->value_has_to_change && !config->resend && (memcmp(value, last_value, length) == 0)) {
+		return false;
+	}
+
+	memcpy(last_value, value, length);
+	config->last_time = system_timer_get_ms();
+	config->resend    = false;
+
+	return true;
+}
+
+bool handle_state_changed_callback(void) {
+	static bool is_buffered = false;
+	static StateChanged_Callback cb;
+	static uint8_t last_value[sizeof(StateChanged_Callback) - sizeof(TFPMessageHeader)];
+
+	if(!is_buffered) {
+		GetState_Response state;
+		get_state(NULL, &state);
+		if(!callback_is_due(&state_callback_configuration, &state.iec61851_state, last_value, sizeof(last_value))) {
+			return false;
+		}
+
+		tfp_make_default_header(&cb.header, bootloader_get_uid(), sizeof(StateChanged_Callback), FID_CALLBACK_STATE_CHANGED);
+		memcpy(&cb.iec61851_state, last_value, sizeof(last_value));
+	}
+
+	if(bootloader_spitfp_is_send_possible(&bootloader_status.st)) {
+		bootloader_spitfp_send_ack_and_message(&bootloader_status, (uint8_t*)&cb, sizeof(StateChanged_Callback));
+		is_buffered = false;
+		return true;
+	} else {
+		is_buffered = true;
+	}
+
+	return false;
+}
+
+bool handle_button_state_changed_callback(void) {
+	static bool is_buffered = false;
+	static ButtonStateChanged_Callback cb;
+	static uint8_t last_value[sizeof(ButtonStateChanged_Callback) - sizeof(TFPMessageHeader)];
+
+	if(!is_buffered) {
+		GetButtonState_Response button_state;
+		get_button_state(NULL, &button_state);
+		if(!callback_is_due(&button_state_callback_configuration, (uint8_t*)&button_state.button_press_time, last_value, sizeof(last_value))) {
+			return false;
+		}
+
+		tfp_make_default_header(&cb.header, bootloader_get_uid(), sizeof(ButtonStateChanged_Callback), FID_CALLBACK_BUTTON_STATE_CHANGED);
+		memcpy(&cb.button_press_time, last_value, sizeof(last_value));
+	}
+
+	if(bootloader_spitfp_is_send_possible(&bootloader_status.st)) {
+		bootloader_spitfp_send_ack_and_message(&bootloader_status, (uint8_t*)&cb, sizeof(ButtonStateChanged_Callback));
+		is_buffered = false;
+		return true;
+	} else {
+		is_buffered = true;
+	}
+
+	return false;
+}
 
 void communication_tick(void) {
-//	communication_callback_tick();
+	communication_callback_tick();
 }
 
 void communication_init(void) {
-//	communication_callback_init();
+	all_data_1_epoch      = 0;
+	all_data_1_generation = 0;
+	memset(all_data_1_group_generation, 0, sizeof(all_data_1_group_generation));
+	memset(&all_data_1_last, 0, sizeof(all_data_1_last));
+
+	communication_callback_init();
 }
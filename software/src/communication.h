@@ -99,7 +99,28 @@ void communication_init(void);
 #define EVSE_STATUS_LED_CONFIG_SHOW_HEARTBEAT 2
 #define EVSE_STATUS_LED_CONFIG_SHOW_STATUS 3
 
+#define EVSE_CP_MEASUREMENT_MODE_FREE_RUNNING 0
+#define EVSE_CP_MEASUREMENT_MODE_PWM_SYNCHRONOUS 1
+#define EVSE_CP_MEASUREMENT_MODE_HIGH_RATE 2
+
+#define EVSE_ADC_CAPTURE_STATE_RUNNING 0
+#define EVSE_ADC_CAPTURE_STATE_TRIGGERED 1
+#define EVSE_ADC_CAPTURE_STATE_DONE 2
+
+#define EVSE_STATE_JOURNAL_SOURCE_RAM 0
+#define EVSE_STATE_JOURNAL_SOURCE_EEPROM 1
+
+#define EVSE_STATE_JOURNAL_FREEZE_REASON_NONE 0
+#define EVSE_STATE_JOURNAL_FREEZE_REASON_STATE_EF 1
+#define EVSE_STATE_JOURNAL_FREEZE_REASON_CONTACTOR_ERROR 2
+
 // Function and callback IDs and structs
+
+// SetChargingSlotDefault and SetBoostMode are persisted EVSE_CONFIG_SAVE_DELAY (1s)
+// after the first change, a burst of changes results in a single EEPROM page write.
+// The pending write is flushed before the firmware restarts itself (communication
+// watchdog), FactoryReset discards it. A power loss or a reset through the
+// bootloader (Reset function, firmware update) within this 1s loses the change.
 #define FID_GET_STATE 1
 #define FID_GET_HARDWARE_CONFIGURATION 2
 #define FID_GET_LOW_LEVEL_STATE 3
@@ -127,6 +148,41 @@ void communication_init(void);
 #define FID_GET_BOOST_CURRENT 25
 #define FID_SET_PWM_OVERRIDE 26
 #define FID_GET_PWM_OVERRIDE 27
+#define FID_SET_CP_MEASUREMENT_MODE 28
+#define FID_GET_CP_MEASUREMENT_MODE 29
+#define FID_SET_ADC_CHANNEL_INTERVALS 30
+#define FID_GET_ADC_CHANNEL_INTERVALS 31
+#define FID_SET_ADC_CAPTURE_CONFIG 32
+#define FID_GET_ADC_CAPTURE_CONFIG 33
+#define FID_ARM_ADC_CAPTURE 34
+#define FID_TRIGGER_ADC_CAPTURE 35
+#define FID_GET_ADC_CAPTURE_STATE 36
+#define FID_GET_ADC_CAPTURE_LOW_LEVEL 37
+#define FID_GET_ADC_ERROR_COUNT 38
+#define FID_GET_CONTACTOR_OFF_LATENCY 39
+#define FID_RESET_CONTACTOR_OFF_LATENCY 40
+#define FID_GET_STATE_JOURNAL_STATE 41
+#define FID_GET_STATE_JOURNAL_LOW_LEVEL 42
+#define FID_RESET_STATE_JOURNAL 43
+#define FID_REPLAY_SAMPLE 44
+#define FID_STOP_REPLAY 45
+#define FID_SET_STATE_CALLBACK_CONFIGURATION 46
+#define FID_GET_STATE_CALLBACK_CONFIGURATION 47
+#define FID_SET_BUTTON_STATE_CALLBACK_CONFIGURATION 48
+#define FID_GET_BUTTON_STATE_CALLBACK_CONFIGURATION 49
+
+#define FID_CALLBACK_STATE_CHANGED 50
+#define FID_CALLBACK_BUTTON_STATE_CHANGED 51
+
+#define FID_GET_ALL_DATA_1_DELTA 52
+#define FID_GET_HANDLER_STATISTICS 53
+#define FID_RESET_HANDLER_STATISTICS 54
+#define FID_SET_CHARGING_SLOTS 55
+#define FID_GET_LIMITING_CHARGING_SLOT 56
+#define FID_SET_CHARGING_SLOT_TTL 57
+#define FID_GET_CHARGING_SLOT_TTL 58
+
+#define COMMUNICATION_FID_NUM (FID_GET_CHARGING_SLOT_TTL + 1) // Last FID + 1
 
 
 typedef struct {
@@ -405,6 +461,299 @@ typedef struct {
 	uint16_t pwm_override;
 } __attribute__((__packed__)) GetPWMOverride_Response;
 
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t mode;
+} __attribute__((__packed__)) SetCPMeasurementMode;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetCPMeasurementMode;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t mode;
+} __attribute__((__packed__)) GetCPMeasurementMode_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t pp_interval;
+	uint8_t temperature_interval;
+} __attribute__((__packed__)) SetADCChannelIntervals;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetADCChannelIntervals;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t pp_interval;
+	uint8_t temperature_interval;
+	int16_t temperature;
+} __attribute__((__packed__)) GetADCChannelIntervals_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	bool trigger_on_state_change;
+	uint8_t post_trigger_samples;
+} __attribute__((__packed__)) SetADCCaptureConfig;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetADCCaptureConfig;
+
+typedef struct {
+	TFPMessageHeader header;
+	bool trigger_on_state_change;
+	uint8_t post_trigger_samples;
+} __attribute__((__packed__)) GetADCCaptureConfig_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) ArmADCCapture;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) TriggerADCCapture;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetADCCaptureState;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t state;
+	uint32_t trigger_time;
+	uint8_t sample_count;
+	uint8_t sample_size;
+} __attribute__((__packed__)) GetADCCaptureState_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t stream_chunk_offset;
+} __attribute__((__packed__)) GetADCCaptureLowLevel;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t stream_length;
+	uint16_t stream_chunk_offset;
+	uint8_t stream_chunk_data[60];
+} __attribute__((__packed__)) GetADCCaptureLowLevel_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetADCErrorCount;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t spi_error_count;
+	uint32_t config_error_count;
+} __attribute__((__packed__)) GetADCErrorCount_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetContactorOffLatency;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t latency_last;
+	uint32_t latency_max;
+	uint32_t decision_latency_max;
+	uint32_t output_latency_max;
+	uint32_t histogram[8];
+} __attribute__((__packed__)) GetContactorOffLatency_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) ResetContactorOffLatency;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetStateJournalState;
+
+typedef struct {
+	TFPMessageHeader header;
+	bool frozen;
+	uint8_t freeze_reason;
+	uint32_t freeze_time;
+	uint32_t total_count;
+	uint16_t ram_length;
+	uint16_t eeprom_length;
+} __attribute__((__packed__)) GetStateJournalState_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t source;
+	uint16_t stream_chunk_offset;
+} __attribute__((__packed__)) GetStateJournalLowLevel;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t stream_length;
+	uint16_t stream_chunk_offset;
+	uint8_t stream_chunk_data[60];
+} __attribute__((__packed__)) GetStateJournalLowLevel_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	bool clear_eeprom;
+} __attribute__((__packed__)) ResetStateJournal;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t password;
+	uint16_t cp_pe_resistance;
+	uint16_t pp_pe_resistance;
+} __attribute__((__packed__)) ReplaySample;
+
+typedef struct {
+	TFPMessageHeader header;
+	bool success;
+	uint8_t iec61851_state;
+	uint16_t cp_pwm_duty_cycle;
+	bool contactor;
+	uint32_t sample_sequence;
+	uint32_t evaluated_sample_sequence;
+} __attribute__((__packed__)) ReplaySample_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) StopReplay;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t period;
+	bool value_has_to_change;
+} __attribute__((__packed__)) SetStateCallbackConfiguration;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetStateCallbackConfiguration;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t period;
+	bool value_has_to_change;
+} __attribute__((__packed__)) GetStateCallbackConfiguration_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t period;
+	bool value_has_to_change;
+} __attribute__((__packed__)) SetButtonStateCallbackConfiguration;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetButtonStateCallbackConfiguration;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t period;
+	bool value_has_to_change;
+} __attribute__((__packed__)) GetButtonStateCallbackConfiguration_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t iec61851_state;
+	uint8_t charger_state;
+	uint8_t contactor_state;
+	uint8_t contactor_error;
+	uint16_t allowed_charging_current;
+	uint8_t error_state;
+	uint8_t lock_state;
+} __attribute__((__packed__)) StateChanged_Callback;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t button_press_time;
+	uint32_t button_release_time;
+	bool button_pressed;
+} __attribute__((__packed__)) ButtonStateChanged_Callback;
+
+#define ALL_DATA_1_GROUP_NUM 11
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t last_epoch;
+	uint32_t last_generation;
+} __attribute__((__packed__)) GetAllData1Delta;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t epoch;      // Changes with every reset, generations of different epochs can't be compared
+	uint32_t generation;
+	uint16_t changed_groups;
+	uint8_t data[sizeof(GetAllData1_Response) - sizeof(TFPMessageHeader)]; // Only changed groups, length depends on changed_groups
+} __attribute__((__packed__)) GetAllData1Delta_Response;
+
+#define SET_CHARGING_SLOTS_MAX_NUM 8
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t slot;
+	uint32_t ttl;
+	uint16_t expired_current;
+} __attribute__((__packed__)) SetChargingSlotTTL;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t slot;
+} __attribute__((__packed__)) GetChargingSlotTTL;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t ttl;
+	uint16_t expired_current;
+	uint32_t time_remaining;
+} __attribute__((__packed__)) GetChargingSlotTTL_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetLimitingChargingSlot;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t max_current;
+	uint8_t slot;
+} __attribute__((__packed__)) GetLimitingChargingSlot_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t slot_count;
+	uint8_t slot[SET_CHARGING_SLOTS_MAX_NUM];
+	uint16_t max_current[SET_CHARGING_SLOTS_MAX_NUM];
+	uint8_t active_and_clear_on_disconnect[SET_CHARGING_SLOTS_MAX_NUM];
+} __attribute__((__packed__)) SetChargingSlots;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t function_id;
+} __attribute__((__packed__)) GetHandlerStatistics;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t count;
+	uint32_t max_cycles;
+	uint32_t avg_cycles; // Moving average, each call has a weight of 1/16
+} __attribute__((__packed__)) GetHandlerStatistics_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) ResetHandlerStatistics;
+
+typedef struct {
+	uint32_t count;
+	uint32_t max_cycles;
+	uint32_t avg_cycles_x16; // Moving average in 1/16 cycles, no division on the Cortex-M0
+} HandlerStatistics;
+
+typedef struct {
+	uint32_t period;          // Minimum time between two callbacks in ms, 0 = disabled
+	bool value_has_to_change; // Only send callback if the value changed since the last callback
+	uint32_t last_time;
+	bool resend;              // Send next callback even if the value did not change (after configuration change)
+} CallbackConfiguration;
+
 
 // Function prototypes
 BootloaderHandleMessageResponse get_state(const GetState *data, GetState_Response *response);
@@ -434,13 +783,45 @@ BootloaderHandleMessageResponse set_boost_current(const SetBoostCurrent *data);
 BootloaderHandleMessageResponse get_boost_current(const GetBoostCurrent *data, GetBoostCurrent_Response *response);
 BootloaderHandleMessageResponse set_pwm_override(const SetPWMOverride *data);
 BootloaderHandleMessageResponse get_pwm_override(const GetPWMOverride *data, GetPWMOverride_Response *response);
+BootloaderHandleMessageResponse set_cp_measurement_mode(const SetCPMeasurementMode *data);
+BootloaderHandleMessageResponse get_cp_measurement_mode(const GetCPMeasurementMode *data, GetCPMeasurementMode_Response *response);
+BootloaderHandleMessageResponse set_adc_channel_intervals(const SetADCChannelIntervals *data);
+BootloaderHandleMessageResponse get_adc_channel_intervals(const GetADCChannelIntervals *data, GetADCChannelIntervals_Response *response);
+BootloaderHandleMessageResponse set_adc_capture_config(const SetADCCaptureConfig *data);
+BootloaderHandleMessageResponse get_adc_capture_config(const GetADCCaptureConfig *data, GetADCCaptureConfig_Response *response);
+BootloaderHandleMessageResponse arm_adc_capture(const ArmADCCapture *data);
+BootloaderHandleMessageResponse trigger_adc_capture(const TriggerADCCapture *data);
+BootloaderHandleMessageResponse get_adc_capture_state(const GetADCCaptureState *data, GetADCCaptureState_Response *response);
+BootloaderHandleMessageResponse get_adc_capture_low_level(const GetADCCaptureLowLevel *data, GetADCCaptureLowLevel_Response *response);
+BootloaderHandleMessageResponse get_adc_error_count(const GetADCErrorCount *data, GetADCErrorCount_Response *response);
+BootloaderHandleMessageResponse get_contactor_off_latency(const GetContactorOffLatency *data, GetContactorOffLatency_Response *response);
+BootloaderHandleMessageResponse reset_contactor_off_latency(const ResetContactorOffLatency *data);
+BootloaderHandleMessageResponse get_state_journal_state(const GetStateJournalState *data, GetStateJournalState_Response *response);
+BootloaderHandleMessageResponse get_state_journal_low_level(const GetStateJournalLowLevel *data, GetStateJournalLowLevel_Response *response);
+BootloaderHandleMessageResponse reset_state_journal(const ResetStateJournal *data);
+BootloaderHandleMessageResponse replay_sample(const ReplaySample *data, ReplaySample_Response *response);
+BootloaderHandleMessageResponse stop_replay(const StopReplay *data);
+BootloaderHandleMessageResponse set_state_callback_configuration(const SetStateCallbackConfiguration *data);
+BootloaderHandleMessageResponse get_state_callback_configuration(const GetStateCallbackConfiguration *data, GetStateCallbackConfiguration_Response *response);
+BootloaderHandleMessageResponse set_button_state_callback_configuration(const SetButtonStateCallbackConfiguration *data);
+BootloaderHandleMessageResponse get_button_state_callback_configuration(const GetButtonStateCallbackConfiguration *data, GetButtonStateCallbackConfiguration_Response *response);
+BootloaderHandleMessageResponse get_all_data_1_delta(const GetAllData1Delta *data, GetAllData1Delta_Response *response);
+BootloaderHandleMessageResponse get_handler_statistics(const GetHandlerStatistics *data, GetHandlerStatistics_Response *response);
+BootloaderHandleMessageResponse reset_handler_statistics(const ResetHandlerStatistics *data);
+BootloaderHandleMessageResponse set_charging_slots(const SetChargingSlots *data);
+BootloaderHandleMessageResponse get_limiting_charging_slot(const GetLimitingChargingSlot *data, GetLimitingChargingSlot_Response *response);
+BootloaderHandleMessageResponse set_charging_slot_ttl(const SetChargingSlotTTL *data);
+BootloaderHandleMessageResponse get_charging_slot_ttl(const GetChargingSlotTTL *data, GetChargingSlotTTL_Response *response);
 
 // Callbacks
-
+bool handle_state_changed_callback(void);
+bool handle_button_state_changed_callback(void);
 
 #define COMMUNICATION_CALLBACK_TICK_WAIT_MS 1
-#define COMMUNICATION_CALLBACK_HANDLER_NUM 0
+#define COMMUNICATION_CALLBACK_HANDLER_NUM 2
 #define COMMUNICATION_CALLBACK_LIST_INIT \
+	handle_state_changed_callback, \
+	handle_button_state_changed_callback, \
 
 
 #endif
@@ -24,8 +24,10 @@
 
 #include "xmc_gpio.h"
 #include "xmc_spi.h"
+#include "xmc_eru.h"
+#include "xmc_ccu4.h"
 
-#define ADS1118_SPI_BAUDRATE           100000
+#define ADS1118_SPI_BAUDRATE           2000000 // ADS1118 supports up to 4MHz, we stay at half of that
 #define ADS1118_USIC_CHANNEL           USIC0_CH1
 #define ADS1118_USIC_SPI               XMC_SPI0_CH1
 
@@ -55,5 +57,21 @@
 #define ADS1118_MISO_INPUT             XMC_USIC_CH_INPUT_DX0
 #define ADS1118_MISO_SOURCE            0b010 // DX0C
 
+// DOUT/DRDY (P0.6) is connected to ERU0.2B1,
+// the falling edge triggers ERU0 OGU2 -> SR2 -> IRQ 5
+#define ADS1118_DRDY_ERU               XMC_ERU0
+#define ADS1118_DRDY_ERU_ETL_CHANNEL   2
+#define ADS1118_DRDY_ERU_INPUT         XMC_ERU_ETL_INPUT_B1
+#define ADS1118_DRDY_ERU_OGU_CHANNEL   2
+#define ADS1118_DRDY_ERU_TRIGGER       XMC_ERU_ETL_OUTPUT_TRIGGER_CHANNEL2
+#define ADS1118_DRDY_IRQ               5
+#define ADS1118_DRDY_IRQ_PRIORITY      1
+
+// Period match of the CP PWM slice (CCU40.CC40) -> SR0 -> IRQ 21.
+// Used in the PWM synchronous mode to start the CP conversion and to count the PWM periods
+// until DRDY. It has a higher priority than DRDY, so that no period is missed during a read.
+#define ADS1118_PWM_SYNC_SR            XMC_CCU4_SLICE_SR_ID_0
+#define ADS1118_PWM_SYNC_IRQ           21
+#define ADS1118_PWM_SYNC_IRQ_PRIORITY  0
 
 #endif
\ No newline at end of file
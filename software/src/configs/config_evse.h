@@ -25,6 +25,7 @@
 #include "xmc_gpio.h"
 
 #define EVSE_CP_PWM_SLICE_NUMBER       0
+#define EVSE_CP_PWM_SLICE              CCU40_CC40
 #define EVSE_CP_PWM_PIN                P1_0
 
 #define EVSE_MOTOR_ENABLE_SLICE_NUMBER 3
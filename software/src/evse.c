@@ -21,6 +21,8 @@
 
 #include "evse.h"
 
+#include <string.h>
+
 #include "configs/config_evse.h"
 #include "bricklib2/hal/ccu4_pwm/ccu4_pwm.h"
 #include "bricklib2/hal/system_timer/system_timer.h"
@@ -40,6 +42,47 @@
 
 EVSE evse;
 
+// Upper limits (exclusive) of the contactor off latency histogram buckets in ms,
+// the last bucket counts everything above. IEC 61851 requires at most 100ms.
+static const uint16_t evse_latency_bucket_limits[EVSE_LATENCY_BUCKET_NUM-1] = {10, 20, 30, 50, 75, 100, 200};
+
+void evse_reset_contactor_off_latency(void) {
+	evse.contactor_off_latency_last         = 0;
+	evse.contactor_off_latency_max          = 0;
+	evse.contactor_off_decision_latency_max = 0;
+	evse.contactor_off_output_latency_max   = 0;
+	memset(evse.contactor_off_latency_histogram, 0, sizeof(evse.contactor_off_latency_histogram));
+}
+
+static void evse_handle_contactor_off_latency(void) {
+	// Measure time between the first CP sample that showed that the car left state C and contactor off
+	if(ads1118.cp_state_c_exit_time != 0) {
+		const uint32_t now = system_timer_get_ms();
+		evse.contactor_off_latency_last = now - ads1118.cp_state_c_exit_time;
+		evse.contactor_off_latency_max  = MAX(evse.contactor_off_latency_max, evse.contactor_off_latency_last);
+
+		// Split up in ADC sample -> state machine and state machine -> contactor
+		if(evse.contactor_off_decision_time != 0) {
+			const uint32_t decision_latency = evse.contactor_off_decision_time - ads1118.cp_state_c_exit_time;
+			if(decision_latency <= evse.contactor_off_latency_last) {
+				evse.contactor_off_decision_latency_max = MAX(evse.contactor_off_decision_latency_max, decision_latency);
+				evse.contactor_off_output_latency_max   = MAX(evse.contactor_off_output_latency_max, now - evse.contactor_off_decision_time);
+			}
+		}
+
+		uint8_t bucket = 0;
+		while((bucket < EVSE_LATENCY_BUCKET_NUM-1) && (evse.contactor_off_latency_last >= evse_latency_bucket_limits[bucket])) {
+			bucket++;
+		}
+		evse.contactor_off_latency_histogram[bucket]++;
+
+		ads1118.cp_state_c_exit_time = 0;
+		logd("Contactor off latency: %dms (max %dms)\n\r", evse.contactor_off_latency_last, evse.contactor_off_latency_max);
+	}
+
+	evse.contactor_off_decision_time = 0;
+}
+
 void evse_set_output(uint16_t cp_duty_cycle, const bool contactor) {
 	if ((0 < evse.pwm_override) && (evse.pwm_override <= 1000)) {
 		cp_duty_cycle = evse.pwm_override;
@@ -59,7 +102,7 @@ void evse_set_output(uint16_t cp_duty_cycle, const bool contactor) {
 	}
 #endif
 
-	if(((bool)XMC_GPIO_GetInput(EVSE_RELAY_PIN)) != contactor) {
+	if(evse_get_contactor() != contactor) {
 		if(((cp_duty_cycle == 0) || (cp_duty_cycle == 1000)) && (!contactor)) {
 			// If the duty cycle is set to either 0% or 100% PWM and the contactor is supposed to be turned off,
 			// it is possible that the WARP Charger wants to turn off the charging session while the car
@@ -91,19 +134,23 @@ void evse_set_output(uint16_t cp_duty_cycle, const bool contactor) {
 		}
 
 
-		// Ignore all ADC measurements for a while if the contactor is
-		// switched on or off, to be sure that the resulting EMI spike does
-		// not give us a wrong measurement.
-		ads1118.cp_invalid_counter = MAX(4, ads1118.cp_invalid_counter);
-		ads1118.pp_invalid_counter = MAX(4, ads1118.pp_invalid_counter);
+		// Ignore ADC measurements until they are settled (at most 4) if the
+		// contactor is switched on or off, to be sure that the resulting EMI
+		// spike does not give us a wrong measurement.
+		ads1118_settle_start(&ads1118.cp_settle, 4);
+		ads1118_settle_start(&ads1118.pp_settle, 4);
 
 		// Also ignore contactor check for a while when contactor changes state
 		contactor_check.invalid_counter = MAX(5, contactor_check.invalid_counter);
 
-		if(contactor) {
+		if(ads1118.replay_active) {
+			// Trace replay: The relay is never switched
+			evse.replay_contactor = contactor;
+		} else if(contactor) {
 			XMC_GPIO_SetOutputHigh(EVSE_RELAY_PIN);
 		} else {
 			XMC_GPIO_SetOutputLow(EVSE_RELAY_PIN);
+			evse_handle_contactor_off_latency();
 		}
 	}
 
@@ -246,8 +293,26 @@ void evse_load_calibration(void) {
 	}
 }
 
+// Every EEPROM page write is a full erase/program cycle of the emulated EEPROM,
+// so we only write a page if its content actually changed.
+// Together with the page buffer of the caller this needs 512 byte of stack.
+void evse_write_eeprom_page_if_changed(const uint32_t page_num, uint32_t *page) {
+	uint32_t page_current[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+	bootloader_read_eeprom_page(page_num, page_current);
+
+	if(memcmp(page, page_current, EEPROM_PAGE_SIZE) == 0) {
+		evse.eeprom_write_skip_count++;
+		return;
+	}
+
+	bootloader_write_eeprom_page(page_num, page);
+	evse.eeprom_write_count++;
+}
+
 void evse_save_calibration(void) {
+	// Read the page first, so that unused words stay untouched
 	uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+	bootloader_read_eeprom_page(EVSE_CALIBRATION_PAGE, page);
 
 	page[EVSE_CALIBRATION_MAGIC_POS]       = EVSE_CALIBRATION_MAGIC;
 	page[EVSE_CALIBRATION_MUL_POS]         = ads1118.cp_cal_mul          + INT16_MAX;
@@ -258,7 +323,7 @@ void evse_save_calibration(void) {
 		page[EVSE_CALIBRATION_880_POS + i] = ads1118.cp_cal_880ohm[i]    + INT16_MAX;
 	}
 
-	bootloader_write_eeprom_page(EVSE_CALIBRATION_PAGE, page);
+	evse_write_eeprom_page_if_changed(EVSE_CALIBRATION_PAGE, page);
 }
 
 void evse_load_user_calibration(void) {
@@ -297,7 +362,9 @@ void evse_load_user_calibration(void) {
 }
 
 void evse_save_user_calibration(void) {
+	// Read the page first, so that unused words stay untouched
 	uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+	bootloader_read_eeprom_page(EVSE_USER_CALIBRATION_PAGE, page);
 
 	page[EVSE_USER_CALIBRATION_MAGIC_POS]       = EVSE_USER_CALIBRATION_MAGIC;
 	page[EVSE_USER_CALIBRATION_ACTIV_POS]       = ads1118.cp_user_cal_active;
@@ -309,7 +376,7 @@ void evse_save_user_calibration(void) {
 		page[EVSE_USER_CALIBRATION_880_POS + i] = ads1118.cp_user_cal_880ohm[i]    + INT16_MAX;
 	}
 
-	bootloader_write_eeprom_page(EVSE_USER_CALIBRATION_PAGE, page);
+	evse_write_eeprom_page_if_changed(EVSE_USER_CALIBRATION_PAGE, page);
 }
 
 void evse_load_config(void) {
@@ -365,8 +432,21 @@ void evse_load_config(void) {
 	logd(" * slot active/clear %d %d %d %d %d %d %d %d", charging_slot.clear_on_disconnect_default[0], charging_slot.clear_on_disconnect_default[1], charging_slot.clear_on_disconnect_default[2], charging_slot.clear_on_disconnect_default[3], charging_slot.clear_on_disconnect_default[4], charging_slot.clear_on_disconnect_default[5], charging_slot.clear_on_disconnect_default[6], charging_slot.clear_on_disconnect_default[7]);
 }
 
+// The config is changed by the API (charging slot defaults, boost mode), potentially
+// often and in bursts. We only mark it as dirty here and write it from evse_tick
+// after EVSE_CONFIG_SAVE_DELAY, so that a burst of changes results in one page write
+// and the API handler does not stall on the flash erase.
 void evse_save_config(void) {
+	if(!evse.config_save_pending) {
+		evse.config_save_pending = true;
+		evse.config_save_time    = system_timer_get_ms();
+	}
+}
+
+static void evse_save_config_now(void) {
+	// Read the page first, the state journal is also stored here
 	uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+	bootloader_read_eeprom_page(EVSE_CONFIG_PAGE, page);
 
 	page[EVSE_CONFIG_MAGIC_POS]          = EVSE_CONFIG_MAGIC;
 	page[EVSE_CONFIG_MANAGED_POS]        = evse.legacy_managed;
@@ -382,16 +462,36 @@ void evse_save_config(void) {
 	page[EVSE_CONFIG_MAGIC2_POS] = EVSE_CONFIG_MAGIC2;
 	page[EVSE_CONFIG_BOOST_POS]  = evse.boost_mode_enabled;
 
-	bootloader_write_eeprom_page(EVSE_CONFIG_PAGE, page);
+	evse.config_save_pending = false;
+	evse_write_eeprom_page_if_changed(EVSE_CONFIG_PAGE, page);
+}
+
+// Writes a deferred config save immediately, has to be called before a reset
+static void evse_flush_config(void) {
+	if(evse.config_save_pending) {
+		evse_save_config_now();
+	}
 }
 
 void evse_factory_reset(void) {
+	// The zeroed config page replaces a pending config save,
+	// it also clears the state journal in the EEPROM
+	evse.config_save_pending = false;
+
 	uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)] = {0};
 	bootloader_write_eeprom_page(EVSE_CONFIG_PAGE, page);
 
 	NVIC_SystemReset();
 }
 
+bool evse_get_contactor(void) {
+	if(ads1118.replay_active) {
+		return evse.replay_contactor;
+	}
+
+	return XMC_GPIO_GetInput(EVSE_RELAY_PIN);
+}
+
 uint16_t evse_get_cp_duty_cycle(void) {
 	return (64000 - ccu4_pwm_get_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER))/64;
 }
@@ -401,10 +501,10 @@ void evse_set_cp_duty_cycle(const uint16_t duty_cycle) {
 	const uint16_t new_cp_duty_cycle     = (uint16_t)(64000 - duty_cycle*64);
 
 	if(current_cp_duty_cycle != duty_cycle) {
-		// Ignore the next 10 ADC measurements between CP/PE after we
-		// change PWM duty cycle of CP to be sure that that the measurement
-		// is not of any in-between state.
-		ads1118.cp_invalid_counter = MAX(2, ads1118.cp_invalid_counter);
+		// Ignore the ADC measurements between CP/PE until they are settled
+		// (at most 2) after we change PWM duty cycle of CP to be sure that
+		// that the measurement is not of any in-between state.
+		ads1118_settle_start(&ads1118.cp_settle, 2);
 		ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, new_cp_duty_cycle);
 	}
 }
@@ -465,15 +565,30 @@ void evse_tick_debug(void) {
 		uartbb_printf("Jumper configuration: %d\n\r", evse.config_jumper_current);
 		uartbb_printf("LED State: %d\n\r", led.state);
 		uartbb_printf("Resistance: CP %d, PP %d\n\r", ads1118.cp_pe_resistance, ads1118.pp_pe_resistance);
+		uartbb_printf("Temperature: %d\n\r", ads1118.temperature);
+		uartbb_printf("ADC errors: SPI %d, config %d\n\r", ads1118.spi_error_count, ads1118.config_error_count);
+		uartbb_printf("Settle: CP blind %dms, saved %d, PP blind %dms, saved %d\n\r", ads1118.cp_settle.last_blind_time, ads1118.cp_settle.saved_samples, ads1118.pp_settle.last_blind_time, ads1118.pp_settle.saved_samples);
 		uartbb_printf("CP PWM duty cycle: %d\n\r", ccu4_pwm_get_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER));
 		uartbb_printf("Contactor Check: AC1 %d, AC2 %d, State: %d, Error: %d\n\r", contactor_check.ac1_edge_count, contactor_check.ac2_edge_count, contactor_check.state, contactor_check.error);
 		uartbb_printf("GPIO: Input %d, Output %d\n\r", XMC_GPIO_GetInput(EVSE_INPUT_GP_PIN), XMC_GPIO_GetInput(EVSE_OUTPUT_GP_PIN));
 		uartbb_printf("Lock State: %d\n\r", lock.state);
+		uartbb_printf("Contactor off latency: last %dms, max %dms (decision %dms, output %dms)\n\r", evse.contactor_off_latency_last, evse.contactor_off_latency_max, evse.contactor_off_decision_latency_max, evse.contactor_off_output_latency_max);
+		uartbb_printf("Loop rate: main %d/s, IEC61851 %d/s\n\r", evse.loop_rate, evse.iec61851_evaluation_rate);
+		uartbb_printf("EEPROM: writes %d, skipped %d, config pending %d\n\r", evse.eeprom_write_count, evse.eeprom_write_skip_count, evse.config_save_pending);
 	}
 #endif
 }
 
 void evse_tick(void) {
+	evse.loop_counter++;
+	if(system_timer_is_time_elapsed_ms(evse.loop_counter_time, 1000)) {
+		evse.loop_counter_time         = system_timer_get_ms();
+		evse.loop_rate                 = evse.loop_counter;
+		evse.iec61851_evaluation_rate  = iec61851.evaluation_count;
+		evse.loop_counter              = 0;
+		iec61851.evaluation_count      = 0;
+	}
+
 	// Wait 12 seconds on first startup for DC-Wächter calibration
 	if(evse.startup_time != 0 && !system_timer_is_time_elapsed_ms(evse.startup_time, 12000)) {
 #if 0
@@ -494,6 +609,10 @@ void evse_tick(void) {
 		}
 	}
 
+	if(evse.config_save_pending && system_timer_is_time_elapsed_ms(evse.config_save_time, EVSE_CONFIG_SAVE_DELAY)) {
+		evse_save_config_now();
+	}
+
 	// If the charging timer is running and the car is disconnected, stop the charging timer
 	if((evse.charging_time != 0) && (ads1118.cp_pe_resistance > 10000)) {
 		evse.charging_time = 0;
@@ -520,6 +639,7 @@ void evse_tick(void) {
 	if((evse.communication_watchdog_time != 0) && system_timer_is_time_elapsed_ms(evse.communication_watchdog_time, 1000*60*5)) {
 		// Only restart EVSE if brick-communication-watchdog triggers if no car is connected
 		if(iec61851.state == IEC61851_STATE_A) {
+			evse_flush_config();
 			NVIC_SystemReset();
 		}
 	}
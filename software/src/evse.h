@@ -38,6 +38,8 @@
 #define EVSE_CONFIG_JUMPER_SOFTWARE     7
 #define EVSE_CONFIG_JUMPER_UNCONFIGURED 8
 
+#define EVSE_LATENCY_BUCKET_NUM         8
+
 #define EVSE_CALIBRATION_PAGE           1
 #define EVSE_CALIBRATION_MAGIC_POS      0
 #define EVSE_CALIBRATION_MUL_POS        1
@@ -64,8 +66,11 @@
 #define EVSE_CONFIG_MANAGED_POS         1
 #define EVSE_CONFIG_MAGIC2_POS          2
 #define EVSE_CONFIG_BOOST_POS           3
+#define EVSE_CONFIG_JOURNAL_POS         4 // Words 4-46 are used by the state journal (see state_journal.h)
 #define EVSE_CONFIG_SLOT_DEFAULT_POS    48
 
+#define EVSE_CONFIG_SAVE_DELAY          1000 // ms between first config change and page write
+
 typedef struct {
 	uint16_t current[18];
 	uint8_t active_clear[18];
@@ -104,12 +109,31 @@ typedef struct {
 
 	uint32_t contactor_turn_off_time;
 
+	uint32_t contactor_off_latency_last; // ms between start of first CP sample outside of state C and contactor off
+	uint32_t contactor_off_latency_max;
+	uint32_t contactor_off_decision_time;         // Time of IEC61851 state change from C, 0 = none
+	uint32_t contactor_off_decision_latency_max;  // ms between first CP sample outside of state C and state change
+	uint32_t contactor_off_output_latency_max;    // ms between state change and contactor off
+	uint32_t contactor_off_latency_histogram[EVSE_LATENCY_BUCKET_NUM]; // see evse_latency_bucket_limits
+
+	uint32_t loop_counter;
+	uint32_t loop_counter_time;
+	uint32_t loop_rate;                // Main loop iterations per second
+	uint32_t iec61851_evaluation_rate; // IEC61851 state machine evaluations per second
+
 	bool boost_mode_enabled;
 
 	uint16_t boost_current;
 
 	uint16_t pwm_override;
 
+	bool replay_contactor; // Virtual contactor state during trace replay
+
+	bool config_save_pending;
+	uint32_t config_save_time;
+	uint32_t eeprom_write_count;      // EEPROM page writes since startup
+	uint32_t eeprom_write_skip_count; // EEPROM page writes skipped since content was unchanged
+
 	uint8_t storage[EVSE_STORAGE_PAGES][64];
 } EVSE;
 
@@ -118,8 +142,10 @@ extern EVSE evse;
 void evse_save_config(void);
 void evse_save_calibration(void);
 void evse_save_user_calibration(void);
-void evse_save_config(void);
+void evse_write_eeprom_page_if_changed(const uint32_t page_num, uint32_t *page);
 void evse_set_output(uint16_t cp_duty_cycle, const bool contactor);
+void evse_reset_contactor_off_latency(void);
+bool evse_get_contactor(void);
 uint16_t evse_get_cp_duty_cycle(void);
 void evse_set_cp_duty_cycle(const uint16_t duty_cycle);
 void evse_init(void);
@@ -26,10 +26,9 @@
 
 #include "bricklib2/utility/util_definitions.h"
 #include "bricklib2/logging/logging.h"
-#include "bricklib2/hal/ccu4_pwm/ccu4_pwm.h"
+#include "bricklib2/hal/system_timer/system_timer.h"
 #include "bricklib2/warp/contactor_check.h"
 
-#include "configs/config_evse.h"
 #include "ads1118.h"
 #include "iec61851.h"
 #include "lock.h"
@@ -37,38 +36,105 @@
 #include "led.h"
 #include "button.h"
 #include "charging_slot.h"
+#include "adc_capture.h"
+#include "state_journal.h"
 
 IEC61851 iec61851;
 
-void iec61851_set_state(IEC61851State state) {
-	if(state != iec61851.state) {
-		// If we change from an error state to something else we save the time
-		// If we then change to state C we wait at least 30 seconds
-		// -> Don't start charging immediately after error
-		if((iec61851.state == IEC61851_STATE_D) && (iec61851.last_error_time == 0)) {
-			iec61851.last_error_time = system_timer_get_ms();
-		}
-		if(iec61851.state == IEC61851_STATE_EF) { // User has to disconnect first for error state EF
-			iec61851.last_error_time = system_timer_get_ms();
+// Transitions of the state machine, the first matching transition is taken.
+// Vehicle quirks can be handled by adding a transition with the corresponding inputs.
+static const IEC61851Transition iec61851_transitions[] = {
+	// Errors that don't depend on the ADC measurements
+	{IEC61851_RESISTANCE_ANY,          0,    IEC61851_INPUT_CONTACTOR_ERROR,                         0, IEC61851_STATE_EF, 0,    4},
+	{IEC61851_RESISTANCE_ANY,          0,    IEC61851_INPUT_JUMPER_INVALID,                          0, IEC61851_STATE_EF, 0,    2},
+
+	// When an ID.3 is connected to the WARP charger and the duty cycle is already
+	// below 100% (the wallbox is ready) but the contactor is not yet activated, the
+	// ID.3 somtimes generates a spike in the resistance that we measure when it
+	// engages the resistor to apply 880 ohm between CP/PE. We have not seen this in
+	// other cars, we assume this is some kind of capacitive effect. To make sure
+	// that we don't cancel the charging here, we increase the STATE A threshold for
+	// this scenario and wait for at least 2500ms between B->A state change.
+	{IEC61851_CP_RESISTANCE_STATE_A*3, 0,    IEC61851_INPUT_ID3_MODE,                                0, IEC61851_STATE_A,  2500, 0},
+
+	// If the relay is not turned off we force the state machine to go to state B before it can go to state A.
+	// In state B it will turn the relay off and then later go to state A,
+	// but during the change from B to A the ID.3 mode can trigger (which it wouldn't otherwise).
+	{IEC61851_CP_RESISTANCE_STATE_A,   1000, IEC61851_INPUT_RELAY_OFF | IEC61851_INPUT_NOT_ID3_MODE, 0, IEC61851_STATE_A,  0,    0},
+	{IEC61851_CP_RESISTANCE_STATE_B,   200,  0,                                                      0, IEC61851_STATE_B,  0,    0},
+
+	// Car wants to charge, but no current is available.
+	// No hysteresis for C: It would delay C->D and the no current transition above has to use the same threshold.
+	{IEC61851_CP_RESISTANCE_STATE_C,   0,    IEC61851_INPUT_NO_CURRENT,   IEC61851_ACTION_STOP_CHARGING_TIMER, IEC61851_STATE_B,  0,    0},
+	{IEC61851_CP_RESISTANCE_STATE_C,   0,    0,                                                      0, IEC61851_STATE_C,  0,    0},
+	{IEC61851_CP_RESISTANCE_STATE_D,   0,    0,                                                      0, IEC61851_STATE_D,  0,    5},
+	{IEC61851_RESISTANCE_ANY,          0,    0,                                                      0, IEC61851_STATE_EF, 0,    5},
+};
+
+#define IEC61851_TRANSITIONS_NUM (sizeof(iec61851_transitions)/sizeof(IEC61851Transition))
+
+// Hold-off times for entering a state after another state was left.
+// A direct transition from one of the after_leaving states is never allowed.
+static const IEC61851HoldOff iec61851_hold_offs[] = {
+	// Don't start charging immediately after error (user has to disconnect first for error state EF)
+	{IEC61851_STATE_C, (1 << IEC61851_STATE_D) | (1 << IEC61851_STATE_EF), 30*1000},
+
+	// Don't start charging immediately after charging was stopped
+	{IEC61851_STATE_C, (1 << IEC61851_STATE_C),                            5*1000},
+};
+
+#define IEC61851_HOLD_OFFS_NUM (sizeof(iec61851_hold_offs)/sizeof(IEC61851HoldOff))
+
+static bool iec61851_hold_off_active(const IEC61851State state) {
+	for(uint8_t i = 0; i < IEC61851_HOLD_OFFS_NUM; i++) {
+		const IEC61851HoldOff *hold_off = &iec61851_hold_offs[i];
+		if(hold_off->state != state) {
+			continue;
 		}
-		if((state == IEC61851_STATE_C) && (iec61851.last_error_time != 0)) {
-			if(!system_timer_is_time_elapsed_ms(iec61851.last_error_time, 30*1000)) {
-				return;
+
+		for(uint8_t leave_state = 0; leave_state < IEC61851_STATE_NUM; leave_state++) {
+			if(!(hold_off->after_leaving & (1 << leave_state))) {
+				continue;
+			}
+
+			if(leave_state == iec61851.state) {
+				return true;
+			}
+
+			if((iec61851.leave_time[leave_state] != 0) && !system_timer_is_time_elapsed_ms(iec61851.leave_time[leave_state], hold_off->hold_time)) {
+				return true;
 			}
-			iec61851.last_error_time = 0;
 		}
+	}
 
-		// If we change from state C to something else we save the time
-		// If we then change back to state C we wait at least 5 seconds
-		// -> Don't start charging immediately after charging was stopped
-		if(iec61851.state == IEC61851_STATE_C) {
-			iec61851.last_state_c_end_time = system_timer_get_ms();
+	return false;
+}
+
+static void iec61851_hold_off_clear(const IEC61851State state) {
+	for(uint8_t i = 0; i < IEC61851_HOLD_OFFS_NUM; i++) {
+		if(iec61851_hold_offs[i].state != state) {
+			continue;
 		}
-		if((state == IEC61851_STATE_C) && (iec61851.last_state_c_end_time != 0)) {
-			if(!system_timer_is_time_elapsed_ms(iec61851.last_state_c_end_time, 5*1000)) {
-				return;
+
+		for(uint8_t leave_state = 0; leave_state < IEC61851_STATE_NUM; leave_state++) {
+			if(iec61851_hold_offs[i].after_leaving & (1 << leave_state)) {
+				iec61851.leave_time[leave_state] = 0;
 			}
-			iec61851.last_state_c_end_time = 0;
+		}
+	}
+}
+
+void iec61851_set_state(IEC61851State state) {
+	if(state != iec61851.state) {
+		if(iec61851_hold_off_active(state)) {
+			return;
+		}
+		iec61851_hold_off_clear(state);
+		iec61851.leave_time[iec61851.state] = MAX(1, system_timer_get_ms());
+
+		// Start of contactor off latency measurement (see evse_set_output)
+		if(iec61851.state == IEC61851_STATE_C) {
+			evse.contactor_off_decision_time = MAX(1, system_timer_get_ms());
 		}
 
 		// If we change to state C and the charging timer was not started, we start it
@@ -90,8 +156,12 @@ void iec61851_set_state(IEC61851State state) {
 			evse.charging_time = 0;
 		}
 
+		state_journal_add(iec61851.state, state);
+
 		iec61851.state             = state;
 		iec61851.last_state_change = system_timer_get_ms();
+
+		adc_capture_handle_state_change();
 	}
 }
 
@@ -177,68 +247,80 @@ void iec61851_state_ef(void) {
 	evse_set_output(1000, false);
 }
 
-void iec61851_tick(void) {
+static uint8_t iec61851_get_inputs(void) {
+	uint8_t inputs = 0;
+
+	if(contactor_check.error != 0) {
+		inputs |= IEC61851_INPUT_CONTACTOR_ERROR;
+	}
+
+	// We don't allow the jumper to be unconfigured
+	if((evse.config_jumper_current == EVSE_CONFIG_JUMPER_SOFTWARE) || (evse.config_jumper_current == EVSE_CONFIG_JUMPER_UNCONFIGURED)) {
+		inputs |= IEC61851_INPUT_JUMPER_INVALID;
+	}
+
+	const bool relay_off = !evse_get_contactor();
+	if(relay_off) {
+		inputs |= IEC61851_INPUT_RELAY_OFF;
+	}
+
+	if(relay_off && (evse_get_cp_duty_cycle() != 1000)) {
+		inputs |= IEC61851_INPUT_ID3_MODE;
+	} else {
+		inputs |= IEC61851_INPUT_NOT_ID3_MODE;
+	}
+
+	if(charging_slot_get_max_current() == 0) {
+		inputs |= IEC61851_INPUT_NO_CURRENT;
+	}
+
+	return inputs;
+}
+
+static void iec61851_evaluate(void) {
 	if(evse.calibration_state != 0) {
 		return;
 	}
 
-	if(contactor_check.error != 0) {
-		led_set_blinking(4);
-		iec61851_set_state(IEC61851_STATE_EF);
-	} else if((evse.config_jumper_current == EVSE_CONFIG_JUMPER_SOFTWARE) || (evse.config_jumper_current == EVSE_CONFIG_JUMPER_UNCONFIGURED)) {
-		// We don't allow the jumper to be unconfigured
-		led_set_blinking(2);
-		iec61851_set_state(IEC61851_STATE_EF);
-	} else {
-		// Wait for ADC measurements to be valid
-		if(ads1118.cp_invalid_counter > 0) {
-			return;
+	const uint8_t inputs = iec61851_get_inputs();
+
+	for(uint8_t i = 0; i < IEC61851_TRANSITIONS_NUM; i++) {
+		const IEC61851Transition *transition = &iec61851_transitions[i];
+		if((transition->inputs & inputs) != transition->inputs) {
+			continue;
+		}
+
+		if(transition->resistance_above != IEC61851_RESISTANCE_ANY) {
+			// Wait for ADC measurements to be valid
+			if(ads1118.cp_settle.invalid_counter > 0) {
+				return;
+			}
+
+			int32_t threshold = transition->resistance_above;
+			if(iec61851.state == transition->state) {
+				threshold -= transition->hysteresis;
+			}
+
+			if((int32_t)ads1118.cp_pe_resistance <= threshold) {
+				continue;
+			}
 		}
 
-		// When an ID.3 is connected to the WARP charger and the duty cycle is already
-		// below 100% (the wallbox is ready) but the contactor is not yet activated, the
-		// ID.3 somtimes generates a spike in the resistance that we measure when it
-		// engages the resistor to apply 880 ohm between CP/PE. We have not seen this in
-		// other cars, we assume this is some kind of capacitive effect. To make sure
-		// that we don't cancel the charging here, we increase the STATE A threshold for
-		// this scenario.
-		const uint16_t current_cp_duty_cycle = evse_get_cp_duty_cycle();
-		const bool id3_mode = (current_cp_duty_cycle != 1000) && !XMC_GPIO_GetInput(EVSE_RELAY_PIN);
-		if(!id3_mode) {
-			iec61851.id3_mode_time = 0;
+		if(iec61851.transition_index != i) {
+			iec61851.transition_index      = i;
+			iec61851.transition_match_time = system_timer_get_ms();
 		}
 
-		if(id3_mode && (ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_A*3)) {
-			if(iec61851.id3_mode_time == 0) {
-				iec61851.id3_mode_time = system_timer_get_ms();
-			} else {
-				// wait for at least 2500ms between B->A state change in ID.3 mode
-				if(system_timer_is_time_elapsed_ms(iec61851.id3_mode_time, 2500)) {
-					iec61851_set_state(IEC61851_STATE_A);
-				}
+		if((transition->dwell_time == 0) || system_timer_is_time_elapsed_ms(iec61851.transition_match_time, transition->dwell_time)) {
+			if(transition->led_blinking != 0) {
+				led_set_blinking(transition->led_blinking);
 			}
-		// Check for id3_mode and check if the relay is turned off already.
-		// If the relay is not turned off we force the state machine to go to state B before it can go to state A.
-		// In state B it will turn the relay off and then later go to state A,
-		// but during the change from B to A the ID.3 mode can trigger (which it wouldn't otherwise).
-		} else if(!XMC_GPIO_GetInput(EVSE_RELAY_PIN) && !id3_mode && (ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_A)) {
-			iec61851_set_state(IEC61851_STATE_A);
-		} else if(ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_B) {
-			iec61851_set_state(IEC61851_STATE_B);
-		} else if(ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_C) {
-			if(charging_slot_get_max_current() == 0) {
+			if(transition->actions & IEC61851_ACTION_STOP_CHARGING_TIMER) {
 				evse.charging_time = 0;
-				iec61851_set_state(IEC61851_STATE_B);
-			} else {
-				iec61851_set_state(IEC61851_STATE_C);
 			}
-		} else if(ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_D) {
-			led_set_blinking(5);
-			iec61851_set_state(IEC61851_STATE_D);
-		} else {
-			led_set_blinking(5);
-			iec61851_set_state(IEC61851_STATE_EF);
+			iec61851_set_state(transition->state);
 		}
+		break;
 	}
 
 	switch(iec61851.state) {
@@ -247,11 +329,35 @@ void iec61851_tick(void) {
 		case IEC61851_STATE_C:  iec61851_state_c();  break;
 		case IEC61851_STATE_D:  iec61851_state_d();  break;
 		case IEC61851_STATE_EF: iec61851_state_ef(); break;
+		default: break;
 	}
 }
 
+// Request an evaluation in the next tick, independent of new ADC results
+void iec61851_request_evaluation(void) {
+	iec61851.evaluation_requested = true;
+}
+
+void iec61851_tick(void) {
+	// The resistances only change 8-32 times per second, there is nothing new
+	// to evaluate in between (besides the timeouts, see IEC61851_EVALUATION_INTERVAL)
+	if(!iec61851.evaluation_requested &&
+	   (iec61851.last_sample_sequence == ads1118.sample_sequence) &&
+	   !system_timer_is_time_elapsed_ms(iec61851.last_evaluation_time, IEC61851_EVALUATION_INTERVAL)) {
+		return;
+	}
+
+	iec61851.evaluation_requested = false;
+	iec61851.last_sample_sequence = ads1118.sample_sequence;
+	iec61851.last_evaluation_time = system_timer_get_ms();
+	iec61851.evaluation_count++;
+
+	iec61851_evaluate();
+}
+
 void iec61851_init(void) {
 	memset(&iec61851, 0, sizeof(IEC61851));
 	iec61851.last_state_change = system_timer_get_ms();
+	iec61851.transition_index  = 0xFF;
 }
 
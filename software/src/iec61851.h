@@ -23,6 +23,7 @@
 #define IEC61851_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 // Resistance between CP/PE
 // inf  Ohm -> no car present
@@ -49,28 +50,70 @@
 #define IEC61851_PP_RESISTANCE_20A  330
 #define IEC61851_PP_RESISTANCE_32A  150
 
+// The state machine is evaluated on every new ADC result and at least with this interval
+// (for the timeouts and for inputs that don't come from the ADC, like charging slots or button)
+#define IEC61851_EVALUATION_INTERVAL 10 // ms
+
 typedef enum {
     IEC61851_STATE_A,  // Standby
     IEC61851_STATE_B,  // Vehicle Detected
     IEC61851_STATE_C,  // Ready (Charging)
     IEC61851_STATE_D,  // Ready with ventilation
     IEC61851_STATE_EF, // No Power / Error
+    IEC61851_STATE_NUM
 } IEC61851State;
 
+// Inputs of the state machine besides the CP/PE resistance,
+// used as conditions of the transitions
+#define IEC61851_INPUT_CONTACTOR_ERROR (1 << 0) // Contactor check reports an error
+#define IEC61851_INPUT_JUMPER_INVALID  (1 << 1) // Jumper is unconfigured or set to software
+#define IEC61851_INPUT_RELAY_OFF       (1 << 2) // Contactor is off
+#define IEC61851_INPUT_ID3_MODE        (1 << 3) // PWM is active but contactor is still off
+#define IEC61851_INPUT_NOT_ID3_MODE    (1 << 4)
+#define IEC61851_INPUT_NO_CURRENT      (1 << 5) // Charging slots don't allow any current
+
+#define IEC61851_RESISTANCE_ANY        -1 // Transition does not depend on CP/PE resistance
+
+// Actions that are executed if a transition is taken
+#define IEC61851_ACTION_STOP_CHARGING_TIMER (1 << 0)
+
+typedef struct {
+    int32_t  resistance_above; // Transition matches if CP/PE resistance > resistance_above...
+    uint16_t hysteresis;       // ...- hysteresis if we are already in the target state
+    uint8_t  inputs;           // All of these inputs have to be active
+    uint8_t  actions;
+    IEC61851State state;       // Target state
+    uint16_t dwell_time;       // ms the transition has to match continuously before it is taken
+    uint8_t  led_blinking;     // LED blink code, 0 = no change
+} IEC61851Transition;
+
+typedef struct {
+    IEC61851State state;   // Entering this state...
+    uint8_t after_leaving; // ...after leaving one of these states (bit mask of IEC61851State)...
+    uint16_t hold_time;    // ...is only allowed after this time in ms
+} IEC61851HoldOff;
+
 
 typedef struct {
     IEC61851State state;
     uint32_t last_state_change;
-    uint32_t last_state_c_end_time;
+    uint32_t leave_time[IEC61851_STATE_NUM]; // Last time each state was left, 0 = hold-off not active
+
+    uint8_t  transition_index;       // Transition that matched in the last evaluation
+    uint32_t transition_match_time;  // Time since which transition_index matches
 
-    uint32_t id3_mode_time;
-	uint32_t last_error_time;
+    uint32_t last_sample_sequence;
+    uint32_t last_evaluation_time;
+    bool evaluation_requested;
+    uint32_t evaluation_count;
 } IEC61851;
 
 extern IEC61851 iec61851;
 
 void iec61851_init(void);
+void iec61851_set_state(IEC61851State state);
 void iec61851_tick(void);
+void iec61851_request_evaluation(void);
 
 uint32_t iec61851_get_ma_from_pp_resistance(void);
 uint32_t iec61851_get_ma_from_jumper(void);
@@ -37,12 +37,16 @@
 #include "led.h"
 #include "button.h"
 #include "charging_slot.h"
+#include "adc_capture.h"
+#include "state_journal.h"
 
 int main(void) {
 	logging_init();
 	logd("Start EVSE Bricklet\n\r");
 
 	communication_init();
+	adc_capture_init();
+	state_journal_init();
 	evse_init();
 	charging_slot_init();
 	ads1118_init();
@@ -62,5 +66,6 @@ int main(void) {
 		led_tick();
 		button_tick();
 		charging_slot_tick();
+		state_journal_tick();
 	}
 }
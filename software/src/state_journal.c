@@ -0,0 +1,203 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * state_journal.c: Journal of IEC61851 state transitions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "state_journal.h"
+
+#include <string.h>
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/utility/util_definitions.h"
+#include "bricklib2/bootloader/bootloader.h"
+#include "bricklib2/warp/contactor_check.h"
+
+#include "evse.h"
+#include "ads1118.h"
+#include "iec61851.h"
+#include "charging_slot.h"
+
+// The journal keeps the last STATE_JOURNAL_ENTRIES_NUM IEC61851 state transitions
+// together with the measurements that led to them. If the EVSE goes into state EF
+// or the contactor check reports an error, the journal is frozen and written to
+// EEPROM (newest STATE_JOURNAL_EEPROM_ENTRIES_NUM entries), so the context of the error survives until it is read out
+// (even over a reboot). It stays frozen until it is reset through the API.
+
+StateJournal state_journal;
+
+static void state_journal_add_entry(const uint8_t from_state, const uint8_t to_state) {
+	StateJournalEntry *entry = &state_journal.entries[state_journal.index];
+	entry->time              = system_timer_get_ms();
+	entry->cp_pe_resistance  = MIN(0xFFFF, ads1118.cp_pe_resistance);
+	entry->pp_pe_resistance  = MIN(0xFFFF, ads1118.pp_pe_resistance);
+	entry->duty_cycle        = evse_get_cp_duty_cycle();
+	entry->from_state        = from_state;
+	entry->to_state          = to_state;
+	entry->relay             = evse_get_contactor();
+	entry->limiting_slot     = charging_slot_get_limiting_slot();
+	entry->contactor_state   = contactor_check.state;
+	entry->contactor_error   = contactor_check.error;
+
+	state_journal.index++;
+	if(state_journal.index >= STATE_JOURNAL_ENTRIES_NUM) {
+		state_journal.index = 0;
+	}
+	if(state_journal.count < STATE_JOURNAL_ENTRIES_NUM) {
+		state_journal.count++;
+	}
+	state_journal.total_count++;
+}
+
+static void state_journal_freeze(const StateJournalFreezeReason reason) {
+	// Snapshot of the moment of the freeze
+	state_journal_add_entry(iec61851.state, iec61851.state);
+
+	state_journal.frozen        = true;
+	state_journal.flush_pending = true;
+	state_journal.freeze_reason = reason;
+	state_journal.freeze_time   = system_timer_get_ms();
+}
+
+// Called from iec61851_set_state before the new state is applied
+void state_journal_add(const uint8_t from_state, const uint8_t to_state) {
+	if(state_journal.frozen) {
+		return;
+	}
+
+	state_journal_add_entry(from_state, to_state);
+
+	if(to_state == IEC61851_STATE_EF) {
+		state_journal_freeze(STATE_JOURNAL_FREEZE_REASON_STATE_EF);
+	}
+}
+
+void state_journal_reset(const bool clear_eeprom) {
+	state_journal.index         = 0;
+	state_journal.count         = 0;
+	state_journal.total_count   = 0;
+	state_journal.frozen        = false;
+	state_journal.flush_pending = false;
+	state_journal.freeze_reason = STATE_JOURNAL_FREEZE_REASON_NONE;
+	state_journal.freeze_time   = 0;
+
+	if(clear_eeprom) {
+		uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+		bootloader_read_eeprom_page(STATE_JOURNAL_PAGE, page);
+		memset(&page[STATE_JOURNAL_PAGE_POS], 0, sizeof(StateJournalPage));
+		evse_write_eeprom_page_if_changed(STATE_JOURNAL_PAGE, page);
+	}
+}
+
+static void state_journal_get_entry(const uint8_t i, StateJournalEntry *entry) {
+	// i = 0 is the oldest entry
+	uint8_t index = state_journal.index + STATE_JOURNAL_ENTRIES_NUM - state_journal.count + i;
+	while(index >= STATE_JOURNAL_ENTRIES_NUM) {
+		index -= STATE_JOURNAL_ENTRIES_NUM;
+	}
+
+	*entry = state_journal.entries[index];
+}
+
+static void state_journal_flush(void) {
+	// Read the page first, the config is also stored here
+	uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+	bootloader_read_eeprom_page(STATE_JOURNAL_PAGE, page);
+
+	StateJournalPage *journal_page = (StateJournalPage*)&page[STATE_JOURNAL_PAGE_POS];
+	memset(journal_page, 0, sizeof(StateJournalPage));
+
+	// Only the newest entries fit into the EEPROM
+	const uint8_t skip = (state_journal.count > STATE_JOURNAL_EEPROM_ENTRIES_NUM) ? (state_journal.count - STATE_JOURNAL_EEPROM_ENTRIES_NUM) : 0;
+
+	journal_page->magic         = STATE_JOURNAL_MAGIC;
+	journal_page->freeze_time   = state_journal.freeze_time;
+	journal_page->freeze_reason = state_journal.freeze_reason;
+	journal_page->count         = state_journal.count - skip;
+	for(uint8_t i = 0; i < journal_page->count; i++) {
+		state_journal_get_entry(skip + i, &journal_page->entries[i]);
+	}
+
+	evse_write_eeprom_page_if_changed(STATE_JOURNAL_PAGE, page);
+}
+
+uint16_t state_journal_get_length(const uint8_t source) {
+	if(source == STATE_JOURNAL_SOURCE_EEPROM) {
+		uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+		bootloader_read_eeprom_page(STATE_JOURNAL_PAGE, page);
+		const StateJournalPage *journal_page = (const StateJournalPage*)&page[STATE_JOURNAL_PAGE_POS];
+		if((journal_page->magic != STATE_JOURNAL_MAGIC) || (journal_page->count > STATE_JOURNAL_EEPROM_ENTRIES_NUM)) {
+			return 0;
+		}
+
+		return sizeof(StateJournalPage) - (STATE_JOURNAL_EEPROM_ENTRIES_NUM - journal_page->count)*sizeof(StateJournalEntry);
+	}
+
+	return state_journal.count*sizeof(StateJournalEntry);
+}
+
+// Copy STATE_JOURNAL_CHUNK_SIZE bytes starting at byte offset, bytes after the end are filled with 0.
+// The RAM journal is read as a list of entries (oldest first), the EEPROM journal as StateJournalPage.
+void state_journal_read(const uint8_t source, const uint16_t offset, uint8_t *data) {
+	memset(data, 0, STATE_JOURNAL_CHUNK_SIZE);
+
+	const uint16_t length = state_journal_get_length(source);
+	if(offset >= length) {
+		return;
+	}
+
+	const uint16_t to_copy = MIN(STATE_JOURNAL_CHUNK_SIZE, length - offset);
+	if(source == STATE_JOURNAL_SOURCE_EEPROM) {
+		uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+		bootloader_read_eeprom_page(STATE_JOURNAL_PAGE, page);
+		memcpy(data, ((const uint8_t*)&page[STATE_JOURNAL_PAGE_POS]) + offset, to_copy);
+		return;
+	}
+
+	StateJournalEntry entry;
+	uint8_t entry_index = offset / sizeof(StateJournalEntry);
+	uint8_t byte_index  = offset % sizeof(StateJournalEntry);
+	state_journal_get_entry(entry_index, &entry);
+
+	for(uint16_t i = 0; i < to_copy; i++) {
+		data[i] = ((const uint8_t*)&entry)[byte_index];
+		byte_index++;
+		if((byte_index == sizeof(StateJournalEntry)) && (i+1 < to_copy)) {
+			byte_index = 0;
+			entry_index++;
+			state_journal_get_entry(entry_index, &entry);
+		}
+	}
+}
+
+void state_journal_init(void) {
+	memset(&state_journal, 0, sizeof(StateJournal));
+}
+
+void state_journal_tick(void) {
+	if(!state_journal.frozen && (contactor_check.error != 0)) {
+		state_journal_freeze(STATE_JOURNAL_FREEZE_REASON_CONTACTOR_ERROR);
+	}
+
+	// The EEPROM write takes a few ms, we do it here and not in iec61851_set_state
+	if(state_journal.flush_pending) {
+		state_journal.flush_pending = false;
+		state_journal_flush();
+	}
+}
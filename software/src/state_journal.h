@@ -0,0 +1,95 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * state_journal.h: Journal of IEC61851 state transitions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STATE_JOURNAL_ENTRIES_NUM        15
+#define STATE_JOURNAL_EEPROM_ENTRIES_NUM 10 // 12 byte header + 10*16 byte entries fit in front of the charging slot defaults
+#define STATE_JOURNAL_CHUNK_SIZE         60
+
+// There are only four EEPROM pages and all of them are in use,
+// the journal is stored in the unused part of the config page (words 4-46).
+// The calibration pages are never written by the journal: a power loss during
+// the write erases the page, for the config page this falls back to the
+// defaults (like a power loss during a config save), for a calibration page
+// it would lose the calibration.
+#define STATE_JOURNAL_PAGE               EVSE_CONFIG_PAGE
+#define STATE_JOURNAL_PAGE_POS           EVSE_CONFIG_JOURNAL_POS
+#define STATE_JOURNAL_MAGIC              0x56789ABC
+
+#define STATE_JOURNAL_SOURCE_RAM     0
+#define STATE_JOURNAL_SOURCE_EEPROM  1
+
+typedef enum {
+    STATE_JOURNAL_FREEZE_REASON_NONE = 0,
+    STATE_JOURNAL_FREEZE_REASON_STATE_EF = 1,
+    STATE_JOURNAL_FREEZE_REASON_CONTACTOR_ERROR = 2,
+} StateJournalFreezeReason;
+
+typedef struct {
+    uint32_t time;            // system timer in ms
+    uint16_t cp_pe_resistance; // saturated to 0xFFFF
+    uint16_t pp_pe_resistance; // saturated to 0xFFFF
+    uint16_t duty_cycle;      // CP PWM duty cycle in 1/10 %
+    uint8_t  from_state;
+    uint8_t  to_state;        // from_state == to_state for the snapshot that is added on freeze
+    uint8_t  relay;
+    uint8_t  limiting_slot;   // 0xFF if no slot is active
+    uint8_t  contactor_state;
+    uint8_t  contactor_error;
+} __attribute__((__packed__)) StateJournalEntry;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t freeze_time;
+    uint8_t  freeze_reason;
+    uint8_t  count;
+    uint16_t reserved;
+    StateJournalEntry entries[STATE_JOURNAL_EEPROM_ENTRIES_NUM]; // oldest entry first
+} __attribute__((__packed__)) StateJournalPage;
+
+typedef struct {
+    StateJournalEntry entries[STATE_JOURNAL_ENTRIES_NUM];
+    uint8_t index; // Next entry is written here
+    uint8_t count; // Number of valid entries
+    uint32_t total_count; // Number of entries written since startup/reset, can be used to detect changes between chunk reads
+
+    bool frozen;
+    bool flush_pending;
+    StateJournalFreezeReason freeze_reason;
+    uint32_t freeze_time;
+} StateJournal;
+
+extern StateJournal state_journal;
+
+void state_journal_init(void);
+void state_journal_tick(void);
+void state_journal_add(const uint8_t from_state, const uint8_t to_state);
+void state_journal_reset(const bool clear_eeprom);
+uint16_t state_journal_get_length(const uint8_t source);
+void state_journal_read(const uint8_t source, const uint16_t offset, uint8_t *data);
+
+#endif
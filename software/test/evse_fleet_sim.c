@@ -0,0 +1,251 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * evse_fleet_sim.c: Simulation of a site with many EVSEs for backend sizing
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// Runs many independent EVSEs, each with a scripted vehicle, on the host build
+// and reports the state change rates the backend has to handle and the host CPU
+// time per main loop iteration.
+//
+//   evse_fleet_sim [instances] [virtual seconds] [workers] [loop time in us]
+//
+// A longer main loop time (default 50us) makes long runs of big sites faster.
+//
+// The firmware modules are singletons (evse, ads1118, iec61851, ...), like everywhere
+// in bricklib2. Instead of passing a context pointer through the firmware, every
+// instance runs in its own forked process with its own copy of the firmware state and
+// its own virtual clock. The instances don't interact, up to [workers] of them run in
+// parallel (default: one per core). The results are collected in shared memory.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "evse_sim.h"
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/utility/util_definitions.h"
+
+#include "evse.h"
+#include "iec61851.h"
+
+#define FLEET_SIM_DEFAULT_INSTANCES 16
+#define FLEET_SIM_DEFAULT_SECONDS   120
+#define FLEET_SIM_DEFAULT_LOOP_US   50
+
+typedef enum {
+	FLEET_CAR_UNPLUGGED,
+	FLEET_CAR_PLUGGED,
+	FLEET_CAR_CHARGING,
+	FLEET_CAR_PAUSED,
+	FLEET_CAR_DONE,
+} FleetCarPhase;
+
+typedef struct {
+	uint32_t state_changes;     // IEC61851 state changes (each one is a state callback for the backend)
+	uint32_t contactor_changes;
+	uint32_t error_states;      // Entries into state D or EF, the scripted vehicles never cause one
+	uint32_t loops;
+	uint64_t cpu_ns;            // Host CPU time of all main loop iterations
+	bool     done;
+} FleetInstanceResult;
+
+static uint32_t xorshift32(uint32_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static uint32_t random_ms(uint32_t *state, const uint32_t min_s, const uint32_t max_s) {
+	return min_s*1000 + xorshift32(state) % ((max_s - min_s)*1000);
+}
+
+static uint64_t cpu_time_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t wall_time_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+// Vehicle script: arrive, wait, charge (sometimes with a pause), stop, leave.
+// Returns the time of the next step.
+static uint32_t fleet_car_step(FleetCarPhase *phase, uint32_t *random) {
+	switch(*phase) {
+		case FLEET_CAR_UNPLUGGED:
+			evse_sim.cp_resistance = 2700;
+			evse_sim.pp_resistance = 220;
+			*phase = FLEET_CAR_PLUGGED;
+			return random_ms(random, 2, 10);
+
+		case FLEET_CAR_PLUGGED:
+		case FLEET_CAR_PAUSED:
+			evse_sim.cp_resistance = 880;
+			*phase = FLEET_CAR_CHARGING;
+			return random_ms(random, 10, 120);
+
+		case FLEET_CAR_CHARGING:
+			evse_sim.cp_resistance = 2700;
+			*phase = (xorshift32(random) % 4 == 0) ? FLEET_CAR_PAUSED : FLEET_CAR_DONE;
+			return random_ms(random, 2, 20);
+
+		case FLEET_CAR_DONE:
+		default:
+			evse_sim.cp_resistance = EVSE_SIM_OPEN;
+			evse_sim.pp_resistance = EVSE_SIM_OPEN;
+			*phase = FLEET_CAR_UNPLUGGED;
+			return random_ms(random, 5, 60);
+	}
+}
+
+static void fleet_instance_run(const uint32_t instance, const uint32_t seconds, const uint32_t loop_time_us, FleetInstanceResult *result) {
+	uint32_t random = 0x9E3779B9u*(instance + 1);
+
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = EVSE_SIM_OPEN;
+	evse_sim.loop_time_ns  = loop_time_us*1000;
+	evse_sim_boot_and_settle();
+
+	// Spread the arrivals, otherwise all vehicles of the site would plug in at the same time
+	FleetCarPhase phase = FLEET_CAR_DONE;
+	uint32_t next_step  = system_timer_get_ms() + random_ms(&random, 0, 60);
+	const uint32_t end  = system_timer_get_ms() + seconds*1000;
+
+	IEC61851State last_state = iec61851.state;
+	bool last_contactor      = evse_get_contactor();
+	const uint64_t cpu_start = cpu_time_ns();
+	while((int32_t)(end - system_timer_get_ms()) > 0) {
+		if((int32_t)(next_step - system_timer_get_ms()) <= 0) {
+			next_step = system_timer_get_ms() + fleet_car_step(&phase, &random);
+		}
+
+		evse_sim_loop();
+		result->loops++;
+
+		if(iec61851.state != last_state) {
+			last_state = iec61851.state;
+			result->state_changes++;
+			if((last_state == IEC61851_STATE_D) || (last_state == IEC61851_STATE_EF)) {
+				result->error_states++;
+			}
+		}
+
+		if(evse_get_contactor() != last_contactor) {
+			last_contactor = !last_contactor;
+			result->contactor_changes++;
+		}
+	}
+	result->cpu_ns = cpu_time_ns() - cpu_start;
+	result->done   = true;
+}
+
+int main(int argc, char **argv) {
+	const uint32_t instances = (argc > 1) ? strtoul(argv[1], NULL, 0) : FLEET_SIM_DEFAULT_INSTANCES;
+	const uint32_t seconds   = (argc > 2) ? strtoul(argv[2], NULL, 0) : FLEET_SIM_DEFAULT_SECONDS;
+	const uint32_t workers   = (argc > 3) ? strtoul(argv[3], NULL, 0) : (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+	const uint32_t loop_us   = (argc > 4) ? strtoul(argv[4], NULL, 0) : FLEET_SIM_DEFAULT_LOOP_US;
+	if((instances == 0) || (seconds == 0) || (workers == 0) || (loop_us == 0)) {
+		fprintf(stderr, "usage: %s [instances] [virtual seconds] [workers] [loop time in us]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FleetInstanceResult *results = mmap(NULL, instances*sizeof(FleetInstanceResult), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(results == MAP_FAILED) {
+		perror("mmap");
+		return EXIT_FAILURE;
+	}
+	memset(results, 0, instances*sizeof(FleetInstanceResult));
+
+	const uint64_t wall_start = wall_time_ns();
+	uint32_t running = 0;
+	for(uint32_t i = 0; i < instances; i++) {
+		// A crashed instance is detected by the missing result
+		if(running == workers) {
+			wait(NULL);
+			running--;
+		}
+
+		const pid_t pid = fork();
+		if(pid < 0) {
+			perror("fork");
+			return EXIT_FAILURE;
+		}
+		if(pid == 0) {
+			fleet_instance_run(i, seconds, loop_us, &results[i]);
+			_exit(EXIT_SUCCESS);
+		}
+		running++;
+	}
+	while(running > 0) {
+		wait(NULL);
+		running--;
+	}
+	const uint64_t wall_ns = wall_time_ns() - wall_start;
+
+	uint64_t state_changes     = 0;
+	uint64_t contactor_changes = 0;
+	uint64_t error_states      = 0;
+	uint64_t loops             = 0;
+	uint64_t cpu_ns            = 0;
+	uint32_t failed            = 0;
+	uint32_t loop_ns_min       = UINT32_MAX;
+	uint32_t loop_ns_max       = 0;
+	for(uint32_t i = 0; i < instances; i++) {
+		if(!results[i].done || (results[i].loops == 0)) {
+			failed++;
+			continue;
+		}
+
+		state_changes     += results[i].state_changes;
+		contactor_changes += results[i].contactor_changes;
+		error_states      += results[i].error_states;
+		loops             += results[i].loops;
+		cpu_ns            += results[i].cpu_ns;
+
+		const uint32_t loop_ns = results[i].cpu_ns/results[i].loops;
+		loop_ns_min = MIN(loop_ns_min, loop_ns);
+		loop_ns_max = MAX(loop_ns_max, loop_ns);
+	}
+
+	const double site_seconds = seconds;
+	printf("%u EVSEs, %u virtual seconds each, %u us main loop, %u workers, %.2f s wall time\n", instances, seconds, loop_us, workers, wall_ns/1e9);
+	printf("state changes:     %llu (%.3f per second for the site, %.1f per EVSE and hour)\n",
+	       (unsigned long long)state_changes, state_changes/site_seconds, state_changes*3600.0/(site_seconds*instances));
+	printf("contactor changes: %llu (%.3f per second for the site)\n", (unsigned long long)contactor_changes, contactor_changes/site_seconds);
+	printf("error states:      %llu\n", (unsigned long long)error_states);
+	if(loops > 0) {
+		printf("main loop:         %llu iterations, %llu ns host CPU per iteration (min %u, max %u over the EVSEs)\n",
+		       (unsigned long long)loops, (unsigned long long)(cpu_ns/loops), loop_ns_min, loop_ns_max);
+	}
+	printf("failed instances:  %u\n", failed);
+
+	munmap(results, instances*sizeof(FleetInstanceResult));
+
+	return ((failed == 0) && (error_states == 0) && (state_changes > 0)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
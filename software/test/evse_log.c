@@ -0,0 +1,76 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * evse_log.c: Reader for the logs recorded with tests/log.py
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "evse_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Columns: Time,IEC61851 State,LED State,Resistance CP/PE,Resistance PP/PE,CP PWM Duty Cycle,Contactor State,...
+bool evse_log_read(const char *path, EVSELog *log) {
+	FILE *f = fopen(path, "r");
+	if(f == NULL) {
+		fprintf(stderr, "evse_log: can't open %s\n", path);
+		return false;
+	}
+
+	uint32_t capacity = 1024;
+	log->rows = malloc(capacity*sizeof(EVSELogRow));
+	log->num  = 0;
+
+	char line[256];
+	bool header = true;
+	while(fgets(line, sizeof(line), f) != NULL) {
+		if(header) {
+			header = false;
+			continue;
+		}
+
+		unsigned long long time;
+		unsigned state, led, cp, pp, duty, contactor;
+		if(sscanf(line, "%llu,%u,%u,%u,%u,%u,%u", &time, &state, &led, &cp, &pp, &duty, &contactor) != 7) {
+			continue;
+		}
+
+		if(log->num == capacity) {
+			capacity *= 2;
+			log->rows = realloc(log->rows, capacity*sizeof(EVSELogRow));
+		}
+
+		EVSELogRow *row       = &log->rows[log->num++];
+		row->time             = time;
+		row->iec61851_state   = state;
+		row->cp_pe_resistance = cp;
+		row->pp_pe_resistance = pp;
+		row->cp_duty_cycle    = duty;
+		row->contactor_state  = contactor;
+	}
+
+	fclose(f);
+	return log->num > 0;
+}
+
+void evse_log_free(EVSELog *log) {
+	free(log->rows);
+	log->rows = NULL;
+	log->num  = 0;
+}
@@ -0,0 +1,49 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * evse_log.h: Reader for the logs recorded with tests/log.py
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef EVSE_LOG_H
+#define EVSE_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EVSE_LOG_ERIK TESTS_DATA_DIR "/log_erik.csv"
+#define EVSE_LOG_OLAF TESTS_DATA_DIR "/log_olaf.csv"
+
+typedef struct {
+	uint64_t time;             // 1/10 s
+	uint8_t  iec61851_state;
+	uint32_t cp_pe_resistance;
+	uint32_t pp_pe_resistance;
+	uint16_t cp_duty_cycle;
+	uint8_t  contactor_state;
+} EVSELogRow;
+
+typedef struct {
+	EVSELogRow *rows;
+	uint32_t num;
+} EVSELog;
+
+// Returns false if the file can't be read, the rows have to be freed with evse_log_free
+bool evse_log_read(const char *path, EVSELog *log);
+void evse_log_free(EVSELog *log);
+
+#endif
@@ -0,0 +1,188 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * evse_sim.c: Simulated EVSE (firmware on the fake HAL) and vehicle for host tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "evse_sim.h"
+
+#include <string.h>
+
+#include "configs/config_evse.h"
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/warp/contactor_check.h"
+#include "bricklib2/utility/util_definitions.h"
+
+#include "communication.h"
+#include "evse.h"
+#include "ads1118.h"
+#include "iec61851.h"
+#include "lock.h"
+#include "led.h"
+#include "button.h"
+#include "charging_slot.h"
+#include "adc_capture.h"
+#include "state_journal.h"
+
+#define EVSE_SIM_ADS1118_MUX_IN0_IN3 0b001
+#define EVSE_SIM_ADS1118_MUX_IN2_IN3 0b011
+#define EVSE_SIM_ADS1118_MUX_IN1_GND 0b101
+#define EVSE_SIM_ADS1118_TS_MODE     (1 << 4)
+#define EVSE_SIM_DIODE_DROP_MV       650
+#define EVSE_SIM_CP_RESISTOR         910
+
+// No vehicle connected until a test says otherwise
+EVSESim evse_sim = {
+	.cp_resistance = EVSE_SIM_OPEN,
+	.pp_resistance = EVSE_SIM_OPEN,
+	.is_v15        = true,
+	.temperature   = 2500,
+};
+
+int32_t evse_sim_cp_high_mv(void) {
+	if(evse_sim.cp_high_mv != 0) {
+		return evse_sim.cp_high_mv;
+	}
+
+	if(evse_sim.cp_resistance == EVSE_SIM_OPEN) {
+		return EVSE_SIM_CP_HIGH_OPEN_MV;
+	}
+
+	// Voltage divider of the 910 ohm EVSE resistor and vehicle resistance + diode
+	const int64_t r = evse_sim.cp_resistance;
+	return (r*EVSE_SIM_CP_HIGH_OPEN_MV + EVSE_SIM_CP_RESISTOR*EVSE_SIM_DIODE_DROP_MV)/(r + EVSE_SIM_CP_RESISTOR);
+}
+
+// 6574 LSB => -12V, 31643 LSB => 12V
+uint16_t evse_sim_cp_mv_to_adc(const int32_t mv) {
+	const int64_t adc = 6574 + ((int64_t)(mv + 12000)*25069 + 12000)/24000;
+	return BETWEEN(0, adc, 32767);
+}
+
+static uint16_t evse_sim_cp_adc(const uint64_t start_ns, const uint64_t end_ns) {
+	// Average of the PWM signal over the integration time
+	const uint64_t high_ns = fake_ccu4_active_time_ns(EVSE_CP_PWM_SLICE, start_ns, end_ns);
+	const int64_t high_mv  = evse_sim_cp_high_mv();
+	const int64_t mv       = EVSE_SIM_CP_LOW_MV + (high_mv - EVSE_SIM_CP_LOW_MV)*(int64_t)high_ns/(int64_t)(end_ns - start_ns);
+	return evse_sim_cp_mv_to_adc(mv);
+}
+
+static uint16_t evse_sim_pp_adc(void) {
+	if(evse_sim.pp_resistance == EVSE_SIM_OPEN) {
+		return 4095*8;
+	}
+
+	// 1k pull-up to 5V, 1 LSB = 125uV
+	const uint64_t r = evse_sim.pp_resistance;
+	return 5000*r/(r + 1000)*8;
+}
+
+static uint16_t evse_sim_ads1118_input(const uint16_t config, const uint64_t start_ns, const uint64_t end_ns) {
+	if(config & EVSE_SIM_ADS1118_TS_MODE) {
+		// 14 bit left-justified, 1 LSB = 0.03125°C
+		return (uint16_t)(((int32_t)evse_sim.temperature*32/100) << 2);
+	}
+
+	switch((config >> 12) & 0b111) {
+		case EVSE_SIM_ADS1118_MUX_IN0_IN3: return evse_sim.is_v15 ? 0 : evse_sim_cp_adc(start_ns, end_ns);
+		case EVSE_SIM_ADS1118_MUX_IN1_GND: return evse_sim.is_v15 ? evse_sim_cp_adc(start_ns, end_ns) : 0;
+		case EVSE_SIM_ADS1118_MUX_IN2_IN3: return evse_sim_pp_adc();
+		default:                           return 0;
+	}
+}
+
+void evse_sim_boot(void) {
+	const EVSESim vehicle = evse_sim;
+
+	fake_hal_reset();
+	fake_ads1118.input = evse_sim_ads1118_input;
+
+	memset(&evse_sim, 0, sizeof(EVSESim));
+	evse_sim.cp_resistance = vehicle.cp_resistance;
+	evse_sim.pp_resistance = vehicle.pp_resistance;
+	evse_sim.is_v15        = vehicle.is_v15;
+	evse_sim.temperature   = vehicle.temperature;
+	evse_sim.cp_high_mv    = vehicle.cp_high_mv;
+	evse_sim.loop_time_ns  = (vehicle.loop_time_ns != 0) ? vehicle.loop_time_ns : 50000;
+
+	// Config jumper open/open (16A)
+	fake_gpio_set_input(EVSE_CONFIG_JUMPER_PIN0, FAKE_GPIO_FLOATING);
+	fake_gpio_set_input(EVSE_CONFIG_JUMPER_PIN1, FAKE_GPIO_FLOATING);
+
+	// Same initialization as main()
+	communication_init();
+	adc_capture_init();
+	state_journal_init();
+	evse_init();
+	charging_slot_init();
+	ads1118_init();
+	iec61851_init();
+	lock_init();
+	contactor_check_init();
+	led_init();
+	button_init();
+}
+
+void evse_sim_loop(void) {
+	// Same order as main()
+	bootloader_tick();
+	communication_tick();
+	evse_tick();
+	ads1118_tick();
+	contactor_check_tick();
+	led_tick();
+	button_tick();
+	charging_slot_tick();
+	state_journal_tick();
+
+	evse_sim.loop_count++;
+	fake_hal_advance_ns(evse_sim.loop_time_ns);
+}
+
+void evse_sim_run_ms(const uint32_t ms) {
+	const uint64_t end = fake_hal_get_time_ns() + ms*FAKE_HAL_NS_PER_MS;
+	while(fake_hal_get_time_ns() < end) {
+		evse_sim_loop();
+	}
+}
+
+bool evse_sim_run_until(bool (*condition)(void), const uint32_t timeout_ms) {
+	const uint64_t end = fake_hal_get_time_ns() + timeout_ms*FAKE_HAL_NS_PER_MS;
+	while(fake_hal_get_time_ns() < end) {
+		if(condition()) {
+			return true;
+		}
+		evse_sim_loop();
+	}
+
+	return condition();
+}
+
+void evse_sim_boot_and_settle(void) {
+	evse_sim_boot();
+
+	// 12s startup delay of evse_tick, afterwards the continuous calibration
+	// needs a few seconds of state A to fill its queue
+	evse_sim_run_ms(16000);
+}
+
+int evse_sim_message(void *message, const uint8_t length, const uint8_t fid, void *response) {
+	TFPMessageHeader *header = message;
+	tfp_make_default_header(header, fake_hal.uid, length, fid);
+	return handle_message(message, response);
+}
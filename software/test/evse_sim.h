@@ -0,0 +1,74 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * evse_sim.h: Simulated EVSE (firmware on the fake HAL) and vehicle for host tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef EVSE_SIM_H
+#define EVSE_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hal/fake_hal.h"
+#include "hal/fake_ads1118.h"
+
+#define EVSE_SIM_OPEN 0xFFFFFFFF // No resistance between CP/PE or PP/PE
+
+// Levels of the CP signal as seen by the ADS1118, they match the
+// default calibration (see evse_load_calibration) and the scaling
+// in ads1118_cp_voltage_from_miso.
+#define EVSE_SIM_CP_HIGH_OPEN_MV 12000
+#define EVSE_SIM_CP_LOW_MV       -12090
+
+typedef struct {
+	uint32_t cp_resistance;    // CP/PE resistance of the vehicle in ohm
+	uint32_t pp_resistance;    // PP/PE resistance of the cable in ohm
+	bool     is_v15;           // Hardware version 1.5 (CP on IN1)
+	int16_t  temperature;      // 1/100 °C
+	uint32_t loop_time_ns;     // Duration of one main loop iteration
+	uint32_t loop_count;
+
+	// Optional override of the CP high level in mV (0 = derived from cp_resistance)
+	int32_t  cp_high_mv;
+} EVSESim;
+
+extern EVSESim evse_sim;
+
+// Reset the fake HAL and run the firmware initialization like main() does.
+// The EEPROM content is kept (reboot), use fake_hal_eeprom_erase for a fresh device.
+void evse_sim_boot(void);
+
+// One iteration of the main loop (same order as main.c)
+void evse_sim_loop(void);
+void evse_sim_run_ms(const uint32_t ms);
+
+// Run until condition is true, returns false on timeout
+bool evse_sim_run_until(bool (*condition)(void), const uint32_t timeout_ms);
+
+// Boot and wait for the startup delay, the ADC version detection
+// and the continuous calibration in state A
+void evse_sim_boot_and_settle(void);
+
+int32_t evse_sim_cp_high_mv(void);
+uint16_t evse_sim_cp_mv_to_adc(const int32_t mv);
+
+// Send a TFP message to handle_message, returns the handler result
+int evse_sim_message(void *message, const uint8_t length, const uint8_t fid, void *response);
+
+#endif
@@ -0,0 +1,84 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * spi_fifo.h: Host version of bricklib2 SPI FIFO (see fake_ads1118.c)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef SPI_FIFO_H
+#define SPI_FIFO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "configs/config.h"
+#include "xmc_spi.h"
+
+#define SPI_FIFO_DATA_MAX 16
+
+typedef enum {
+	SPI_FIFO_STATE_IDLE               = 0,
+	SPI_FIFO_STATE_TRANSCEIVE         = 1,
+	SPI_FIFO_STATE_TRANSCEIVE_READY   = 2,
+	SPI_FIFO_STATE_ERROR              = 128,
+	SPI_FIFO_STATE_TRANSCEIVE_ERROR   = SPI_FIFO_STATE_ERROR | 1,
+} SPIFifoState;
+
+typedef struct {
+	XMC_USIC_CH_t *channel;
+	uint32_t baudrate;
+
+	XMC_USIC_CH_FIFO_SIZE_t rx_fifo_size;
+	uint8_t rx_fifo_pointer;
+	XMC_USIC_CH_FIFO_SIZE_t tx_fifo_size;
+	uint8_t tx_fifo_pointer;
+
+	XMC_SPI_CH_SLAVE_SELECT_t slave;
+	XMC_SPI_CH_BRG_SHIFT_CLOCK_OUTPUT_t clock_output;
+	XMC_SPI_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_t clock_passive_level;
+
+	uint8_t sclk_pin;
+	XMC_GPIO_PORT_t *sclk_port;
+	uint32_t sclk_pin_mode;
+
+	uint8_t select_pin;
+	XMC_GPIO_PORT_t *select_port;
+	uint32_t select_pin_mode;
+
+	uint8_t mosi_pin;
+	XMC_GPIO_PORT_t *mosi_port;
+	uint32_t mosi_pin_mode;
+
+	uint8_t miso_pin;
+	XMC_GPIO_PORT_t *miso_port;
+	XMC_USIC_CH_INPUT_t miso_input;
+	uint8_t miso_source;
+
+	// Host only: State of the transfer that is simulated by the fake ADS1118
+	SPIFifoState state;
+	uint8_t  length;
+	uint8_t  miso[SPI_FIFO_DATA_MAX];
+	uint64_t done_time_ns;
+} SPIFifo;
+
+void spi_fifo_init(SPIFifo *spi_fifo);
+void spi_fifo_transceive(SPIFifo *spi_fifo, const uint32_t length, const uint8_t *data);
+SPIFifoState spi_fifo_next_state(SPIFifo *spi_fifo);
+uint32_t spi_fifo_read_fifo(SPIFifo *spi_fifo, uint8_t *data, const uint32_t max_length);
+bool spi_fifo_coop_transceive(SPIFifo *spi_fifo, const uint32_t length, const uint8_t *data_mosi, uint8_t *data_miso);
+
+#endif
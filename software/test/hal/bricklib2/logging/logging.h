@@ -0,0 +1,43 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * logging.h: Host version of bricklib2 logging
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#define LOGGING_NONE  0
+#define LOGGING_ERROR 1
+#define LOGGING_WARN  2
+#define LOGGING_INFO  3
+#define LOGGING_DEBUG 4
+
+#include "configs/config_logging.h"
+#include "bricklib2/hal/system_timer/system_timer.h" // Pulled in through uartbb.h in the firmware build
+
+// The host build never prints from the firmware
+#define logd(...) do {} while(0)
+#define logi(...) do {} while(0)
+#define logw(...) do {} while(0)
+#define loge(...) do {} while(0)
+#define uartbb_printf(...) do {} while(0)
+
+static inline void logging_init(void) {}
+
+#endif
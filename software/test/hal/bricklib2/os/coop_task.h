@@ -0,0 +1,45 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * coop_task.h: Host version of bricklib2 cooperative tasks (ucontext)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef COOP_TASK_H
+#define COOP_TASK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ucontext.h>
+
+#define COOP_TASK_STACK_SIZE (256*1024)
+
+typedef void (*CoopTaskFunction)(void);
+
+typedef struct {
+	ucontext_t context;
+	ucontext_t caller;
+	CoopTaskFunction function;
+	uint8_t *stack;
+} CoopTask;
+
+void coop_task_init(CoopTask *task, CoopTaskFunction function);
+void coop_task_tick(CoopTask *task);
+void coop_task_yield(void);
+void coop_task_sleep_ms(const uint32_t sleep);
+
+#endif
@@ -0,0 +1,46 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * tfp.h: Host version of bricklib2 TFP protocol definitions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef TFP_H
+#define TFP_H
+
+#include <stdint.h>
+#include <string.h> // Pulled in through the bricklib2 headers in the firmware build
+
+#define TFP_MESSAGE_MAX_LENGTH 80
+
+typedef struct {
+	uint32_t uid;
+	uint8_t length;
+	uint8_t fid;
+	uint8_t sequence_num_and_options;
+	uint8_t error_code_and_future_use;
+} __attribute__((__packed__)) TFPMessageHeader;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t data[TFP_MESSAGE_MAX_LENGTH - sizeof(TFPMessageHeader)];
+} __attribute__((__packed__)) TFPMessageFull;
+
+void tfp_make_default_header(TFPMessageHeader *header, const uint32_t uid, const uint8_t length, const uint8_t fid);
+uint8_t tfp_get_fid_from_message(const void *message);
+
+#endif
@@ -0,0 +1,44 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * moving_average.h: Host version of bricklib2 moving average
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef MOVING_AVERAGE_H
+#define MOVING_AVERAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MOVING_AVERAGE_TYPE_INT32  int32_t
+#define MOVING_AVERAGE_TYPE_UINT32 uint32_t
+
+#include "configs/config.h"
+
+typedef struct {
+	MOVING_AVERAGE_TYPE values[MOVING_AVERAGE_MAX_LENGTH];
+	MOVING_AVERAGE_SUM_TYPE sum;
+	uint16_t length;
+	uint16_t index;
+} MovingAverage;
+
+void moving_average_init(MovingAverage *ma, const MOVING_AVERAGE_TYPE initial_value, const uint16_t length);
+bool moving_average_handle_value(MovingAverage *ma, const MOVING_AVERAGE_TYPE value);
+MOVING_AVERAGE_TYPE moving_average_get(MovingAverage *ma);
+
+#endif
@@ -0,0 +1,72 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * coop_task.c: Host version of bricklib2 cooperative tasks (ucontext)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "bricklib2/os/coop_task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+
+static CoopTask *coop_task_current = NULL;
+
+static void coop_task_entry(void) {
+	coop_task_current->function();
+
+	// Tasks of the firmware never return
+	abort();
+}
+
+void coop_task_init(CoopTask *task, CoopTaskFunction function) {
+	if(task->stack == NULL) {
+		task->stack = malloc(COOP_TASK_STACK_SIZE);
+	}
+
+	task->function = function;
+	getcontext(&task->context);
+	task->context.uc_stack.ss_sp   = task->stack;
+	task->context.uc_stack.ss_size = COOP_TASK_STACK_SIZE;
+	task->context.uc_link          = NULL;
+	makecontext(&task->context, coop_task_entry, 0);
+}
+
+// Run the task until it yields
+void coop_task_tick(CoopTask *task) {
+	coop_task_current = task;
+	swapcontext(&task->caller, &task->context);
+	coop_task_current = NULL;
+}
+
+void coop_task_yield(void) {
+	if(coop_task_current == NULL) {
+		abort();
+	}
+
+	CoopTask *task = coop_task_current;
+	swapcontext(&task->context, &task->caller);
+}
+
+void coop_task_sleep_ms(const uint32_t sleep) {
+	const uint32_t start = system_timer_get_ms();
+	while(!system_timer_is_time_elapsed_ms(start, sleep)) {
+		coop_task_yield();
+	}
+}
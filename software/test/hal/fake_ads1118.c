@@ -0,0 +1,196 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * fake_ads1118.c: Simulated ADS1118 behind the SPI FIFO of the host build
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "fake_ads1118.h"
+
+#include <string.h>
+
+#include "fake_hal.h"
+#include "xmc_eru.h"
+#include "bricklib2/hal/spi_fifo/spi_fifo.h"
+#include "bricklib2/os/coop_task.h"
+#include "bricklib2/utility/util_definitions.h"
+
+// Only the behaviour that the firmware relies on is simulated:
+// * Every transfer shifts out the last conversion result followed by the config
+//   register, a config word with NOP = 01 is written to the config register.
+// * Single-shot mode: Writing the single-shot bit starts one conversion.
+//   Continuous mode: Every config write restarts the conversion.
+// * At the end of a conversion DOUT/DRDY goes low (if chip select is low),
+//   the falling edge is routed to ERU0 ETL channel 2 (P0.6 -> ERU0.2B1).
+
+#define FAKE_ADS1118_CONFIG_SINGLE_SHOT (1 << 15)
+#define FAKE_ADS1118_CONFIG_MODE        (1 << 8)
+#define FAKE_ADS1118_CONFIG_NOP_MASK    (0b11 << 1)
+#define FAKE_ADS1118_CONFIG_NOP_VALID   (0b01 << 1)
+#define FAKE_ADS1118_DRDY_ETL_CHANNEL   2
+
+FakeADS1118 fake_ads1118;
+
+static const uint16_t fake_ads1118_sps[8] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+uint64_t fake_ads1118_conversion_time_ns(const uint16_t config) {
+	const uint64_t nominal = 1000000000ULL/fake_ads1118_sps[(config >> 5) & 0b111];
+	return nominal + (int64_t)nominal*fake_ads1118.clock_error_ppm/1000000;
+}
+
+static bool fake_ads1118_select_low(void) {
+	// Chip select (P0.9) is low if it is a GPIO output with low level
+	return (XMC_GPIO_PORT0->mode[9] == XMC_GPIO_MODE_OUTPUT_PUSH_PULL) && (XMC_GPIO_PORT0->output[9] == 0);
+}
+
+uint32_t fake_ads1118_get_dout(void) {
+	return !(fake_ads1118.data_ready && fake_ads1118_select_low());
+}
+
+static void fake_ads1118_start_conversion(const uint64_t start_ns) {
+	fake_ads1118.converting          = true;
+	fake_ads1118.conversion_config   = fake_ads1118.config;
+	fake_ads1118.conversion_start_ns = start_ns;
+	fake_ads1118.conversion_end_ns   = start_ns + fake_ads1118_conversion_time_ns(fake_ads1118.config);
+}
+
+static uint64_t fake_ads1118_next_event_ns(void) {
+	return fake_ads1118.converting ? fake_ads1118.conversion_end_ns : FAKE_HAL_NS_NONE;
+}
+
+static void fake_ads1118_handle_event(const uint64_t time_ns) {
+	const FakeADS1118Input input = fake_ads1118.input;
+
+	fake_ads1118.data          = (input != NULL) ? input(fake_ads1118.conversion_config, fake_ads1118.conversion_start_ns, time_ns) : 0;
+	fake_ads1118.data_ready    = true;
+	fake_ads1118.data_ready_ns = time_ns;
+	fake_ads1118.conversion_count++;
+
+	if(fake_ads1118.conversion_config & FAKE_ADS1118_CONFIG_MODE) {
+		fake_ads1118.converting = false;
+	} else {
+		fake_ads1118_start_conversion(time_ns);
+	}
+
+	if(fake_ads1118_select_low()) {
+		fake_eru_edge(XMC_ERU0, FAKE_ADS1118_DRDY_ETL_CHANNEL);
+	}
+}
+
+void fake_ads1118_reset(void) {
+	memset(&fake_ads1118, 0, sizeof(FakeADS1118));
+
+	// Power-on default of the config register
+	fake_ads1118.config = 0x058B;
+
+	const FakeHalEventSource source = {
+		.next_event_ns = fake_ads1118_next_event_ns,
+		.handle_event  = fake_ads1118_handle_event,
+	};
+	fake_hal_add_event_source(&source);
+}
+
+// ---- SPI FIFO ----
+
+void spi_fifo_init(SPIFifo *spi_fifo) {
+	spi_fifo->state  = SPI_FIFO_STATE_IDLE;
+	spi_fifo->length = 0;
+}
+
+void spi_fifo_transceive(SPIFifo *spi_fifo, const uint32_t length, const uint8_t *data) {
+	const uint64_t now = fake_hal_get_time_ns();
+
+	fake_ads1118.transfer_count++;
+	spi_fifo->length       = MIN(length, SPI_FIFO_DATA_MAX);
+	spi_fifo->done_time_ns = now + length*8*1000000000ULL/spi_fifo->baudrate;
+	spi_fifo->state        = SPI_FIFO_STATE_TRANSCEIVE;
+	memset(spi_fifo->miso, 0, sizeof(spi_fifo->miso));
+
+	// Result of the last conversion is shifted out first, reading it releases DOUT
+	if(fake_ads1118.data_ready) {
+		fake_ads1118.read_ns            = now;
+		fake_ads1118.read_data_ready_ns = fake_ads1118.data_ready_ns;
+	}
+	spi_fifo->miso[0]       = fake_ads1118.data >> 8;
+	spi_fifo->miso[1]       = fake_ads1118.data & 0xFF;
+	fake_ads1118.data_ready = false;
+
+	if(length >= 2) {
+		uint16_t config = (data[0] << 8) | data[1];
+		if((config & FAKE_ADS1118_CONFIG_NOP_MASK) == FAKE_ADS1118_CONFIG_NOP_VALID) {
+			if(fake_ads1118.inject_config_errors > 0) {
+				fake_ads1118.inject_config_errors--;
+				config ^= (1 << 12);
+			}
+
+			fake_ads1118.config = config & ~FAKE_ADS1118_CONFIG_SINGLE_SHOT;
+			if(!(config & FAKE_ADS1118_CONFIG_MODE)) {
+				fake_ads1118_start_conversion(spi_fifo->done_time_ns);
+			} else if(config & FAKE_ADS1118_CONFIG_SINGLE_SHOT) {
+				fake_ads1118_start_conversion(spi_fifo->done_time_ns);
+			} else if(!(fake_ads1118.conversion_config & FAKE_ADS1118_CONFIG_MODE)) {
+				// Continuous mode -> power-down
+				fake_ads1118.converting = false;
+			}
+		}
+	}
+
+	// Config register readback (32 bit data transmission cycle)
+	spi_fifo->miso[2] = fake_ads1118.config >> 8;
+	spi_fifo->miso[3] = fake_ads1118.config & 0xFF;
+
+	if(fake_ads1118.inject_spi_errors > 0) {
+		fake_ads1118.inject_spi_errors--;
+		spi_fifo->state = SPI_FIFO_STATE_TRANSCEIVE_ERROR;
+	}
+}
+
+SPIFifoState spi_fifo_next_state(SPIFifo *spi_fifo) {
+	if((spi_fifo->state == SPI_FIFO_STATE_TRANSCEIVE) && (fake_hal_get_time_ns() >= spi_fifo->done_time_ns)) {
+		spi_fifo->state = SPI_FIFO_STATE_TRANSCEIVE_READY;
+	}
+
+	return spi_fifo->state;
+}
+
+uint32_t spi_fifo_read_fifo(SPIFifo *spi_fifo, uint8_t *data, const uint32_t max_length) {
+	if(spi_fifo->state != SPI_FIFO_STATE_TRANSCEIVE_READY) {
+		return 0;
+	}
+
+	const uint32_t length = MIN(max_length, spi_fifo->length);
+	memcpy(data, spi_fifo->miso, length);
+	spi_fifo->state = SPI_FIFO_STATE_IDLE;
+	return length;
+}
+
+bool spi_fifo_coop_transceive(SPIFifo *spi_fifo, const uint32_t length, const uint8_t *data_mosi, uint8_t *data_miso) {
+	spi_fifo_transceive(spi_fifo, length, data_mosi);
+	while(true) {
+		const SPIFifoState state = spi_fifo_next_state(spi_fifo);
+		if(state & SPI_FIFO_STATE_ERROR) {
+			spi_fifo_init(spi_fifo);
+			return false;
+		}
+
+		if(state == SPI_FIFO_STATE_TRANSCEIVE_READY) {
+			return spi_fifo_read_fifo(spi_fifo, data_miso, length) == length;
+		}
+
+		coop_task_yield();
+	}
+}
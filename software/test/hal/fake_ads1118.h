@@ -0,0 +1,60 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * fake_ads1118.h: Simulated ADS1118 behind the SPI FIFO of the host build
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef FAKE_ADS1118_H
+#define FAKE_ADS1118_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Conversion result for the given config (multiplexer, PGA, temperature mode),
+// the input is integrated over [start_ns, end_ns) like the delta-sigma ADC does.
+typedef uint16_t (*FakeADS1118Input)(const uint16_t config, const uint64_t start_ns, const uint64_t end_ns);
+
+typedef struct {
+	uint16_t config;          // Config register (single-shot bit reads as 0)
+	bool     converting;
+	uint16_t conversion_config;
+	uint64_t conversion_start_ns;
+	uint64_t conversion_end_ns;
+	uint16_t data;
+	bool     data_ready;      // DOUT/DRDY is low while chip select is low
+
+	int32_t  clock_error_ppm; // Error of the internal oscillator, scales the conversion time
+	FakeADS1118Input input;
+
+	uint32_t transfer_count;
+	uint32_t conversion_count;
+	uint64_t data_ready_ns;   // End of the last conversion
+	uint64_t read_ns;            // Start of the last transfer that read a conversion result
+	uint64_t read_data_ready_ns; // End of the conversion that this transfer read
+
+	uint32_t inject_config_errors; // The next n config writes are received with a flipped multiplexer bit
+	uint32_t inject_spi_errors;    // The next n transfers end with an SPI FIFO error
+} FakeADS1118;
+
+extern FakeADS1118 fake_ads1118;
+
+void fake_ads1118_reset(void);
+uint32_t fake_ads1118_get_dout(void);
+uint64_t fake_ads1118_conversion_time_ns(const uint16_t config);
+
+#endif
@@ -0,0 +1,559 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * fake_hal.c: Fake XMC1 and bricklib2 HAL for the host build
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "fake_hal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmc_device.h"
+#include "xmc_gpio.h"
+#include "xmc_ccu4.h"
+#include "xmc_eru.h"
+#include "xmc_spi.h"
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/hal/ccu4_pwm/ccu4_pwm.h"
+#include "bricklib2/utility/moving_average.h"
+#include "bricklib2/utility/communication_callback.h"
+#include "bricklib2/warp/contactor_check.h"
+#include "bricklib2/utility/util_definitions.h"
+
+#include "communication.h"
+
+FakeHal fake_hal;
+SysTick_Type fake_hal_systick;
+XMC_GPIO_PORT_t fake_gpio_port[FAKE_GPIO_PORT_NUM];
+XMC_CCU4_SLICE_t fake_ccu4_slice[FAKE_CCU4_SLICE_NUM];
+XMC_CCU4_MODULE_t fake_ccu4_module;
+XMC_ERU_t fake_eru0;
+XMC_USIC_CH_t fake_usic_channel[2] = {{0}, {1}};
+BootloaderStatus bootloader_status;
+ContactorCheck contactor_check;
+
+#include "fake_ads1118.h"
+
+// IRQ handlers of the firmware (IRQ_Hdlr_n in the XMC1 startup code),
+// handlers that the firmware does not implement are NULL.
+#define FAKE_IRQ_HANDLER(n) extern void IRQ_Hdlr_##n(void) __attribute__((weak));
+FAKE_IRQ_HANDLER(0)  FAKE_IRQ_HANDLER(1)  FAKE_IRQ_HANDLER(2)  FAKE_IRQ_HANDLER(3)
+FAKE_IRQ_HANDLER(4)  FAKE_IRQ_HANDLER(5)  FAKE_IRQ_HANDLER(6)  FAKE_IRQ_HANDLER(7)
+FAKE_IRQ_HANDLER(8)  FAKE_IRQ_HANDLER(9)  FAKE_IRQ_HANDLER(10) FAKE_IRQ_HANDLER(11)
+FAKE_IRQ_HANDLER(12) FAKE_IRQ_HANDLER(13) FAKE_IRQ_HANDLER(14) FAKE_IRQ_HANDLER(15)
+FAKE_IRQ_HANDLER(16) FAKE_IRQ_HANDLER(17) FAKE_IRQ_HANDLER(18) FAKE_IRQ_HANDLER(19)
+FAKE_IRQ_HANDLER(20) FAKE_IRQ_HANDLER(21) FAKE_IRQ_HANDLER(22) FAKE_IRQ_HANDLER(23)
+FAKE_IRQ_HANDLER(24) FAKE_IRQ_HANDLER(25) FAKE_IRQ_HANDLER(26) FAKE_IRQ_HANDLER(27)
+FAKE_IRQ_HANDLER(28) FAKE_IRQ_HANDLER(29) FAKE_IRQ_HANDLER(30) FAKE_IRQ_HANDLER(31)
+
+static void (*const fake_irq_handler[32])(void) = {
+	IRQ_Hdlr_0,  IRQ_Hdlr_1,  IRQ_Hdlr_2,  IRQ_Hdlr_3,  IRQ_Hdlr_4,  IRQ_Hdlr_5,  IRQ_Hdlr_6,  IRQ_Hdlr_7,
+	IRQ_Hdlr_8,  IRQ_Hdlr_9,  IRQ_Hdlr_10, IRQ_Hdlr_11, IRQ_Hdlr_12, IRQ_Hdlr_13, IRQ_Hdlr_14, IRQ_Hdlr_15,
+	IRQ_Hdlr_16, IRQ_Hdlr_17, IRQ_Hdlr_18, IRQ_Hdlr_19, IRQ_Hdlr_20, IRQ_Hdlr_21, IRQ_Hdlr_22, IRQ_Hdlr_23,
+	IRQ_Hdlr_24, IRQ_Hdlr_25, IRQ_Hdlr_26, IRQ_Hdlr_27, IRQ_Hdlr_28, IRQ_Hdlr_29, IRQ_Hdlr_30, IRQ_Hdlr_31,
+};
+
+// ---- Virtual time and events ----
+
+static void fake_hal_update_systick(void) {
+	const uint32_t ticks_per_ms = FAKE_HAL_MCLK/1000;
+	fake_hal_systick.LOAD = ticks_per_ms - 1;
+	fake_hal_systick.VAL  = fake_hal_systick.LOAD - (uint32_t)((fake_hal.time_ns % FAKE_HAL_NS_PER_MS)*ticks_per_ms/FAKE_HAL_NS_PER_MS);
+}
+
+static void fake_ccu4_add_event_source(void);
+
+void fake_hal_reset(void) {
+	// The EEPROM content and its wear survive a reboot
+	uint32_t eeprom[FAKE_EEPROM_PAGE_NUM][EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+	uint32_t eeprom_write_count[FAKE_EEPROM_PAGE_NUM];
+	memcpy(eeprom, fake_hal.eeprom, sizeof(eeprom));
+	memcpy(eeprom_write_count, fake_hal.eeprom_write_count, sizeof(eeprom_write_count));
+
+	memset(&fake_hal, 0, sizeof(FakeHal));
+	memcpy(fake_hal.eeprom, eeprom, sizeof(eeprom));
+	memcpy(fake_hal.eeprom_write_count, eeprom_write_count, sizeof(eeprom_write_count));
+	fake_hal.timer_read_ns = 250;
+	fake_hal.uid           = 0x1234ABCD;
+
+	memset(fake_gpio_port, 0, sizeof(fake_gpio_port));
+	for(uint8_t i = 0; i < FAKE_GPIO_PORT_NUM; i++) {
+		fake_gpio_port[i].index = i;
+	}
+
+	memset(fake_ccu4_slice, 0, sizeof(fake_ccu4_slice));
+	for(uint8_t i = 0; i < FAKE_CCU4_SLICE_NUM; i++) {
+		fake_ccu4_slice[i].number = i;
+	}
+	memset(&fake_ccu4_module, 0, sizeof(fake_ccu4_module));
+	memset(&fake_eru0, 0, sizeof(fake_eru0));
+	memset(&bootloader_status, 0, sizeof(bootloader_status));
+	memset(&contactor_check, 0, sizeof(contactor_check));
+
+	fake_hal_update_systick();
+	fake_ccu4_add_event_source();
+	fake_ads1118_reset();
+}
+
+void fake_hal_eeprom_erase(void) {
+	memset(fake_hal.eeprom, 0xFF, sizeof(fake_hal.eeprom));
+	memset(fake_hal.eeprom_write_count, 0, sizeof(fake_hal.eeprom_write_count));
+}
+
+void fake_hal_add_event_source(const FakeHalEventSource *source) {
+	if(fake_hal.event_source_num >= FAKE_HAL_EVENT_SOURCE_MAX) {
+		fprintf(stderr, "fake_hal: too many event sources\n");
+		abort();
+	}
+
+	fake_hal.event_sources[fake_hal.event_source_num++] = *source;
+}
+
+uint64_t fake_hal_get_time_ns(void) {
+	return fake_hal.time_ns;
+}
+
+void fake_hal_advance_ns(const uint64_t ns) {
+	const uint64_t target = fake_hal.time_ns + ns;
+
+	// An IRQ handler that busy waits must not process events recursively
+	if(fake_hal.advancing) {
+		fake_hal.time_ns = target;
+		fake_hal_update_systick();
+		return;
+	}
+
+	fake_hal.advancing = true;
+	while(true) {
+		uint8_t next_source = 0xFF;
+		uint64_t next_time  = FAKE_HAL_NS_NONE;
+		for(uint8_t i = 0; i < fake_hal.event_source_num; i++) {
+			const uint64_t t = fake_hal.event_sources[i].next_event_ns();
+			if(t < next_time) {
+				next_time   = t;
+				next_source = i;
+			}
+		}
+
+		if((next_source == 0xFF) || (next_time > target)) {
+			break;
+		}
+
+		if(next_time > fake_hal.time_ns) {
+			fake_hal.time_ns = next_time;
+			fake_hal_update_systick();
+		}
+		fake_hal.event_sources[next_source].handle_event(next_time);
+	}
+
+	fake_hal.time_ns = target;
+	fake_hal_update_systick();
+	fake_hal.advancing = false;
+}
+
+// ---- NVIC ----
+
+static void fake_hal_irq_dispatch(void) {
+	while(!fake_hal.irq_disabled && !fake_hal.in_irq && (fake_hal.irq_pending & fake_hal.irq_enabled)) {
+		for(uint8_t irq = 0; irq < 32; irq++) {
+			if((fake_hal.irq_pending & fake_hal.irq_enabled) & (1u << irq)) {
+				fake_hal.irq_pending &= ~(1u << irq);
+				fake_hal.irq_count[irq]++;
+				if(fake_irq_handler[irq] != NULL) {
+					fake_hal.in_irq = true;
+					fake_irq_handler[irq]();
+					fake_hal.in_irq = false;
+				}
+				break;
+			}
+		}
+	}
+}
+
+void fake_hal_irq_raise(const IRQn_Type irq) {
+	fake_hal.irq_pending |= (1u << irq);
+	fake_hal_irq_dispatch();
+}
+
+void NVIC_SetPriority(const IRQn_Type irq, const uint32_t priority) {
+	(void)irq;
+	(void)priority;
+}
+
+void NVIC_EnableIRQ(const IRQn_Type irq) {
+	fake_hal.irq_enabled |= (1u << irq);
+	fake_hal_irq_dispatch();
+}
+
+void NVIC_DisableIRQ(const IRQn_Type irq) {
+	fake_hal.irq_enabled &= ~(1u << irq);
+}
+
+void NVIC_ClearPendingIRQ(const IRQn_Type irq) {
+	fake_hal.irq_pending &= ~(1u << irq);
+}
+
+void NVIC_SetPendingIRQ(const IRQn_Type irq) {
+	fake_hal_irq_raise(irq);
+}
+
+uint32_t NVIC_GetPendingIRQ(const IRQn_Type irq) {
+	return (fake_hal.irq_pending >> irq) & 1;
+}
+
+void NVIC_SystemReset(void) {
+	fake_hal.reset_count++;
+	if(fake_hal.reset_jmp != NULL) {
+		longjmp(*fake_hal.reset_jmp, 1);
+	}
+
+	fprintf(stderr, "fake_hal: unexpected NVIC_SystemReset\n");
+	abort();
+}
+
+void __disable_irq(void) {
+	fake_hal.irq_disabled = true;
+}
+
+void __enable_irq(void) {
+	fake_hal.irq_disabled = false;
+	fake_hal_irq_dispatch();
+}
+
+// ---- System timer ----
+
+uint32_t system_timer_get_ms(void) {
+	return (uint32_t)(fake_hal.time_ns/FAKE_HAL_NS_PER_MS);
+}
+
+bool system_timer_is_time_elapsed_ms(const uint32_t start_measurement, const uint32_t time_to_be_elapsed) {
+	return (uint32_t)(system_timer_get_ms() - start_measurement) >= time_to_be_elapsed;
+}
+
+void system_timer_sleep_ms(const uint32_t sleep) {
+	fake_hal_advance_ns(sleep*FAKE_HAL_NS_PER_MS);
+}
+
+// ---- GPIO ----
+
+void fake_gpio_set_input(XMC_GPIO_PORT_t *const port, const uint8_t pin, const FakeGPIOLevel level) {
+	fake_hal.gpio_input[port->index][pin] = level;
+}
+
+void XMC_GPIO_Init(XMC_GPIO_PORT_t *const port, const uint8_t pin, const XMC_GPIO_CONFIG_t *const config) {
+	port->mode[pin]   = config->mode;
+	port->output[pin] = config->output_level;
+}
+
+void XMC_GPIO_SetMode(XMC_GPIO_PORT_t *const port, const uint8_t pin, const XMC_GPIO_MODE_t mode) {
+	port->mode[pin] = mode;
+}
+
+void XMC_GPIO_SetOutputHigh(XMC_GPIO_PORT_t *const port, const uint8_t pin) {
+	port->output[pin] = 1;
+}
+
+void XMC_GPIO_SetOutputLow(XMC_GPIO_PORT_t *const port, const uint8_t pin) {
+	port->output[pin] = 0;
+}
+
+void XMC_GPIO_ToggleOutput(XMC_GPIO_PORT_t *const port, const uint8_t pin) {
+	port->output[pin] = !port->output[pin];
+}
+
+uint32_t XMC_GPIO_GetInput(XMC_GPIO_PORT_t *const port, const uint8_t pin) {
+	// DOUT/DRDY of the ADS1118
+	if((port->index == 0) && (pin == 6)) {
+		return fake_ads1118_get_dout();
+	}
+
+	// Push-pull outputs read back their own level
+	if(port->mode[pin] & XMC_GPIO_MODE_OUTPUT_PUSH_PULL) {
+		return port->output[pin];
+	}
+
+	switch(fake_hal.gpio_input[port->index][pin]) {
+		case FAKE_GPIO_LOW:  return 0;
+		case FAKE_GPIO_HIGH: return 1;
+		default:             return port->mode[pin] == XMC_GPIO_MODE_INPUT_PULL_UP;
+	}
+}
+
+// ---- CCU4 ----
+
+static uint64_t fake_ccu4_ticks_at(const uint64_t time_ns) {
+	return time_ns*(FAKE_CCU4_CLOCK/1000000)/1000;
+}
+
+static uint64_t fake_ccu4_time_of_tick(const uint64_t tick) {
+	// Rounded up, the first ns at which the timer has reached tick
+	return (tick*1000 + (FAKE_CCU4_CLOCK/1000000) - 1)/(FAKE_CCU4_CLOCK/1000000);
+}
+
+uint32_t fake_ccu4_timer_at(const XMC_CCU4_SLICE_t *const slice, const uint64_t time_ns) {
+	if(!slice->running) {
+		return 0;
+	}
+
+	return fake_ccu4_ticks_at(time_ns) % (slice->period + 1);
+}
+
+static uint64_t fake_ccu4_active_ticks_until(const XMC_CCU4_SLICE_t *const slice, const uint64_t ticks) {
+	const uint64_t period    = slice->period + 1;
+	const uint64_t compare   = MIN(slice->compare, period);
+	const uint64_t remainder = ticks % period;
+	return (ticks/period)*(period - compare) + ((remainder > compare) ? (remainder - compare) : 0);
+}
+
+uint64_t fake_ccu4_active_time_ns(const XMC_CCU4_SLICE_t *const slice, const uint64_t start_ns, const uint64_t end_ns) {
+	if(!slice->running || (end_ns <= start_ns)) {
+		return 0;
+	}
+
+	const uint64_t ticks = fake_ccu4_active_ticks_until(slice, fake_ccu4_ticks_at(end_ns)) - fake_ccu4_active_ticks_until(slice, fake_ccu4_ticks_at(start_ns));
+	return ticks*1000/(FAKE_CCU4_CLOCK/1000000);
+}
+
+uint16_t XMC_CCU4_SLICE_GetTimerValue(const XMC_CCU4_SLICE_t *const slice) {
+	// Reading the timer takes a few cycles, this way busy waits on the timer terminate
+	fake_hal_advance_ns(fake_hal.timer_read_ns);
+	return fake_ccu4_timer_at(slice, fake_hal.time_ns);
+}
+
+void XMC_CCU4_SLICE_SetTimerCompareMatch(XMC_CCU4_SLICE_t *const slice, const uint16_t compare_val) {
+	slice->compare = compare_val;
+}
+
+void XMC_CCU4_EnableShadowTransfer(XMC_CCU4_MODULE_t *const module, const uint32_t shadow_transfer_msk) {
+	(void)shadow_transfer_msk;
+	module->shadow_transfer_count++;
+}
+
+static uint64_t fake_ccu4_period_match_time[FAKE_CCU4_SLICE_NUM];
+
+void XMC_CCU4_SLICE_EnableEvent(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event) {
+	if((event == XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH) && !(slice->events & (1 << event))) {
+		fake_ccu4_period_match_time[slice->number] = fake_hal.time_ns;
+	}
+	slice->events |= (1 << event);
+}
+
+void XMC_CCU4_SLICE_DisableEvent(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event) {
+	slice->events &= ~(1 << event);
+}
+
+void XMC_CCU4_SLICE_ClearEvent(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event) {
+	(void)slice;
+	(void)event;
+}
+
+void XMC_CCU4_SLICE_SetInterruptNode(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event, const XMC_CCU4_SLICE_SR_ID_t sr) {
+	if(event == XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH) {
+		slice->period_match_sr = sr;
+	}
+}
+
+// Next period match (timer wraps from period to 0) after the last handled one
+static uint64_t fake_ccu4_next_period_match(const uint8_t number) {
+	const XMC_CCU4_SLICE_t *slice = &fake_ccu4_slice[number];
+	if(!slice->running || !(slice->events & (1 << XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH))) {
+		return FAKE_HAL_NS_NONE;
+	}
+
+	const uint64_t period = slice->period + 1;
+	const uint64_t tick   = (fake_ccu4_ticks_at(fake_ccu4_period_match_time[number])/period + 1)*period;
+	return fake_ccu4_time_of_tick(tick);
+}
+
+static uint64_t fake_ccu4_next_event_ns(void) {
+	uint64_t next = FAKE_HAL_NS_NONE;
+	for(uint8_t i = 0; i < FAKE_CCU4_SLICE_NUM; i++) {
+		next = MIN(next, fake_ccu4_next_period_match(i));
+	}
+
+	return next;
+}
+
+static void fake_ccu4_handle_event(const uint64_t time_ns) {
+	for(uint8_t i = 0; i < FAKE_CCU4_SLICE_NUM; i++) {
+		if(fake_ccu4_next_period_match(i) == time_ns) {
+			fake_ccu4_period_match_time[i] = time_ns;
+			fake_hal_irq_raise(FAKE_CCU4_SR0_IRQ + fake_ccu4_slice[i].period_match_sr);
+		}
+	}
+}
+
+static void fake_ccu4_add_event_source(void) {
+	const FakeHalEventSource source = {
+		.next_event_ns = fake_ccu4_next_event_ns,
+		.handle_event  = fake_ccu4_handle_event,
+	};
+
+	memset(fake_ccu4_period_match_time, 0, sizeof(fake_ccu4_period_match_time));
+	fake_hal_add_event_source(&source);
+}
+
+void ccu4_pwm_init(XMC_GPIO_PORT_t *const port, const uint8_t pin, const uint8_t ccu4_slice_number, const uint16_t period_value) {
+	(void)port;
+	(void)pin;
+	fake_ccu4_slice[ccu4_slice_number].running = true;
+	fake_ccu4_slice[ccu4_slice_number].period  = period_value;
+	fake_ccu4_slice[ccu4_slice_number].compare = period_value + 1;
+}
+
+void ccu4_pwm_set_duty_cycle(const uint8_t ccu4_slice_number, const uint16_t duty_cycle) {
+	fake_ccu4_slice[ccu4_slice_number].compare = duty_cycle;
+}
+
+uint16_t ccu4_pwm_get_duty_cycle(const uint8_t ccu4_slice_number) {
+	return fake_ccu4_slice[ccu4_slice_number].compare;
+}
+
+// ---- ERU ----
+
+void XMC_ERU_ETL_Init(XMC_ERU_t *const eru, const uint8_t channel, const XMC_ERU_ETL_CONFIG_t *const config) {
+	eru->output_trigger_enabled[channel] = config->enable_output_trigger;
+	eru->output_trigger_channel[channel] = config->output_trigger_channel;
+}
+
+void XMC_ERU_ETL_EnableOutputTrigger(XMC_ERU_t *const eru, const uint8_t channel) {
+	eru->output_trigger_enabled[channel] = true;
+}
+
+void XMC_ERU_ETL_DisableOutputTrigger(XMC_ERU_t *const eru, const uint8_t channel) {
+	eru->output_trigger_enabled[channel] = false;
+}
+
+void XMC_ERU_OGU_SetServiceRequestMode(XMC_ERU_t *const eru, const uint8_t channel, const XMC_ERU_OGU_SERVICE_REQUEST_t mode) {
+	eru->service_request[channel] = (mode == XMC_ERU_OGU_SERVICE_REQUEST_ON_TRIGGER);
+}
+
+void fake_eru_edge(XMC_ERU_t *const eru, const uint8_t channel) {
+	if(!eru->output_trigger_enabled[channel]) {
+		return;
+	}
+
+	const uint8_t ogu = eru->output_trigger_channel[channel];
+	if(eru->service_request[ogu]) {
+		fake_hal_irq_raise(FAKE_ERU0_SR0_IRQ + ogu);
+	}
+}
+
+// ---- Bootloader (EEPROM, UID, messages to the Brick) ----
+
+void bootloader_tick(void) {
+}
+
+uint32_t bootloader_get_uid(void) {
+	return fake_hal.uid;
+}
+
+void bootloader_read_eeprom_page(const uint32_t page_num, uint32_t *data) {
+	memcpy(data, fake_hal.eeprom[page_num], EEPROM_PAGE_SIZE);
+}
+
+bool bootloader_write_eeprom_page(const uint32_t page_num, uint32_t *data) {
+	if(fake_hal.eeprom_power_lost) {
+		return false;
+	}
+
+	fake_hal.eeprom_write_count[page_num]++;
+
+	// Every write is an erase followed by a program
+	memset(fake_hal.eeprom[page_num], 0xFF, EEPROM_PAGE_SIZE);
+	if(fake_hal.eeprom_power_loss_countdown > 0) {
+		fake_hal.eeprom_power_loss_countdown--;
+		if(fake_hal.eeprom_power_loss_countdown == 0) {
+			fake_hal.eeprom_power_lost = true;
+			return false;
+		}
+	}
+
+	memcpy(fake_hal.eeprom[page_num], data, EEPROM_PAGE_SIZE);
+	return true;
+}
+
+bool bootloader_spitfp_is_send_possible(SPITFP *st) {
+	(void)st;
+	return true;
+}
+
+void bootloader_spitfp_send_ack_and_message(BootloaderStatus *bs, uint8_t *data, const uint8_t length) {
+	bs->st.messages_sent++;
+	memcpy(fake_hal.tfp_message, data, MIN(length, TFP_MESSAGE_MAX_LENGTH));
+	fake_hal.tfp_message_length = length;
+	fake_hal.tfp_message_count++;
+}
+
+void tfp_make_default_header(TFPMessageHeader *header, const uint32_t uid, const uint8_t length, const uint8_t fid) {
+	memset(header, 0, sizeof(TFPMessageHeader));
+	header->uid    = uid;
+	header->length = length;
+	header->fid    = fid;
+}
+
+uint8_t tfp_get_fid_from_message(const void *message) {
+	return ((const TFPMessageHeader*)message)->fid;
+}
+
+// ---- Utilities ----
+
+void moving_average_init(MovingAverage *ma, const MOVING_AVERAGE_TYPE initial_value, const uint16_t length) {
+	ma->length = MIN(MAX(length, 1), MOVING_AVERAGE_MAX_LENGTH);
+	ma->index  = 0;
+	ma->sum    = 0;
+	for(uint16_t i = 0; i < ma->length; i++) {
+		ma->values[i] = initial_value;
+		ma->sum      += initial_value;
+	}
+}
+
+bool moving_average_handle_value(MovingAverage *ma, const MOVING_AVERAGE_TYPE value) {
+	ma->sum              -= ma->values[ma->index];
+	ma->values[ma->index] = value;
+	ma->sum              += value;
+	ma->index             = (ma->index + 1) % ma->length;
+	return true;
+}
+
+MOVING_AVERAGE_TYPE moving_average_get(MovingAverage *ma) {
+	return ma->sum/ma->length;
+}
+
+static bool (*const communication_callback_handler[COMMUNICATION_CALLBACK_HANDLER_NUM])(void) = {
+	COMMUNICATION_CALLBACK_LIST_INIT
+};
+
+void communication_callback_init(void) {
+}
+
+void communication_callback_tick(void) {
+	for(uint8_t i = 0; i < COMMUNICATION_CALLBACK_HANDLER_NUM; i++) {
+		communication_callback_handler[i]();
+	}
+}
+
+void contactor_check_init(void) {
+	memset(&contactor_check, 0, sizeof(ContactorCheck));
+}
+
+void contactor_check_tick(void) {
+}
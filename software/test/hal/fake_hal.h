@@ -0,0 +1,113 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * fake_hal.h: Control interface of the fake HAL for the host build
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef FAKE_HAL_H
+#define FAKE_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <setjmp.h>
+
+#include "xmc_gpio.h"
+#include "xmc_ccu4.h"
+#include "bricklib2/bootloader/bootloader.h"
+#include "bricklib2/protocols/tfp/tfp.h"
+
+// The fake HAL runs on a virtual clock with 1ns resolution. Time only advances
+// through fake_hal_advance_ns (main loop iterations, system_timer_sleep_ms and
+// busy waits on a CCU4 timer). Peripheral events (end of an ADS1118 conversion,
+// CCU4 period match) are processed in order and call the firmware IRQ handlers
+// at their exact time, unless IRQs are disabled (then they are pended).
+
+#define FAKE_HAL_NS_PER_MS 1000000ULL
+#define FAKE_HAL_NS_NONE   UINT64_MAX
+
+typedef struct {
+	uint64_t (*next_event_ns)(void); // FAKE_HAL_NS_NONE if there is no event
+	void (*handle_event)(const uint64_t time_ns);
+} FakeHalEventSource;
+
+#define FAKE_HAL_EVENT_SOURCE_MAX 4
+
+typedef enum {
+	FAKE_GPIO_FLOATING = 0,
+	FAKE_GPIO_LOW,
+	FAKE_GPIO_HIGH,
+} FakeGPIOLevel;
+
+typedef struct {
+	uint64_t time_ns;
+	bool     advancing;
+
+	// Time a single read of a CCU4 timer takes in a busy wait loop
+	uint32_t timer_read_ns;
+
+	// NVIC
+	bool     irq_disabled;
+	bool     in_irq;
+	uint32_t irq_enabled;
+	uint32_t irq_pending;
+	uint32_t irq_count[32];
+
+	// External levels of the GPIO inputs
+	uint8_t  gpio_input[FAKE_GPIO_PORT_NUM][FAKE_GPIO_PIN_NUM];
+
+	// Emulated EEPROM of the bootloader
+	uint32_t eeprom[FAKE_EEPROM_PAGE_NUM][EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+	uint32_t eeprom_write_count[FAKE_EEPROM_PAGE_NUM];
+	int32_t  eeprom_power_loss_countdown; // > 0: the n-th write is interrupted after the erase
+	bool     eeprom_power_lost;
+
+	uint32_t uid;
+
+	// Last message that was sent to the Brick (callbacks)
+	uint8_t  tfp_message[TFP_MESSAGE_MAX_LENGTH];
+	uint8_t  tfp_message_length;
+	uint32_t tfp_message_count;
+
+	// NVIC_SystemReset jumps here if set, otherwise the test is aborted
+	jmp_buf *reset_jmp;
+	uint32_t reset_count;
+
+	FakeHalEventSource event_sources[FAKE_HAL_EVENT_SOURCE_MAX];
+	uint8_t  event_source_num;
+} FakeHal;
+
+extern FakeHal fake_hal;
+
+// Resets all peripherals and the virtual time, the EEPROM content and write counters are kept
+void fake_hal_reset(void);
+void fake_hal_eeprom_erase(void);
+void fake_hal_add_event_source(const FakeHalEventSource *source);
+
+uint64_t fake_hal_get_time_ns(void);
+void fake_hal_advance_ns(const uint64_t ns);
+void fake_hal_irq_raise(const IRQn_Type irq);
+
+void fake_gpio_set_input(XMC_GPIO_PORT_t *const port, const uint8_t pin, const FakeGPIOLevel level);
+
+// Timer value of a running CCU4 slice at the given time
+uint32_t fake_ccu4_timer_at(const XMC_CCU4_SLICE_t *const slice, const uint64_t time_ns);
+
+// Time in ns that the output of a CCU4 slice is active in [start_ns, end_ns)
+uint64_t fake_ccu4_active_time_ns(const XMC_CCU4_SLICE_t *const slice, const uint64_t start_ns, const uint64_t end_ns);
+
+#endif
@@ -0,0 +1,85 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * xmc_ccu4.h: Fake XMC1 CCU4 timer driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XMC_CCU4_H
+#define XMC_CCU4_H
+
+#include "xmc_device.h"
+
+#define FAKE_CCU4_SLICE_NUM 4
+
+// CCU4 runs with PCLK (64MHz on the XMC1302)
+#define FAKE_CCU4_CLOCK 64000000
+
+typedef struct {
+	uint8_t  number;
+	bool     running;
+	uint16_t period;  // Timer counts from 0 to period
+	uint16_t compare; // Output is active while timer >= compare
+	uint32_t events;  // Enabled events, see XMC_CCU4_SLICE_IRQ_ID_t
+	uint8_t  period_match_sr;
+} XMC_CCU4_SLICE_t;
+
+typedef struct {
+	uint32_t shadow_transfer_count;
+} XMC_CCU4_MODULE_t;
+
+extern XMC_CCU4_SLICE_t fake_ccu4_slice[FAKE_CCU4_SLICE_NUM];
+extern XMC_CCU4_MODULE_t fake_ccu4_module;
+
+#define CCU40       (&fake_ccu4_module)
+#define CCU40_CC40  (&fake_ccu4_slice[0])
+#define CCU40_CC41  (&fake_ccu4_slice[1])
+#define CCU40_CC42  (&fake_ccu4_slice[2])
+#define CCU40_CC43  (&fake_ccu4_slice[3])
+
+typedef enum {
+	XMC_CCU4_SHADOW_TRANSFER_SLICE_0           = 0x1,
+	XMC_CCU4_SHADOW_TRANSFER_DITHER_SLICE_0    = 0x2,
+	XMC_CCU4_SHADOW_TRANSFER_PRESCALER_SLICE_0 = 0x4,
+} XMC_CCU4_SHADOW_TRANSFER_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH  = 0,
+	XMC_CCU4_SLICE_IRQ_ID_ONE_MATCH     = 1,
+	XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_UP   = 2,
+	XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_DOWN = 3,
+} XMC_CCU4_SLICE_IRQ_ID_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_SR_ID_0 = 0,
+	XMC_CCU4_SLICE_SR_ID_1 = 1,
+	XMC_CCU4_SLICE_SR_ID_2 = 2,
+	XMC_CCU4_SLICE_SR_ID_3 = 3,
+} XMC_CCU4_SLICE_SR_ID_t;
+
+// CCU40 service requests SR0-SR3 are IRQ 21-24 on the XMC1300
+#define FAKE_CCU4_SR0_IRQ 21
+
+uint16_t XMC_CCU4_SLICE_GetTimerValue(const XMC_CCU4_SLICE_t *const slice);
+void XMC_CCU4_SLICE_SetTimerCompareMatch(XMC_CCU4_SLICE_t *const slice, const uint16_t compare_val);
+void XMC_CCU4_EnableShadowTransfer(XMC_CCU4_MODULE_t *const module, const uint32_t shadow_transfer_msk);
+void XMC_CCU4_SLICE_EnableEvent(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event);
+void XMC_CCU4_SLICE_DisableEvent(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event);
+void XMC_CCU4_SLICE_ClearEvent(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event);
+void XMC_CCU4_SLICE_SetInterruptNode(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event, const XMC_CCU4_SLICE_SR_ID_t sr);
+
+#endif
@@ -0,0 +1,63 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * xmc_device.h: Fake XMC1302 device and CMSIS core definitions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XMC_DEVICE_H
+#define XMC_DEVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define XMC1302
+#define UC_FAMILY XMC1
+#define UC_SERIES XMC13
+
+#define __STATIC_INLINE static inline
+#define __NOP()
+
+// Core clock of the XMC1302, SysTick is clocked with it
+#define FAKE_HAL_MCLK 32000000
+
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t LOAD;
+	volatile uint32_t VAL;
+	volatile uint32_t CALIB;
+} SysTick_Type;
+
+// VAL and LOAD are updated by the fake HAL whenever the virtual time advances
+extern SysTick_Type fake_hal_systick;
+#define SysTick (&fake_hal_systick)
+
+typedef int IRQn_Type;
+
+void NVIC_SetPriority(const IRQn_Type irq, const uint32_t priority);
+void NVIC_EnableIRQ(const IRQn_Type irq);
+void NVIC_DisableIRQ(const IRQn_Type irq);
+void NVIC_ClearPendingIRQ(const IRQn_Type irq);
+void NVIC_SetPendingIRQ(const IRQn_Type irq);
+uint32_t NVIC_GetPendingIRQ(const IRQn_Type irq);
+void NVIC_SystemReset(void) __attribute__((noreturn));
+
+void __disable_irq(void);
+void __enable_irq(void);
+
+#endif
@@ -0,0 +1,98 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * xmc_eru.h: Fake XMC1 ERU driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XMC_ERU_H
+#define XMC_ERU_H
+
+#include "xmc_device.h"
+
+#define FAKE_ERU_CHANNEL_NUM 4
+
+typedef struct {
+	bool    output_trigger_enabled[FAKE_ERU_CHANNEL_NUM];
+	uint8_t output_trigger_channel[FAKE_ERU_CHANNEL_NUM];
+	bool    service_request[FAKE_ERU_CHANNEL_NUM];
+} XMC_ERU_t;
+
+extern XMC_ERU_t fake_eru0;
+#define XMC_ERU0 (&fake_eru0)
+
+// ERU0 OGU0-OGU3 service requests are IRQ 3-6 on the XMC1300
+#define FAKE_ERU0_SR0_IRQ 3
+
+typedef enum {
+	XMC_ERU_ETL_INPUT_A0 = 0, XMC_ERU_ETL_INPUT_A1 = 1, XMC_ERU_ETL_INPUT_A2 = 2, XMC_ERU_ETL_INPUT_A3 = 3,
+} XMC_ERU_ETL_INPUT_A_t;
+
+typedef enum {
+	XMC_ERU_ETL_INPUT_B0 = 0, XMC_ERU_ETL_INPUT_B1 = 1, XMC_ERU_ETL_INPUT_B2 = 2, XMC_ERU_ETL_INPUT_B3 = 3,
+} XMC_ERU_ETL_INPUT_B_t;
+
+typedef enum {
+	XMC_ERU_ETL_SOURCE_A = 0,
+	XMC_ERU_ETL_SOURCE_B = 1,
+} XMC_ERU_ETL_SOURCE_t;
+
+typedef enum {
+	XMC_ERU_ETL_EDGE_DETECTION_DISABLED = 0,
+	XMC_ERU_ETL_EDGE_DETECTION_RISING   = 1,
+	XMC_ERU_ETL_EDGE_DETECTION_FALLING  = 2,
+	XMC_ERU_ETL_EDGE_DETECTION_BOTH     = 3,
+} XMC_ERU_ETL_EDGE_DETECTION_t;
+
+typedef enum {
+	XMC_ERU_ETL_STATUS_FLAG_MODE_SWCTRL = 0,
+	XMC_ERU_ETL_STATUS_FLAG_MODE_HWCTRL = 1,
+} XMC_ERU_ETL_STATUS_FLAG_MODE_t;
+
+typedef enum {
+	XMC_ERU_ETL_OUTPUT_TRIGGER_CHANNEL0 = 0,
+	XMC_ERU_ETL_OUTPUT_TRIGGER_CHANNEL1 = 1,
+	XMC_ERU_ETL_OUTPUT_TRIGGER_CHANNEL2 = 2,
+	XMC_ERU_ETL_OUTPUT_TRIGGER_CHANNEL3 = 3,
+} XMC_ERU_ETL_OUTPUT_TRIGGER_CHANNEL_t;
+
+typedef enum {
+	XMC_ERU_OGU_SERVICE_REQUEST_DISABLED          = 0,
+	XMC_ERU_OGU_SERVICE_REQUEST_ON_TRIGGER        = 1,
+	XMC_ERU_OGU_SERVICE_REQUEST_ON_TRIGGER_AND_PDR_MATCH = 2,
+	XMC_ERU_OGU_SERVICE_REQUEST_ON_TRIGGER_AND_PDR_MISMATCH = 3,
+} XMC_ERU_OGU_SERVICE_REQUEST_t;
+
+typedef struct {
+	XMC_ERU_ETL_INPUT_A_t input_a;
+	XMC_ERU_ETL_INPUT_B_t input_b;
+	XMC_ERU_ETL_SOURCE_t source;
+	XMC_ERU_ETL_EDGE_DETECTION_t edge_detection;
+	XMC_ERU_ETL_STATUS_FLAG_MODE_t status_flag_mode;
+	bool enable_output_trigger;
+	XMC_ERU_ETL_OUTPUT_TRIGGER_CHANNEL_t output_trigger_channel;
+} XMC_ERU_ETL_CONFIG_t;
+
+void XMC_ERU_ETL_Init(XMC_ERU_t *const eru, const uint8_t channel, const XMC_ERU_ETL_CONFIG_t *const config);
+void XMC_ERU_ETL_EnableOutputTrigger(XMC_ERU_t *const eru, const uint8_t channel);
+void XMC_ERU_ETL_DisableOutputTrigger(XMC_ERU_t *const eru, const uint8_t channel);
+void XMC_ERU_OGU_SetServiceRequestMode(XMC_ERU_t *const eru, const uint8_t channel, const XMC_ERU_OGU_SERVICE_REQUEST_t mode);
+
+// Falling edge on ETL channel (called by the peripheral models)
+void fake_eru_edge(XMC_ERU_t *const eru, const uint8_t channel);
+
+#endif
@@ -0,0 +1,131 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * xmc_gpio.h: Fake XMC1 GPIO driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XMC_GPIO_H
+#define XMC_GPIO_H
+
+#include "xmc_device.h"
+
+#define FAKE_GPIO_PORT_NUM 5
+#define FAKE_GPIO_PIN_NUM  16
+
+typedef enum {
+	XMC_GPIO_MODE_INPUT_TRISTATE        = 0x00,
+	XMC_GPIO_MODE_INPUT_PULL_DOWN       = 0x08,
+	XMC_GPIO_MODE_INPUT_PULL_UP         = 0x10,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL      = 0x80,
+	XMC_GPIO_MODE_OUTPUT_OPEN_DRAIN     = 0xC0,
+	XMC_GPIO_MODE_OUTPUT_ALT1           = 0x08,
+	XMC_GPIO_MODE_OUTPUT_ALT2           = 0x10,
+	XMC_GPIO_MODE_OUTPUT_ALT3           = 0x18,
+	XMC_GPIO_MODE_OUTPUT_ALT4           = 0x20,
+	XMC_GPIO_MODE_OUTPUT_ALT5           = 0x28,
+	XMC_GPIO_MODE_OUTPUT_ALT6           = 0x30,
+	XMC_GPIO_MODE_OUTPUT_ALT7           = 0x38,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT1 = 0x88,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT2 = 0x90,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT3 = 0x98,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT4 = 0xA0,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT5 = 0xA8,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT6 = 0xB0,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT7 = 0xB8,
+} XMC_GPIO_MODE_t;
+
+typedef enum {
+	XMC_GPIO_OUTPUT_LEVEL_LOW  = 0,
+	XMC_GPIO_OUTPUT_LEVEL_HIGH = 1,
+} XMC_GPIO_OUTPUT_LEVEL_t;
+
+typedef enum {
+	XMC_GPIO_INPUT_HYSTERESIS_STANDARD = 0,
+	XMC_GPIO_INPUT_HYSTERESIS_LARGE    = 1,
+} XMC_GPIO_INPUT_HYSTERESIS_t;
+
+typedef struct {
+	XMC_GPIO_MODE_t mode;
+	XMC_GPIO_OUTPUT_LEVEL_t output_level;
+	XMC_GPIO_INPUT_HYSTERESIS_t input_hysteresis;
+} XMC_GPIO_CONFIG_t;
+
+typedef struct {
+	uint8_t index;
+	uint8_t mode[FAKE_GPIO_PIN_NUM];
+	uint8_t output[FAKE_GPIO_PIN_NUM];
+} XMC_GPIO_PORT_t;
+
+extern XMC_GPIO_PORT_t fake_gpio_port[FAKE_GPIO_PORT_NUM];
+
+#define XMC_GPIO_PORT0 (&fake_gpio_port[0])
+#define XMC_GPIO_PORT1 (&fake_gpio_port[1])
+#define XMC_GPIO_PORT2 (&fake_gpio_port[2])
+#define XMC_GPIO_PORT3 (&fake_gpio_port[3])
+#define XMC_GPIO_PORT4 (&fake_gpio_port[4])
+
+void XMC_GPIO_Init(XMC_GPIO_PORT_t *const port, const uint8_t pin, const XMC_GPIO_CONFIG_t *const config);
+void XMC_GPIO_SetMode(XMC_GPIO_PORT_t *const port, const uint8_t pin, const XMC_GPIO_MODE_t mode);
+void XMC_GPIO_SetOutputHigh(XMC_GPIO_PORT_t *const port, const uint8_t pin);
+void XMC_GPIO_SetOutputLow(XMC_GPIO_PORT_t *const port, const uint8_t pin);
+void XMC_GPIO_ToggleOutput(XMC_GPIO_PORT_t *const port, const uint8_t pin);
+uint32_t XMC_GPIO_GetInput(XMC_GPIO_PORT_t *const port, const uint8_t pin);
+
+#define P0_0  XMC_GPIO_PORT0, 0
+#define P0_1  XMC_GPIO_PORT0, 1
+#define P0_2  XMC_GPIO_PORT0, 2
+#define P0_3  XMC_GPIO_PORT0, 3
+#define P0_4  XMC_GPIO_PORT0, 4
+#define P0_5  XMC_GPIO_PORT0, 5
+#define P0_6  XMC_GPIO_PORT0, 6
+#define P0_7  XMC_GPIO_PORT0, 7
+#define P0_8  XMC_GPIO_PORT0, 8
+#define P0_9  XMC_GPIO_PORT0, 9
+#define P0_10 XMC_GPIO_PORT0, 10
+#define P0_11 XMC_GPIO_PORT0, 11
+#define P0_12 XMC_GPIO_PORT0, 12
+#define P0_13 XMC_GPIO_PORT0, 13
+#define P0_14 XMC_GPIO_PORT0, 14
+#define P0_15 XMC_GPIO_PORT0, 15
+#define P1_0  XMC_GPIO_PORT1, 0
+#define P1_1  XMC_GPIO_PORT1, 1
+#define P1_2  XMC_GPIO_PORT1, 2
+#define P1_3  XMC_GPIO_PORT1, 3
+#define P1_4  XMC_GPIO_PORT1, 4
+#define P1_5  XMC_GPIO_PORT1, 5
+#define P1_6  XMC_GPIO_PORT1, 6
+#define P2_0  XMC_GPIO_PORT2, 0
+#define P2_1  XMC_GPIO_PORT2, 1
+#define P2_2  XMC_GPIO_PORT2, 2
+#define P2_3  XMC_GPIO_PORT2, 3
+#define P2_4  XMC_GPIO_PORT2, 4
+#define P2_5  XMC_GPIO_PORT2, 5
+#define P2_6  XMC_GPIO_PORT2, 6
+#define P2_7  XMC_GPIO_PORT2, 7
+#define P2_8  XMC_GPIO_PORT2, 8
+#define P2_9  XMC_GPIO_PORT2, 9
+#define P2_10 XMC_GPIO_PORT2, 10
+#define P2_11 XMC_GPIO_PORT2, 11
+
+// Alternate functions that are used by the firmware (values as in xmc1_gpio_map.h)
+#define P0_7_AF_U0C1_DOUT0   XMC_GPIO_MODE_OUTPUT_ALT7
+#define P0_8_AF_U0C1_SCLKOUT XMC_GPIO_MODE_OUTPUT_ALT7
+#define P0_9_AF_U0C1_SELO0   XMC_GPIO_MODE_OUTPUT_ALT7
+#define P2_0_AF_U0C0_DOUT0   XMC_GPIO_MODE_OUTPUT_ALT6
+
+#endif
@@ -0,0 +1,74 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * xmc_spi.h: Fake XMC1 USIC SPI definitions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XMC_SPI_H
+#define XMC_SPI_H
+
+#include "xmc_device.h"
+#include "xmc_gpio.h"
+
+typedef struct {
+	uint8_t index;
+} XMC_USIC_CH_t;
+
+extern XMC_USIC_CH_t fake_usic_channel[2];
+
+#define XMC_SPI0_CH0  (&fake_usic_channel[0])
+#define XMC_SPI0_CH1  (&fake_usic_channel[1])
+#define XMC_UART0_CH0 (&fake_usic_channel[0])
+#define XMC_UART0_CH1 (&fake_usic_channel[1])
+#define USIC0_CH0     (&fake_usic_channel[0])
+#define USIC0_CH1     (&fake_usic_channel[1])
+
+typedef enum {
+	XMC_USIC_CH_FIFO_DISABLED     = 0,
+	XMC_USIC_CH_FIFO_SIZE_2WORDS  = 1,
+	XMC_USIC_CH_FIFO_SIZE_4WORDS  = 2,
+	XMC_USIC_CH_FIFO_SIZE_8WORDS  = 3,
+	XMC_USIC_CH_FIFO_SIZE_16WORDS = 4,
+	XMC_USIC_CH_FIFO_SIZE_32WORDS = 5,
+	XMC_USIC_CH_FIFO_SIZE_64WORDS = 6,
+} XMC_USIC_CH_FIFO_SIZE_t;
+
+typedef enum {
+	XMC_USIC_CH_INPUT_DX0 = 0,
+	XMC_USIC_CH_INPUT_DX1 = 1,
+	XMC_USIC_CH_INPUT_DX2 = 2,
+} XMC_USIC_CH_INPUT_t;
+
+typedef enum {
+	XMC_SPI_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_0_DELAY_ENABLED  = 0,
+	XMC_SPI_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_1_DELAY_ENABLED  = 1,
+	XMC_SPI_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_0_DELAY_DISABLED = 2,
+	XMC_SPI_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_1_DELAY_DISABLED = 3,
+} XMC_SPI_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_t;
+
+typedef enum {
+	XMC_SPI_CH_BRG_SHIFT_CLOCK_OUTPUT_SCLK = 0,
+	XMC_SPI_CH_BRG_SHIFT_CLOCK_OUTPUT_DX1  = 1,
+} XMC_SPI_CH_BRG_SHIFT_CLOCK_OUTPUT_t;
+
+typedef enum {
+	XMC_SPI_CH_SLAVE_SELECT_0 = 1,
+	XMC_SPI_CH_SLAVE_SELECT_1 = 2,
+} XMC_SPI_CH_SLAVE_SELECT_t;
+
+#endif
@@ -0,0 +1,64 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test.h: Minimal check macros for the host tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+extern int test_failures;
+
+#define CHECK(condition) do { \
+	if(!(condition)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		test_failures++; \
+	} \
+} while(0)
+
+#define CHECK_EQ(a, b) do { \
+	const long long check_a = (long long)(a); \
+	const long long check_b = (long long)(b); \
+	if(check_a != check_b) { \
+		fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, check_a, check_b); \
+		test_failures++; \
+	} \
+} while(0)
+
+// Abort the test case on the first failure (for loops over large input ranges)
+#define REQUIRE_EQ(a, b) do { \
+	const int check_failures = test_failures; \
+	CHECK_EQ(a, b); \
+	if(check_failures != test_failures) { \
+		return; \
+	} \
+} while(0)
+
+#define RUN_TEST(test) do { \
+	const int run_failures = test_failures; \
+	test(); \
+	printf("%s %s\n", (run_failures == test_failures) ? "PASS" : "FAIL", #test); \
+} while(0)
+
+#define TEST_MAIN_END() return (test_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE
+
+#endif
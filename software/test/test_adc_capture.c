@@ -0,0 +1,195 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_adc_capture.c: Tests of the raw ADC sample capture
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "bricklib2/utility/util_definitions.h"
+
+#include "communication.h"
+#include "evse.h"
+#include "ads1118.h"
+#include "iec61851.h"
+#include "adc_capture.h"
+
+#define DECIMATION_FACTOR 8 // ADS1118_CP_DECIMATION_FACTOR
+
+static ADCCaptureSample samples[ADC_CAPTURE_SAMPLES_NUM];
+
+static bool state_is_b(void) { return iec61851.state == IEC61851_STATE_B; }
+static bool state_is_c(void) { return iec61851.state == IEC61851_STATE_C; }
+
+static void api_set_cp_measurement_mode(const uint8_t mode) {
+	SetCPMeasurementMode message;
+	memset(&message, 0, sizeof(message));
+	message.mode = mode;
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_SET_CP_MEASUREMENT_MODE, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+}
+
+// Freeze the buffer right at the trigger
+static void api_arm_adc_capture(void) {
+	SetADCCaptureConfig config;
+	memset(&config, 0, sizeof(config));
+	config.trigger_on_state_change = false;
+	config.post_trigger_samples    = 0;
+	CHECK_EQ(evse_sim_message(&config, sizeof(config), FID_SET_ADC_CAPTURE_CONFIG, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+
+	ArmADCCapture message;
+	memset(&message, 0, sizeof(message));
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_ARM_ADC_CAPTURE, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+}
+
+// Triggers the capture and reads it out, returns the number of samples
+static uint8_t api_read_adc_capture(void) {
+	TriggerADCCapture trigger;
+	memset(&trigger, 0, sizeof(trigger));
+	CHECK_EQ(evse_sim_message(&trigger, sizeof(trigger), FID_TRIGGER_ADC_CAPTURE, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+
+	GetADCCaptureState state_message;
+	GetADCCaptureState_Response state;
+	memset(&state_message, 0, sizeof(state_message));
+	CHECK_EQ(evse_sim_message(&state_message, sizeof(state_message), FID_GET_ADC_CAPTURE_STATE, &state), HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE);
+	CHECK_EQ(state.state, ADC_CAPTURE_STATE_DONE);
+	CHECK_EQ(state.sample_size, sizeof(ADCCaptureSample));
+
+	uint8_t *data = (uint8_t*)samples;
+	for(uint16_t offset = 0; offset < state.sample_count*sizeof(ADCCaptureSample); offset += ADC_CAPTURE_CHUNK_SIZE) {
+		GetADCCaptureLowLevel message;
+		GetADCCaptureLowLevel_Response response;
+		memset(&message, 0, sizeof(message));
+		message.stream_chunk_offset = offset;
+		CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_GET_ADC_CAPTURE_LOW_LEVEL, &response), HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE);
+		CHECK_EQ(response.stream_length, state.sample_count*sizeof(ADCCaptureSample));
+		memcpy(&data[offset], response.stream_chunk_data, MIN(ADC_CAPTURE_CHUNK_SIZE, sizeof(samples) - offset));
+	}
+
+	return state.sample_count;
+}
+
+// Every CP and PP conversion is captured, also the ones that are ignored after the contactor is switched on
+static void test_capture_rejected_samples(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = 2700;
+	evse_sim.pp_resistance = 220;
+	evse_sim_boot_and_settle();
+	CHECK(evse_sim_run_until(state_is_b, 5000));
+	evse_sim_run_ms(1000);
+
+	api_arm_adc_capture();
+	const uint32_t sequence_start = ads1118.sample_sequence;
+	evse_sim.cp_resistance = 880;
+	CHECK(evse_sim_run_until(state_is_c, 5000));
+	evse_sim_run_ms(3000);
+	const uint32_t conversions = ads1118.sample_sequence - sequence_start;
+
+	const uint8_t count = api_read_adc_capture();
+	CHECK(conversions < ADC_CAPTURE_SAMPLES_NUM);
+	CHECK_EQ(count, conversions);
+
+	uint8_t rejected[2] = {0, 0};
+	bool accepted_after_rejected[2] = {false, false};
+	for(uint8_t i = 0; i < count; i++) {
+		const ADCCaptureSample *sample = &samples[i];
+		CHECK((sample->channel == ADS1118_CHANNEL_CP) || (sample->channel == ADS1118_CHANNEL_PP));
+		CHECK_EQ(sample->flags & ~ADC_CAPTURE_FLAG_REJECTED, 0);
+
+		const uint8_t channel = sample->channel == ADS1118_CHANNEL_CP ? 0 : 1;
+		if(sample->flags & ADC_CAPTURE_FLAG_REJECTED) {
+			CHECK_EQ(sample->resistance, 0);
+			CHECK(sample->adc_value != 0);
+			rejected[channel]++;
+		} else if(rejected[channel] > 0) {
+			CHECK(sample->resistance != 0);
+			accepted_after_rejected[channel] = true;
+		}
+	}
+
+	// The first conversion after the contactor change is only the reference of the settle detection
+	CHECK(rejected[0] >= 1);
+	CHECK(rejected[1] >= 1);
+	CHECK(accepted_after_rejected[0]);
+	CHECK(accepted_after_rejected[1]);
+}
+
+// In the high rate mode the conversions before the decimation are captured,
+// followed by the decimator output with the resulting resistance
+static void test_capture_decimator_input(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = 2700;
+	evse_sim.pp_resistance = 220;
+	evse_sim_boot_and_settle();
+	api_set_cp_measurement_mode(EVSE_CP_MEASUREMENT_MODE_HIGH_RATE);
+	CHECK(evse_sim_run_until(state_is_b, 5000));
+	evse_sim.cp_resistance = 880;
+	CHECK(evse_sim_run_until(state_is_c, 5000));
+	evse_sim_run_ms(1000);
+
+	api_arm_adc_capture();
+	evse_sim_run_ms(500);
+	const uint8_t count = api_read_adc_capture();
+	CHECK_EQ(count, ADC_CAPTURE_SAMPLES_NUM);
+
+	uint32_t sum         = 0;
+	uint8_t  inputs      = 0;
+	uint32_t outputs     = 0;
+	uint16_t input_min   = 0xFFFF;
+	uint16_t input_max   = 0;
+	bool     first_window = true;
+	for(uint8_t i = 0; i < count; i++) {
+		const ADCCaptureSample *sample = &samples[i];
+		if(sample->channel != ADS1118_CHANNEL_CP) {
+			continue;
+		}
+
+		if(sample->flags & ADC_CAPTURE_FLAG_DECIMATOR_INPUT) {
+			CHECK_EQ(sample->flags, ADC_CAPTURE_FLAG_DECIMATOR_INPUT);
+			CHECK_EQ(sample->resistance, 0);
+			sum += sample->adc_value;
+			inputs++;
+			input_min = MIN(input_min, sample->adc_value);
+			input_max = MAX(input_max, sample->adc_value);
+		} else {
+			CHECK_EQ(sample->flags, ADC_CAPTURE_FLAG_DECIMATED);
+			if(!first_window) {
+				CHECK_EQ(inputs, DECIMATION_FACTOR);
+				CHECK_EQ(sample->adc_value, sum/DECIMATION_FACTOR);
+				CHECK(sample->resistance != 0);
+				outputs++;
+			}
+			first_window = false;
+			sum    = 0;
+			inputs = 0;
+		}
+	}
+
+	CHECK(outputs > 5);
+
+	// The conversions are shorter than a CP PWM period, the raw values follow the PWM
+	CHECK(input_max - input_min > 1000);
+}
+
+int main(void) {
+	RUN_TEST(test_capture_rejected_samples);
+	RUN_TEST(test_capture_decimator_input);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,167 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_ads1118_cp_math.c: Division-free CP conversion against the integer math it replaces
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+
+#include "bricklib2/utility/util_definitions.h"
+
+#include "ads1118.h"
+
+// Calibration ratios (mul, div), the values are stored as int16 in the EEPROM
+static const int16_t calibrations[][2] = {
+	{1, 1}, {1003, 1000}, {9871, 10000}, {12345, -321}, {-7, 3}, {3, 32767}, {32767, -32768}, {-32768, 7},
+};
+
+// Continuously calibrated min voltage (max voltage around 12V, default diff voltage of -90mV)
+static const int16_t min_voltages[] = {-12090, -11500, 0};
+
+// Integer math of ads1118_cp_voltage_from_adc_value before the calibration context
+static int16_t reference_voltage(const uint16_t adc_value) {
+	const int16_t voltage = SCALE(adc_value, 6574, 31643, -12000, 12000);
+	return voltage;
+}
+
+static int16_t reference_voltage_calibrated(const int16_t voltage, const int16_t mul, const int16_t div) {
+	const int16_t voltage_calibrated = voltage * mul / div;
+	return voltage_calibrated;
+}
+
+static int16_t reference_high_voltage(const int16_t voltage_calibrated, const int16_t min_voltage, const uint16_t duty_cycle) {
+	const int16_t high_voltage = (voltage_calibrated - min_voltage)*1000/duty_cycle + min_voltage;
+	return high_voltage;
+}
+
+static void set_calibration(const int16_t mul, const int16_t div, const uint16_t duty_cycle) {
+	memset(&ads1118, 0, sizeof(ads1118));
+	ads1118.cp_cal_mul = mul;
+	ads1118.cp_cal_div = div;
+	ads1118_cp_cal_context_update(duty_cycle, (duty_cycle == 1000) ? 0 : 6000);
+}
+
+static uint32_t xorshift32(uint32_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+// Every divisor, numerators around the multiples of the divisor (where the
+// quotient changes), at the ends of the range and random numerators
+static void test_divide(void) {
+	uint32_t state = 0x12345678;
+	for(uint32_t divisor = 1; divisor <= 0xFFFF; divisor++) {
+		ADS1118Divider divider;
+		ads1118_divider_init(&divider, divisor);
+
+		const int32_t edges[] = {0, 1, -1, INT32_MAX, INT32_MIN, INT32_MIN + 1, INT32_MAX - (INT32_MAX % divisor)};
+		for(uint8_t i = 0; i < sizeof(edges)/sizeof(edges[0]); i++) {
+			REQUIRE_EQ(ads1118_divide(edges[i], &divider), edges[i]/(int32_t)divisor);
+		}
+
+		for(uint16_t i = 0; i < 256; i++) {
+			const int32_t multiple = (int32_t)(xorshift32(&state) % (INT32_MAX/divisor))*divisor;
+			for(int32_t offset = -1; offset <= 1; offset++) {
+				REQUIRE_EQ(ads1118_divide(multiple + offset, &divider), (multiple + offset)/(int32_t)divisor);
+				REQUIRE_EQ(ads1118_divide(-multiple - offset, &divider), (-multiple - offset)/(int32_t)divisor);
+			}
+
+			const int32_t numerator = xorshift32(&state);
+			REQUIRE_EQ(ads1118_divide(numerator, &divider), numerator/(int32_t)divisor);
+		}
+	}
+}
+
+// Whole 16 bit ADC range
+static void test_voltage_from_adc(void) {
+	for(uint32_t adc_value = 0; adc_value <= 0xFFFF; adc_value++) {
+		REQUIRE_EQ(ads1118_cp_voltage_from_adc(adc_value), reference_voltage(adc_value));
+	}
+}
+
+// Whole 16 bit voltage range for every calibration ratio
+static void test_voltage_calibrate(void) {
+	for(uint8_t i = 0; i < sizeof(calibrations)/sizeof(calibrations[0]); i++) {
+		set_calibration(calibrations[i][0], calibrations[i][1], 1000);
+		for(int32_t voltage = INT16_MIN; voltage <= INT16_MAX; voltage++) {
+			REQUIRE_EQ(ads1118_cp_voltage_calibrate(voltage), reference_voltage_calibrated(voltage, calibrations[i][0], calibrations[i][1]));
+		}
+	}
+}
+
+// Whole 16 bit calibrated voltage range for every duty cycle
+static void test_high_voltage(void) {
+	for(uint16_t duty_cycle = 1; duty_cycle <= 1000; duty_cycle++) {
+		set_calibration(1, 1, duty_cycle);
+		for(uint8_t i = 0; i < sizeof(min_voltages)/sizeof(min_voltages[0]); i++) {
+			for(int32_t voltage = INT16_MIN; voltage <= INT16_MAX; voltage++) {
+				REQUIRE_EQ(ads1118_cp_high_voltage(voltage, min_voltages[i]), reference_high_voltage(voltage, min_voltages[i], duty_cycle));
+			}
+		}
+	}
+}
+
+// Whole pipeline from the ADC value, as in ads1118_cp_voltage_from_adc_value
+static void test_pipeline(void) {
+	const uint16_t duty_cycles[] = {1, 100, 266, 533, 999, 1000};
+	for(uint8_t i = 0; i < sizeof(calibrations)/sizeof(calibrations[0]); i++) {
+		for(uint8_t j = 0; j < sizeof(duty_cycles)/sizeof(duty_cycles[0]); j++) {
+			set_calibration(calibrations[i][0], calibrations[i][1], duty_cycles[j]);
+			for(uint32_t adc_value = 0; adc_value <= 0xFFFF; adc_value++) {
+				const int16_t voltage            = ads1118_cp_voltage_from_adc(adc_value);
+				const int16_t voltage_calibrated = ads1118_cp_voltage_calibrate(voltage);
+				const int16_t high_voltage       = ads1118_cp_high_voltage(voltage_calibrated, -12090);
+
+				const int16_t reference_calibrated = reference_voltage_calibrated(reference_voltage(adc_value), calibrations[i][0], calibrations[i][1]);
+				REQUIRE_EQ(voltage_calibrated, reference_calibrated);
+				REQUIRE_EQ(high_voltage, reference_high_voltage(reference_calibrated, -12090, duty_cycles[j]));
+			}
+		}
+	}
+}
+
+// The 880 ohm calibration index stays in the table for every max current,
+// e.g. a current of 0 with a PWM override or during the calibration
+static void test_880ohm_index(void) {
+	const uint32_t currents[] = {0, 5999, 6000, 19000, 32000, 32001, 80000};
+	const int16_t  expected[] = {100, 100, 100, 106, 113, 113, 113};
+
+	for(uint8_t i = 0; i < sizeof(currents)/sizeof(currents[0]); i++) {
+		set_calibration(1, 1, 266);
+		for(uint8_t j = 0; j < ADS1118_880OHM_CAL_NUM; j++) {
+			ads1118.cp_cal_880ohm[j] = 100 + j;
+		}
+
+		ads1118_cp_cal_context_update(266, currents[i]);
+		CHECK_EQ(ads1118.cp_cal_context.resistance_offset, expected[i]);
+	}
+}
+
+int main(void) {
+	RUN_TEST(test_divide);
+	RUN_TEST(test_voltage_from_adc);
+	RUN_TEST(test_voltage_calibrate);
+	RUN_TEST(test_high_voltage);
+	RUN_TEST(test_pipeline);
+	RUN_TEST(test_880ohm_index);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,162 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_ads1118_cp_queue.c: Benchmark and equivalence test of the continuous calibration queue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "test.h"
+#include "evse_sim.h"
+#include "evse_log.h"
+
+#include "bricklib2/utility/util_definitions.h"
+
+#include "ads1118.h"
+
+#define BENCHMARK_RUNS 5
+
+// Reference: The queue as it was before it was kept sorted (memcpy and qsort per sample)
+static uint16_t reference_queue[ADS1118_CP_ADC_AVG_NUM];
+static uint8_t  reference_queue_pos;
+
+static void reference_queue_add(uint16_t value) {
+	reference_queue[reference_queue_pos] = value;
+	reference_queue_pos = (reference_queue_pos + 1) % ADS1118_CP_ADC_AVG_NUM;
+}
+
+static int reference_sort_compare(const void* a, const void* b) {
+	uint16_t int_a = *((uint16_t*)a);
+	uint16_t int_b = *((uint16_t*)b);
+
+	return (int_a > int_b) - (int_a < int_b);
+}
+
+static uint16_t reference_queue_get(void) {
+	uint16_t tmp[ADS1118_CP_ADC_AVG_NUM];
+	memcpy(tmp, reference_queue, sizeof(uint16_t)*ADS1118_CP_ADC_AVG_NUM);
+
+	qsort(tmp, ADS1118_CP_ADC_AVG_NUM, sizeof(uint16_t), reference_sort_compare);
+
+	return tmp[ADS1118_CP_ADC_AVG_NUM*2/3];
+}
+
+static uint32_t xorshift32(uint32_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+// CP ADC values of the high level for the resistances of the log with +-8 LSB noise,
+// so that the window holds distinct values, duplicates and jumps between the states
+static uint16_t *trace_from_log(const char *path, uint32_t *num) {
+	EVSELog log;
+	*num = 0;
+	CHECK(evse_log_read(path, &log));
+	if(log.num == 0) {
+		return NULL;
+	}
+
+	uint16_t *trace = malloc(log.num*sizeof(uint16_t));
+	uint32_t state  = 0x2342;
+	for(uint32_t i = 0; i < log.num; i++) {
+		evse_sim.cp_resistance = log.rows[i].cp_pe_resistance;
+		trace[i] = evse_sim_cp_mv_to_adc(evse_sim_cp_high_mv()) + (int32_t)(xorshift32(&state) % 17) - 8;
+	}
+	*num = log.num;
+
+	evse_log_free(&log);
+	return trace;
+}
+
+static void queue_init(const uint16_t value) {
+	for(uint8_t i = 0; i < ADS1118_CP_ADC_AVG_NUM; i++) {
+		ads1118.cp_adc_avg_queue[i]  = value;
+		ads1118.cp_adc_avg_sorted[i] = value;
+		reference_queue[i]           = value;
+	}
+	ads1118.cp_adc_avg_queue_pos = 0;
+	reference_queue_pos          = 0;
+}
+
+static uint64_t time_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static void check_trace(const char *path) {
+	uint32_t num;
+	uint16_t *trace = trace_from_log(path, &num);
+	if(trace == NULL) {
+		return;
+	}
+
+	// Bit-identical for every sample
+	queue_init(trace[0]);
+	uint32_t mismatches = 0;
+	for(uint32_t i = 0; i < num; i++) {
+		ads1118_cp_adc_avg_queue_add(trace[i]);
+		reference_queue_add(trace[i]);
+		mismatches += ads1118_cp_adc_avg_queue_get() != reference_queue_get();
+	}
+	CHECK_EQ(mismatches, 0);
+
+	// Best of BENCHMARK_RUNS runs of the whole trace
+	uint64_t sorted_ns    = UINT64_MAX;
+	uint64_t reference_ns = UINT64_MAX;
+	volatile uint32_t sink = 0;
+	for(uint8_t run = 0; run < BENCHMARK_RUNS; run++) {
+		queue_init(trace[0]);
+		uint64_t start = time_ns();
+		for(uint32_t i = 0; i < num; i++) {
+			ads1118_cp_adc_avg_queue_add(trace[i]);
+			sink += ads1118_cp_adc_avg_queue_get();
+		}
+		sorted_ns = MIN(sorted_ns, time_ns() - start);
+
+		start = time_ns();
+		for(uint32_t i = 0; i < num; i++) {
+			reference_queue_add(trace[i]);
+			sink += reference_queue_get();
+		}
+		reference_ns = MIN(reference_ns, time_ns() - start);
+	}
+
+	printf("  %s: %u samples, 0 mismatches, sorted queue %llu ns/sample, qsort %llu ns/sample\n", path, num,
+	       (unsigned long long)(sorted_ns/num), (unsigned long long)(reference_ns/num));
+	CHECK(sorted_ns < reference_ns);
+
+	free(trace);
+}
+
+static void test_log_erik(void) {
+	check_trace(EVSE_LOG_ERIK);
+}
+
+static void test_log_olaf(void) {
+	check_trace(EVSE_LOG_OLAF);
+}
+
+int main(void) {
+	RUN_TEST(test_log_erik);
+	RUN_TEST(test_log_olaf);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,146 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_ads1118_drdy.c: Tests of the interrupt driven ADS1118 read
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "bricklib2/utility/util_definitions.h"
+#include "hal/fake_ads1118.h"
+#include "configs/config_ads1118.h"
+
+#include "ads1118.h"
+#include "iec61851.h"
+
+#define MEASURE_TIME_MS 10000
+#define SPI_TRANSFER_NS (4*8*1000000000ULL/ADS1118_SPI_BAUDRATE) // 32 bit transfer with config readback
+
+typedef struct {
+	uint32_t samples;                // CP samples
+	uint64_t read_latency_max_ns;    // DRDY -> SPI read of the result (IRQ)
+	uint64_t process_latency_max_ns; // DRDY -> start of the main loop iteration that handled the result
+	uint64_t poll_latency_max_ns;    // DRDY -> first main loop iteration afterwards (polling)
+	uint64_t poll_latency_sum_ns;
+	uint32_t polls;                  // Conversions of all channels
+	uint64_t read_latency_sum_ns;
+} DRDYLatency;
+
+static bool state_is_b(void) { return iec61851.state == IEC61851_STATE_B; }
+static bool state_is_c(void) { return iec61851.state == IEC61851_STATE_C; }
+
+// Runs the main loop with the given iteration time and compares the latency
+// of the DRDY interrupt with the latency that polling DRDY in the main loop would have.
+// A CP sample is handled when it is added to cp_adc_sum.
+static void measure(const uint32_t loop_time_ns, DRDYLatency *latency) {
+	memset(latency, 0, sizeof(DRDYLatency));
+	evse_sim.loop_time_ns = loop_time_ns;
+
+	uint16_t sequence          = ads1118.cp_adc_sum_count;
+	uint32_t conversions       = fake_ads1118.conversion_count;
+	uint64_t poll_pending_ns   = 0;
+	const uint64_t end_ns      = fake_hal_get_time_ns() + MEASURE_TIME_MS*FAKE_HAL_NS_PER_MS;
+
+	while(fake_hal_get_time_ns() < end_ns) {
+		const uint64_t loop_start_ns = fake_hal_get_time_ns();
+		if(poll_pending_ns != 0) {
+			const uint64_t poll_latency = loop_start_ns - poll_pending_ns;
+			latency->poll_latency_max_ns  = MAX(latency->poll_latency_max_ns, poll_latency);
+			latency->poll_latency_sum_ns += poll_latency;
+			latency->polls++;
+			poll_pending_ns = 0;
+		}
+
+		evse_sim_loop();
+
+		if(fake_ads1118.conversion_count != conversions) {
+			conversions     = fake_ads1118.conversion_count;
+			poll_pending_ns = fake_ads1118.data_ready_ns;
+		}
+
+		if(ads1118.cp_adc_sum_count != sequence) {
+			sequence = ads1118.cp_adc_sum_count;
+			const uint64_t read_latency    = fake_ads1118.read_ns - fake_ads1118.read_data_ready_ns;
+			const uint64_t process_latency = loop_start_ns - fake_ads1118.read_data_ready_ns;
+			latency->samples++;
+			latency->read_latency_max_ns    = MAX(latency->read_latency_max_ns, read_latency);
+			latency->read_latency_sum_ns   += read_latency;
+			latency->process_latency_max_ns = MAX(latency->process_latency_max_ns, process_latency);
+		}
+	}
+}
+
+static void check_latency(const char *name) {
+	const uint32_t loop_times_ns[] = {100*1000, 1000*1000, 5000*1000};
+
+	printf("  %s\n", name);
+	for(uint8_t i = 0; i < sizeof(loop_times_ns)/sizeof(loop_times_ns[0]); i++) {
+		DRDYLatency latency;
+		measure(loop_times_ns[i], &latency);
+
+		printf("    loop %4u us: %3u samples, read max %3llu us (polling mean %4llu us, max %4llu us), processed max %4llu us\n",
+		       loop_times_ns[i]/1000, latency.samples,
+		       (unsigned long long)latency.read_latency_max_ns/1000,
+		       (unsigned long long)(latency.poll_latency_sum_ns/MAX(1, latency.polls))/1000,
+		       (unsigned long long)latency.poll_latency_max_ns/1000,
+		       (unsigned long long)latency.process_latency_max_ns/1000);
+
+		CHECK(latency.samples > MEASURE_TIME_MS/1000*4 - 2);
+
+		// The read starts in the IRQ, independent of the main loop
+		CHECK(latency.read_latency_max_ns <= 10*1000);
+
+		// Polling would start the read up to one main loop iteration later
+		CHECK(latency.read_latency_sum_ns/MAX(1, latency.samples) < latency.poll_latency_sum_ns/MAX(1, latency.polls));
+		CHECK(latency.poll_latency_max_ns > loop_times_ns[i]/2);
+
+		// The result is handled in the first main loop iteration after the transfer
+		CHECK(latency.process_latency_max_ns <= latency.read_latency_max_ns + SPI_TRANSFER_NS + loop_times_ns[i]);
+	}
+}
+
+// Normal loop: single-shot conversions with 8SPS, CP and PP alternating
+static void test_latency_normal_loop(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = 220;
+	evse_sim_boot_and_settle();
+	check_latency("normal loop (state A)");
+}
+
+// Fast loop: continuous conversions with 32SPS
+static void test_latency_fast_loop(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = 2700;
+	evse_sim.pp_resistance = 220;
+	evse_sim_boot_and_settle();
+	CHECK(evse_sim_run_until(state_is_b, 5000));
+	evse_sim.cp_resistance = 880;
+	CHECK(evse_sim_run_until(state_is_c, 5000));
+	evse_sim_run_ms(1000);
+	check_latency("fast loop (state C)");
+}
+
+int main(void) {
+	RUN_TEST(test_latency_normal_loop);
+	RUN_TEST(test_latency_fast_loop);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,217 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_ads1118_pwm_sync.c: PWM synchronous CP measurement against the simulated CP waveform
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "configs/config_evse.h"
+#include "bricklib2/utility/util_definitions.h"
+
+#include "communication.h"
+#include "evse.h"
+#include "iec61851.h"
+#include "ads1118.h"
+#include "configs/config_ads1118.h"
+
+// Oscillator error of the ADS1118 (the data rate is specified with +-10%)
+static const int32_t clock_errors_ppm[] = {-80000, -20000, 0, 20000, 80000};
+
+// 6A, 16A, 32A and ~51A
+static const uint16_t duty_cycles[] = {100, 266, 533, 850};
+
+static int api_set_cp_measurement_mode(const uint8_t mode) {
+	SetCPMeasurementMode message;
+	memset(&message, 0, sizeof(message));
+	message.mode = mode;
+	return evse_sim_message(&message, sizeof(message), FID_SET_CP_MEASUREMENT_MODE, NULL);
+}
+
+static int api_set_pwm_override(const uint16_t pwm_override) {
+	SetPWMOverride message;
+	memset(&message, 0, sizeof(message));
+	message.pwm_override = pwm_override;
+	return evse_sim_message(&message, sizeof(message), FID_SET_PWM_OVERRIDE, NULL);
+}
+
+static bool state_is_b(void) { return iec61851.state == IEC61851_STATE_B; }
+static bool state_is_c(void) { return iec61851.state == IEC61851_STATE_C; }
+
+static void boot_state_c(const uint8_t mode) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = 220;
+	evse_sim_boot_and_settle();
+	CHECK_EQ(api_set_cp_measurement_mode(mode), HANDLE_MESSAGE_RESPONSE_EMPTY);
+
+	evse_sim.cp_resistance = 2700;
+	CHECK(evse_sim_run_until(state_is_b, 5000));
+	evse_sim.cp_resistance = 880;
+	CHECK(evse_sim_run_until(state_is_c, 5000));
+	evse_sim_run_ms(1000);
+	CHECK(XMC_GPIO_GetInput(EVSE_RELAY_PIN));
+}
+
+// Run until the next CP sample is converted, returns its high voltage
+static int16_t next_cp_high_voltage(void) {
+	const uint16_t count = ads1118.cp_adc_sum_count;
+	while(ads1118.cp_adc_sum_count == count) {
+		evse_sim_loop();
+	}
+
+	return ads1118.cp_high_voltage;
+}
+
+// Largest deviation of the reconstructed high voltage from the high voltage
+// that is measured without PWM, over all duty cycles and samples
+static int32_t max_high_voltage_error(void) {
+	api_set_pwm_override(1000);
+	evse_sim_run_ms(500);
+	int32_t reference = 0;
+	for(uint8_t i = 0; i < 16; i++) {
+		reference += next_cp_high_voltage();
+	}
+	reference /= 16;
+
+	int32_t max_error = 0;
+	for(uint8_t i = 0; i < (sizeof(duty_cycles)/sizeof(duty_cycles[0])); i++) {
+		api_set_pwm_override(duty_cycles[i]);
+		evse_sim_run_ms(500);
+		for(uint8_t j = 0; j < 64; j++) {
+			// ABS and MAX evaluate their arguments twice
+			const int32_t error = next_cp_high_voltage() - reference;
+			max_error = MAX(max_error, ABS(error));
+		}
+	}
+
+	return max_error;
+}
+
+// The window of a PWM synchronous conversion is measured, the reconstruction
+// of the high plateau is exact independent of duty cycle and oscillator error
+static void test_high_voltage_pwm_synchronous(void) {
+	for(uint8_t i = 0; i < (sizeof(clock_errors_ppm)/sizeof(clock_errors_ppm[0])); i++) {
+		boot_state_c(EVSE_CP_MEASUREMENT_MODE_PWM_SYNCHRONOUS);
+		fake_ads1118.clock_error_ppm = clock_errors_ppm[i];
+
+		const int32_t error = max_high_voltage_error();
+		printf("  clock error %6d ppm: max error pwm synchronous %4d mV\n", clock_errors_ppm[i], error);
+		CHECK(error <= 20);
+	}
+}
+
+// Free running the integration window is assumed to be a whole number of PWM periods,
+// the error depends on the phase of the window and the oscillator of the ADS1118
+static void test_high_voltage_free_running(void) {
+	int32_t max_error = 0;
+	for(uint8_t i = 0; i < (sizeof(clock_errors_ppm)/sizeof(clock_errors_ppm[0])); i++) {
+		boot_state_c(EVSE_CP_MEASUREMENT_MODE_FREE_RUNNING);
+		fake_ads1118.clock_error_ppm = clock_errors_ppm[i];
+
+		const int32_t error = max_high_voltage_error();
+		printf("  clock error %6d ppm: max error free running      %4d mV\n", clock_errors_ppm[i], error);
+		max_error = MAX(max_error, error);
+	}
+
+	CHECK(max_error > 100);
+}
+
+// Conversions are started by the CP PWM period match and the IRQ is only
+// active while a conversion is pending or running
+static void test_conversion_start(void) {
+	boot_state_c(EVSE_CP_MEASUREMENT_MODE_PWM_SYNCHRONOUS);
+
+	uint32_t synchronous = 0;
+	for(uint16_t i = 0; i < 200; i++) {
+		const uint32_t conversions = fake_ads1118.conversion_count;
+		while(fake_ads1118.conversion_count == conversions) {
+			evse_sim_loop();
+		}
+
+		// Start of the conversion is the end of the 16 bit config transfer after the period match
+		const uint32_t timer = fake_ccu4_timer_at(EVSE_CP_PWM_SLICE, fake_ads1118.conversion_start_ns);
+		if(ads1118.schedule_current->configs[ADS1118_CHANNEL_CP] == (fake_ads1118.conversion_config | ADS1118_CONFIG_SINGLE_SHOT)) {
+			CHECK_EQ(timer, 16*(EVSE_CP_PWM_PERIOD*1000/ADS1118_SPI_BAUDRATE));
+			synchronous++;
+		}
+	}
+
+	// PP is interleaved with a low rate
+	CHECK(synchronous > 180);
+	CHECK_EQ(ads1118.config_error_count, 0);
+	CHECK_EQ(ads1118.spi_error_count, 0);
+
+	// Normal loop does not use the PWM period match
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim_run_ms(2000);
+	CHECK(!XMC_GPIO_GetInput(EVSE_RELAY_PIN));
+	const uint32_t irq_count = fake_hal.irq_count[ADS1118_PWM_SYNC_IRQ];
+	evse_sim_run_ms(2000);
+	CHECK_EQ(fake_hal.irq_count[ADS1118_PWM_SYNC_IRQ], irq_count);
+}
+
+// Longest time between two CP samples in ms
+static uint32_t max_cp_sample_gap_ms(const uint32_t ms) {
+	const uint64_t end = fake_hal_get_time_ns() + ms*FAKE_HAL_NS_PER_MS;
+	uint64_t last_sample = fake_hal_get_time_ns();
+	uint64_t max_gap     = 0;
+	uint16_t count       = ads1118.cp_adc_sum_count;
+	while(fake_hal_get_time_ns() < end) {
+		evse_sim_loop();
+		if(ads1118.cp_adc_sum_count != count) {
+			count       = ads1118.cp_adc_sum_count;
+			max_gap     = MAX(max_gap, fake_hal_get_time_ns() - last_sample);
+			last_sample = fake_hal_get_time_ns();
+		}
+	}
+
+	return MAX(max_gap, end - last_sample)/FAKE_HAL_NS_PER_MS;
+}
+
+// A config readback mismatch is answered with a second config write,
+// the conversions continue without running into the DRDY timeout
+static void test_config_error_recovery(void) {
+	boot_state_c(EVSE_CP_MEASUREMENT_MODE_PWM_SYNCHRONOUS);
+
+	// Two ~32ms conversions if PP is interleaved, the DRDY timeout would add 200ms
+	CHECK(max_cp_sample_gap_ms(1000) < 70);
+
+	// Second write succeeds
+	fake_ads1118.inject_config_errors = 1;
+	CHECK(max_cp_sample_gap_ms(1000) < 70);
+	CHECK_EQ(ads1118.config_error_count, 1);
+
+	// Second write fails too, the result is ignored but the conversions continue
+	fake_ads1118.inject_config_errors = 2;
+	CHECK(max_cp_sample_gap_ms(1000) < 70);
+	CHECK_EQ(ads1118.config_error_count, 2);
+	CHECK_EQ(ads1118.spi_error_count, 0);
+	CHECK(XMC_GPIO_GetInput(EVSE_RELAY_PIN));
+}
+
+int main(void) {
+	RUN_TEST(test_high_voltage_pwm_synchronous);
+	RUN_TEST(test_high_voltage_free_running);
+	RUN_TEST(test_conversion_start);
+	RUN_TEST(test_config_error_recovery);
+	TEST_MAIN_END();
+}
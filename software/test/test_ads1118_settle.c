@@ -0,0 +1,182 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_ads1118_settle.c: Blind time of the settle detection on the recorded logs
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "hal/fake_ads1118.h"
+
+#include "test.h"
+#include "evse_sim.h"
+#include "evse_log.h"
+
+#include "evse.h"
+#include "ads1118.h"
+
+// The log has a sample every 100ms, the main loop is run with 5ms per iteration
+#define SETTLE_LOOP_TIME_NS (5*1000*1000)
+
+// Blind time after contactor and PWM changes of one ADC channel. The blind time
+// of the fixed blanking is the time until the conversion that would have been
+// accepted by it: saved_samples conversions after the one the settle detection accepted.
+typedef struct {
+	const ADS1118Settle *settle;
+	uint32_t conversions;   // Conversions of this channel
+	uint64_t conversion_ns; // End of the last conversion
+	bool     settling;
+	uint32_t saved_samples; // settle->saved_samples at the start of the window
+	uint32_t windows;
+	uint64_t blind_ms;      // With settle detection
+	uint64_t saved_ns;      // Additional blind time with the fixed blanking
+
+	uint32_t pending_conversion[4];
+	uint64_t pending_ns[4];
+	uint8_t  pending_num;
+} SettleChannel;
+
+static SettleChannel settle_cp;
+static SettleChannel settle_pp;
+static FakeADS1118Input settle_input;
+
+static void settle_channel_conversion(SettleChannel *channel, const uint64_t end_ns) {
+	channel->conversions++;
+	channel->conversion_ns = end_ns;
+
+	for(uint8_t i = 0; i < channel->pending_num; i++) {
+		if(channel->pending_conversion[i] == channel->conversions) {
+			channel->saved_ns += end_ns - channel->pending_ns[i];
+			channel->pending_conversion[i] = channel->pending_conversion[--channel->pending_num];
+			channel->pending_ns[i]         = channel->pending_ns[channel->pending_num];
+			i--;
+		}
+	}
+}
+
+static uint16_t settle_ads1118_input(const uint16_t config, const uint64_t start_ns, const uint64_t end_ns) {
+	const uint16_t mux = config & (0b111 << 12);
+	if(!(config & ADS1118_CONFIG_TEMPERATURE_MODE)) {
+		if(mux == ADS1118_CONFIG_INP_IS_IN2_AND_INN_IS_IN3) {
+			settle_channel_conversion(&settle_pp, end_ns);
+		} else if(mux == (ads1118.is_v15 ? ADS1118_CONFIG_INP_IS_IN1_AND_INN_IS_GND : ADS1118_CONFIG_INP_IS_IN0_AND_INN_IS_IN3)) {
+			settle_channel_conversion(&settle_cp, end_ns);
+		}
+	}
+
+	return settle_input(config, start_ns, end_ns);
+}
+
+// Called after every main loop iteration, a window ends with the first accepted sample
+static void settle_channel_update(SettleChannel *channel) {
+	const bool settling = channel->settle->start_time != 0;
+	if(settling && !channel->settling) {
+		channel->saved_samples = channel->settle->saved_samples;
+	} else if(!settling && channel->settling) {
+		channel->windows++;
+		channel->blind_ms += channel->settle->last_blind_time;
+
+		const uint32_t saved = channel->settle->saved_samples - channel->saved_samples;
+		if((saved > 0) && (channel->pending_num < sizeof(channel->pending_ns)/sizeof(channel->pending_ns[0]))) {
+			channel->pending_conversion[channel->pending_num] = channel->conversions + saved;
+			channel->pending_ns[channel->pending_num]         = channel->conversion_ns;
+			channel->pending_num++;
+		}
+	}
+	channel->settling = settling;
+}
+
+// The resistances of the log are applied to the simulated ADC inputs, so the state machine
+// switches the contactor and the CP PWM itself. The simulated ADC has no switching transients,
+// the CP samples only vary with the phase of the conversion relative to the CP PWM.
+static void replay_log_blind_time(const char *path) {
+	EVSELog log;
+	CHECK(evse_log_read(path, &log));
+	if(log.num == 0) {
+		return;
+	}
+
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = log.rows[0].pp_pe_resistance;
+	evse_sim.loop_time_ns  = SETTLE_LOOP_TIME_NS;
+	evse_sim_boot_and_settle();
+
+	memset(&settle_cp, 0, sizeof(SettleChannel));
+	memset(&settle_pp, 0, sizeof(SettleChannel));
+	settle_cp.settle   = &ads1118.cp_settle;
+	settle_pp.settle   = &ads1118.pp_settle;
+	settle_input       = fake_ads1118.input;
+	fake_ads1118.input = settle_ads1118_input;
+
+	uint32_t contactor_changes = 0;
+	bool contactor = evse_get_contactor();
+
+	const uint64_t start_ns = fake_hal_get_time_ns();
+	for(uint32_t i = 0; i < log.num; i++) {
+		evse_sim.cp_resistance = log.rows[i].cp_pe_resistance;
+		evse_sim.pp_resistance = log.rows[i].pp_pe_resistance;
+
+		const uint64_t next_ns = start_ns + ((i + 1 < log.num) ? (log.rows[i + 1].time - log.rows[0].time)*100*FAKE_HAL_NS_PER_MS : (log.rows[i].time - log.rows[0].time + 50)*100*FAKE_HAL_NS_PER_MS);
+		while(fake_hal_get_time_ns() < next_ns) {
+			evse_sim_loop();
+			settle_channel_update(&settle_cp);
+			settle_channel_update(&settle_pp);
+
+			if(evse_get_contactor() != contactor) {
+				contactor = !contactor;
+				contactor_changes++;
+			}
+		}
+	}
+
+	const uint64_t cp_saved_ms = settle_cp.saved_ns/FAKE_HAL_NS_PER_MS;
+	const uint64_t pp_saved_ms = settle_pp.saved_ns/FAKE_HAL_NS_PER_MS;
+	printf("%s: %u contactor changes\n", path, contactor_changes);
+	printf("  CP: %u blind windows, %llu ms blind, %llu ms with fixed blanking (%llu ms saved)\n",
+	       settle_cp.windows, (unsigned long long)settle_cp.blind_ms, (unsigned long long)(settle_cp.blind_ms + cp_saved_ms), (unsigned long long)cp_saved_ms);
+	printf("  PP: %u blind windows, %llu ms blind, %llu ms with fixed blanking (%llu ms saved)\n",
+	       settle_pp.windows, (unsigned long long)settle_pp.blind_ms, (unsigned long long)(settle_pp.blind_ms + pp_saved_ms), (unsigned long long)pp_saved_ms);
+
+	// A change during a blind window extends it (B is passed quickly in the olaf log)
+	CHECK(contactor_changes > 0);
+	CHECK(settle_cp.windows > 0);
+	CHECK(settle_pp.windows > 0);
+	CHECK(settle_cp.pending_num == 0);
+	CHECK(settle_pp.pending_num == 0);
+
+	// Every contactor change saves at least one sample on both channels
+	CHECK(settle_cp.saved_ns > 0);
+	CHECK(settle_pp.saved_ns > 0);
+
+	evse_log_free(&log);
+}
+
+static void test_settle_blind_time_log_erik(void) {
+	replay_log_blind_time(EVSE_LOG_ERIK);
+}
+
+static void test_settle_blind_time_log_olaf(void) {
+	replay_log_blind_time(EVSE_LOG_OLAF);
+}
+
+int main(void) {
+	RUN_TEST(test_settle_blind_time_log_erik);
+	RUN_TEST(test_settle_blind_time_log_olaf);
+	TEST_MAIN_END();
+}
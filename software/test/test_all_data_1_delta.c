@@ -0,0 +1,117 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_all_data_1_delta.c: Tests of get_all_data_1_delta
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "communication.h"
+#include "evse.h"
+
+#define ALL_GROUPS               ((1 << ALL_DATA_1_GROUP_NUM) - 1)
+#define GROUP_HARDWARE_CONFIG    (1 << 1)
+#define GROUP_BOOST_MODE         (1 << 10)
+
+static GetAllData1Delta_Response api_get_all_data_1_delta(const uint32_t last_epoch, const uint32_t last_generation) {
+	GetAllData1Delta message;
+	GetAllData1Delta_Response response;
+	memset(&message, 0, sizeof(message));
+	memset(&response, 0, sizeof(response));
+	message.last_epoch      = last_epoch;
+	message.last_generation = last_generation;
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_GET_ALL_DATA_1_DELTA, &response), HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE);
+	return response;
+}
+
+static void api_set_boost_mode(const bool boost_mode_enabled) {
+	SetBoostMode message;
+	memset(&message, 0, sizeof(message));
+	message.boost_mode_enabled = boost_mode_enabled;
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_SET_BOOST_MODE, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+}
+
+static void boot(const uint32_t settle_ms) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim_boot_and_settle();
+	evse_sim_run_ms(settle_ms);
+}
+
+static void test_delta(void) {
+	boot(0);
+
+	GetAllData1Delta_Response response = api_get_all_data_1_delta(0, 0);
+	CHECK(response.epoch != 0);
+	CHECK(response.generation != 0);
+	CHECK_EQ(response.changed_groups, ALL_GROUPS);
+
+	// Only the groups that changed since the last query, never the static ones
+	const uint32_t epoch = response.epoch;
+	uint32_t generation  = response.generation;
+	api_set_boost_mode(!evse.boost_mode_enabled);
+	response = api_get_all_data_1_delta(epoch, generation);
+	CHECK_EQ(response.epoch, epoch);
+	CHECK(response.generation > generation);
+	CHECK(response.changed_groups & GROUP_BOOST_MODE);
+	CHECK(!(response.changed_groups & GROUP_HARDWARE_CONFIG));
+
+	// Without a change in between the generation stays the same
+	generation = response.generation;
+	response   = api_get_all_data_1_delta(epoch, generation);
+	CHECK(!(response.changed_groups & GROUP_BOOST_MODE));
+
+	// A change that is reverted before the next query is not reported (see get_all_data_1_delta)
+	generation = response.generation;
+	api_set_boost_mode(!evse.boost_mode_enabled);
+	api_set_boost_mode(!evse.boost_mode_enabled);
+	response   = api_get_all_data_1_delta(epoch, generation);
+	CHECK(!(response.changed_groups & GROUP_BOOST_MODE));
+}
+
+// After a reset the generations start again. A host that polled the previous boot must get
+// all groups, even if the new generation already reached the one it remembers.
+static void test_delta_after_reset(void) {
+	boot(0);
+
+	GetAllData1Delta_Response response = api_get_all_data_1_delta(0, 0);
+	const uint32_t epoch = response.epoch;
+	uint32_t generation  = response.generation;
+
+	boot(123);
+	response = api_get_all_data_1_delta(0, 0);
+	for(uint8_t i = 0; (i < 10) && (response.generation < generation); i++) {
+		api_set_boost_mode(!evse.boost_mode_enabled);
+		response = api_get_all_data_1_delta(response.epoch, response.generation);
+	}
+	CHECK(response.generation >= generation);
+
+	response = api_get_all_data_1_delta(epoch, generation);
+	CHECK(response.epoch != 0);
+	CHECK(response.epoch != epoch);
+	CHECK_EQ(response.changed_groups, ALL_GROUPS);
+}
+
+int main(void) {
+	RUN_TEST(test_delta);
+	RUN_TEST(test_delta_after_reset);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,132 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_charging_slot_limit.c: Tests of the cached charging current limit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "charging_slot.h"
+#include "button.h"
+
+#define RANDOM_OPERATIONS 2000000
+
+static const uint16_t test_currents[] = {0, 6000, 6000, 10000, 16000, 20000, 32000, 32000};
+
+static uint32_t xorshift32(uint32_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+// The full scan that charging_slot_get_max_current did before the limit was cached
+static void reference_limit(uint16_t *max_current, uint8_t *limiting_slot) {
+	*max_current   = 0;
+	*limiting_slot = CHARGING_SLOT_NONE;
+	for(uint8_t i = 0; i < CHARGING_SLOT_NUM; i++) {
+		if(charging_slot.active[i] && ((*limiting_slot == CHARGING_SLOT_NONE) || (charging_slot.max_current[i] < *max_current))) {
+			*max_current   = charging_slot.max_current[i];
+			*limiting_slot = i;
+		}
+	}
+}
+
+static bool check_limit(void) {
+	uint16_t max_current;
+	uint8_t limiting_slot;
+	reference_limit(&max_current, &limiting_slot);
+
+	CHECK_EQ(charging_slot_get_max_current(), max_current);
+	CHECK_EQ(charging_slot_get_limiting_slot(), limiting_slot);
+	return (charging_slot_get_max_current() == max_current) && (charging_slot_get_limiting_slot() == limiting_slot);
+}
+
+static void test_no_active_slot(void) {
+	fake_hal_eeprom_erase();
+	evse_sim_boot();
+
+	for(uint8_t i = 0; i < CHARGING_SLOT_NUM; i++) {
+		charging_slot_set_active(i, false);
+	}
+	CHECK_EQ(charging_slot_get_max_current(), 0);
+	CHECK_EQ(charging_slot_get_limiting_slot(), CHARGING_SLOT_NONE);
+
+	charging_slot_set_max_current(7, 12000);
+	charging_slot_set_active(7, true);
+	CHECK_EQ(charging_slot_get_max_current(), 12000);
+	CHECK_EQ(charging_slot_get_limiting_slot(), 7);
+
+	// Lowest index wins a tie
+	charging_slot_set_max_current(5, 12000);
+	charging_slot_set_active(5, true);
+	CHECK_EQ(charging_slot_get_limiting_slot(), 5);
+	charging_slot_set_active(5, false);
+	CHECK_EQ(charging_slot_get_limiting_slot(), 7);
+	check_limit();
+}
+
+// Random changes through every function that changes a slot, after each
+// one the cached limit has to match the full scan.
+static void test_random_operations_against_full_scan(void) {
+	fake_hal_eeprom_erase();
+	evse_sim_boot();
+
+	uint32_t state = 0x5EED1234;
+	for(uint32_t i = 0; i < RANDOM_OPERATIONS; i++) {
+		const uint8_t slot = xorshift32(&state) % CHARGING_SLOT_NUM;
+		const uint8_t operation = xorshift32(&state) % 16;
+		if(operation < 7) {
+			charging_slot_set_max_current(slot, test_currents[xorshift32(&state) % (sizeof(test_currents)/sizeof(test_currents[0]))]);
+		} else if(operation < 11) {
+			charging_slot_set_active(slot, xorshift32(&state) % 4 != 0);
+		} else if(operation == 11) {
+			charging_slot.clear_on_disconnect[slot] = xorshift32(&state) & 1;
+		} else if(operation == 12) {
+			charging_slot_handle_disconnect();
+		} else if(operation == 13) {
+			button.was_pressed = xorshift32(&state) & 1;
+			if(xorshift32(&state) & 1) {
+				charging_slot_start_charging_by_button();
+			} else {
+				charging_slot_stop_charging_by_button();
+			}
+		} else if(operation == 14) {
+			charging_slot_tick();
+		} else if(xorshift32(&state) % 1024 == 0) {
+			// Rare, like a reboot
+			charging_slot_init();
+		} else {
+			charging_slot_set_max_current(slot, xorshift32(&state) % 32001);
+		}
+
+		if(!check_limit()) {
+			fprintf(stderr, "mismatch after %u operations\n", i + 1);
+			break;
+		}
+	}
+}
+
+int main(void) {
+	RUN_TEST(test_no_active_slot);
+	RUN_TEST(test_random_operations_against_full_scan);
+	TEST_MAIN_END();
+}
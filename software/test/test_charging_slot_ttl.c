@@ -0,0 +1,122 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_charging_slot_ttl.c: Tests of the charging slot time-to-live
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "configs/config_evse.h"
+
+#include "communication.h"
+#include "charging_slot.h"
+#include "button.h"
+
+static int api_set_charging_slot(const uint8_t slot, const uint16_t max_current, const bool active) {
+	SetChargingSlot message;
+	memset(&message, 0, sizeof(message));
+	message.slot        = slot;
+	message.max_current = max_current;
+	message.active      = active;
+	return evse_sim_message(&message, sizeof(message), FID_SET_CHARGING_SLOT, NULL);
+}
+
+static int api_set_charging_slot_ttl(const uint8_t slot, const uint32_t ttl, const uint16_t expired_current) {
+	SetChargingSlotTTL message;
+	memset(&message, 0, sizeof(message));
+	message.slot            = slot;
+	message.ttl             = ttl;
+	message.expired_current = expired_current;
+	return evse_sim_message(&message, sizeof(message), FID_SET_CHARGING_SLOT_TTL, NULL);
+}
+
+static void boot(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = 220;
+	evse_sim_boot_and_settle();
+}
+
+static void test_ttl_rejected_for_cable_slots(void) {
+	boot();
+
+	CHECK_EQ(api_set_charging_slot_ttl(CHARGING_SLOT_INCOMING_CABLE, 1000, 0), HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER);
+	CHECK_EQ(api_set_charging_slot_ttl(CHARGING_SLOT_OUTGOING_CABLE, 1000, 0), HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER);
+	CHECK_EQ(charging_slot.ttl[CHARGING_SLOT_INCOMING_CABLE], 0);
+	CHECK_EQ(charging_slot.ttl[CHARGING_SLOT_OUTGOING_CABLE], 0);
+	CHECK_EQ(charging_slot.ttl_pending, 0);
+}
+
+static void test_ttl_expiry(void) {
+	boot();
+
+	CHECK_EQ(api_set_charging_slot(5, 10000, true), HANDLE_MESSAGE_RESPONSE_EMPTY);
+	CHECK_EQ(api_set_charging_slot_ttl(5, 1000, 0), HANDLE_MESSAGE_RESPONSE_EMPTY);
+
+	// Every write refreshes the TTL
+	for(uint8_t i = 0; i < 5; i++) {
+		evse_sim_run_ms(800);
+		CHECK_EQ(api_set_charging_slot(5, 10000, true), HANDLE_MESSAGE_RESPONSE_EMPTY);
+	}
+	CHECK_EQ(charging_slot.max_current[5], 10000);
+
+	evse_sim_run_ms(1100);
+	CHECK_EQ(charging_slot.max_current[5], 0);
+	CHECK_EQ(charging_slot_get_max_current(), 0);
+}
+
+static void test_ttl_expiry_only_lowers_current(void) {
+	boot();
+
+	CHECK_EQ(api_set_charging_slot(5, 10000, true), HANDLE_MESSAGE_RESPONSE_EMPTY);
+	CHECK_EQ(api_set_charging_slot_ttl(5, 1000, 16000), HANDLE_MESSAGE_RESPONSE_EMPTY);
+	evse_sim_run_ms(1100);
+	CHECK_EQ(charging_slot.max_current[5], 10000);
+
+	CHECK_EQ(api_set_charging_slot_ttl(5, 1000, 6000), HANDLE_MESSAGE_RESPONSE_EMPTY);
+	evse_sim_run_ms(1100);
+	CHECK_EQ(charging_slot.max_current[5], 6000);
+}
+
+static void test_ttl_button_slot_with_key_switch_off(void) {
+	boot();
+
+	CHECK_EQ(api_set_charging_slot(CHARGING_SLOT_BUTTON, 32000, true), HANDLE_MESSAGE_RESPONSE_EMPTY);
+	CHECK_EQ(api_set_charging_slot_ttl(CHARGING_SLOT_BUTTON, 1000, 16000), HANDLE_MESSAGE_RESPONSE_EMPTY);
+
+	// Key switch off
+	fake_gpio_set_input(EVSE_INPUT_GP_PIN, FAKE_GPIO_HIGH);
+	evse_sim_run_ms(500);
+	CHECK_EQ(button.state, BUTTON_STATE_PRESSED);
+	CHECK_EQ(charging_slot.max_current[CHARGING_SLOT_BUTTON], 0);
+
+	evse_sim_run_ms(1000);
+	CHECK_EQ(charging_slot.ttl_pending, 0);
+	CHECK_EQ(charging_slot.max_current[CHARGING_SLOT_BUTTON], 0);
+}
+
+int main(void) {
+	RUN_TEST(test_ttl_rejected_for_cable_slots);
+	RUN_TEST(test_ttl_expiry);
+	RUN_TEST(test_ttl_expiry_only_lowers_current);
+	RUN_TEST(test_ttl_button_slot_with_key_switch_off);
+	TEST_MAIN_END();
+}
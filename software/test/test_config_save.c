@@ -0,0 +1,208 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_config_save.c: Tests of the deferred config save
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <setjmp.h>
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+
+#include "communication.h"
+#include "evse.h"
+#include "charging_slot.h"
+
+#define STRESS_OPERATIONS 2000
+
+typedef struct {
+	uint16_t max_current[CHARGING_SLOT_DEFAULT_NUM];
+	bool     active[CHARGING_SLOT_DEFAULT_NUM];
+	bool     clear_on_disconnect[CHARGING_SLOT_DEFAULT_NUM];
+	bool     boost_mode_enabled;
+} ConfigModel;
+
+static uint32_t xorshift32(uint32_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static void api_set_charging_slot_default(const uint8_t slot, const uint16_t max_current, const bool active, const bool clear_on_disconnect) {
+	SetChargingSlotDefault message;
+	memset(&message, 0, sizeof(message));
+	message.slot                = slot;
+	message.max_current         = max_current;
+	message.active              = active;
+	message.clear_on_disconnect = clear_on_disconnect;
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_SET_CHARGING_SLOT_DEFAULT, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+}
+
+static void api_set_boost_mode(const bool boost_mode_enabled) {
+	SetBoostMode message;
+	memset(&message, 0, sizeof(message));
+	message.boost_mode_enabled = boost_mode_enabled;
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_SET_BOOST_MODE, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+}
+
+static void api_factory_reset(void) {
+	FactoryReset message;
+	memset(&message, 0, sizeof(message));
+	message.password = 0x2342FACD;
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_FACTORY_RESET, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+}
+
+static void check_config(const ConfigModel *model) {
+	for(uint8_t i = 0; i < CHARGING_SLOT_DEFAULT_NUM; i++) {
+		CHECK_EQ(charging_slot.max_current_default[i], model->max_current[i]);
+		CHECK_EQ(charging_slot.active_default[i], model->active[i]);
+		CHECK_EQ(charging_slot.clear_on_disconnect_default[i], model->clear_on_disconnect[i]);
+	}
+	CHECK_EQ(evse.boost_mode_enabled, model->boost_mode_enabled);
+}
+
+// Random config changes in bursts with random pauses. Every change has to survive
+// a reboot, the number of page erases is bounded by the number of save windows
+// instead of the number of API calls.
+static void test_erase_count_stress(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim_boot_and_settle();
+
+	ConfigModel model;
+	memset(&model, 0, sizeof(model));
+	for(uint8_t i = 0; i < CHARGING_SLOT_DEFAULT_NUM; i++) {
+		model.max_current[i]         = charging_slot.max_current_default[i];
+		model.active[i]              = charging_slot.active_default[i];
+		model.clear_on_disconnect[i] = charging_slot.clear_on_disconnect_default[i];
+	}
+	model.boost_mode_enabled = evse.boost_mode_enabled;
+
+	const uint32_t writes_start = fake_hal.eeprom_write_count[EVSE_CONFIG_PAGE];
+	const uint32_t time_start   = system_timer_get_ms();
+	uint32_t state = 0xC0FFEE;
+
+	for(uint32_t i = 0; i < STRESS_OPERATIONS; i++) {
+		if(xorshift32(&state) % 8 == 0) {
+			model.boost_mode_enabled = xorshift32(&state) & 1;
+			api_set_boost_mode(model.boost_mode_enabled);
+		} else {
+			const uint8_t slot = xorshift32(&state) % CHARGING_SLOT_DEFAULT_NUM;
+			model.max_current[slot]         = (xorshift32(&state) % 4 == 0) ? 0 : 6000 + xorshift32(&state) % 26001;
+			model.active[slot]              = xorshift32(&state) & 1;
+			model.clear_on_disconnect[slot] = xorshift32(&state) & 1;
+			api_set_charging_slot_default(slot + 2, model.max_current[slot], model.active[slot], model.clear_on_disconnect[slot]);
+		}
+
+		// Mostly bursts, sometimes a pause that is longer than the save delay
+		const uint32_t pause = xorshift32(&state) % 16 == 0 ? (xorshift32(&state) % (3*EVSE_CONFIG_SAVE_DELAY)) : (xorshift32(&state) % 20);
+		evse_sim_run_ms(pause);
+	}
+	evse_sim_run_ms(EVSE_CONFIG_SAVE_DELAY + 100);
+	CHECK(!evse.config_save_pending);
+
+	const uint32_t writes   = fake_hal.eeprom_write_count[EVSE_CONFIG_PAGE] - writes_start;
+	const uint32_t duration = system_timer_get_ms() - time_start;
+	printf("%d config changes in %d ms: %d page erases\n", STRESS_OPERATIONS, duration, writes);
+
+	// At most one write per save window, far less than one per change
+	CHECK(writes > 0);
+	CHECK(writes <= duration/EVSE_CONFIG_SAVE_DELAY + 1);
+	CHECK(writes < STRESS_OPERATIONS/10);
+
+	evse_sim_boot();
+	check_config(&model);
+
+	// Setting the same values again does not erase the page
+	const uint32_t writes_same = fake_hal.eeprom_write_count[EVSE_CONFIG_PAGE];
+	for(uint8_t i = 0; i < CHARGING_SLOT_DEFAULT_NUM; i++) {
+		api_set_charging_slot_default(i + 2, model.max_current[i], model.active[i], model.clear_on_disconnect[i]);
+		evse_sim_run_ms(EVSE_CONFIG_SAVE_DELAY + 100);
+	}
+	CHECK_EQ(fake_hal.eeprom_write_count[EVSE_CONFIG_PAGE], writes_same);
+}
+
+// The communication watchdog restart writes a pending config change first
+static void test_watchdog_reset_flushes_config(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim_boot_and_settle();
+
+	api_set_boost_mode(false);
+	evse_sim_run_ms(1000*60*5 - EVSE_CONFIG_SAVE_DELAY/2);
+	CHECK_EQ(fake_hal.reset_count, 0);
+
+	// Config change without communication shortly before the watchdog triggers
+	evse.boost_mode_enabled = true;
+	evse_save_config();
+
+	jmp_buf reset;
+	fake_hal.reset_jmp = &reset;
+	if(setjmp(reset) == 0) {
+		evse_sim_run_ms(EVSE_CONFIG_SAVE_DELAY);
+	}
+	fake_hal.reset_jmp = NULL;
+
+	CHECK_EQ(fake_hal.reset_count, 1);
+	CHECK_EQ(fake_hal.eeprom[EVSE_CONFIG_PAGE][EVSE_CONFIG_BOOST_POS], 1);
+
+	evse_sim_boot();
+	CHECK(evse.boost_mode_enabled);
+}
+
+// The factory reset discards a pending config change instead of writing it
+static void test_factory_reset_discards_config(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim_boot_and_settle();
+
+	api_set_boost_mode(true);
+	evse_sim_run_ms(EVSE_CONFIG_SAVE_DELAY + 100);
+	CHECK_EQ(fake_hal.eeprom[EVSE_CONFIG_PAGE][EVSE_CONFIG_BOOST_POS], 1);
+
+	api_set_charging_slot_default(2, 16000, true, true);
+	const uint32_t writes = fake_hal.eeprom_write_count[EVSE_CONFIG_PAGE];
+
+	jmp_buf reset;
+	fake_hal.reset_jmp = &reset;
+	if(setjmp(reset) == 0) {
+		api_factory_reset();
+		evse_sim_run_ms(EVSE_CONFIG_SAVE_DELAY);
+	}
+	fake_hal.reset_jmp = NULL;
+
+	CHECK_EQ(fake_hal.reset_count, 1);
+	CHECK_EQ(fake_hal.eeprom_write_count[EVSE_CONFIG_PAGE], writes + 1);
+	for(uint16_t i = 0; i < EEPROM_PAGE_SIZE/sizeof(uint32_t); i++) {
+		CHECK_EQ(fake_hal.eeprom[EVSE_CONFIG_PAGE][i], 0);
+	}
+
+	evse_sim_boot();
+	CHECK(!evse.boost_mode_enabled);
+}
+
+int main(void) {
+	RUN_TEST(test_erase_count_stress);
+	RUN_TEST(test_watchdog_reset_flushes_config);
+	RUN_TEST(test_factory_reset_discards_config);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,146 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_contactor_off_latency.c: Tests of the contactor off latency measurement
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "configs/config_evse.h"
+#include "bricklib2/hal/system_timer/system_timer.h"
+
+#include "communication.h"
+#include "evse.h"
+#include "ads1118.h"
+#include "iec61851.h"
+
+#define LATENCY_TOLERANCE_MS 2
+
+static bool state_is_b(void) { return iec61851.state == IEC61851_STATE_B; }
+static bool state_is_c(void) { return iec61851.state == IEC61851_STATE_C; }
+static bool contactor_is_off(void) { return !XMC_GPIO_GetInput(EVSE_RELAY_PIN); }
+
+static void boot_state_c(const uint8_t mode) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = 220;
+	evse_sim.loop_time_ns  = 0;
+	evse_sim_boot_and_settle();
+
+	SetCPMeasurementMode message;
+	memset(&message, 0, sizeof(message));
+	message.mode = mode;
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_SET_CP_MEASUREMENT_MODE, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+
+	evse_sim.cp_resistance = 2700;
+	CHECK(evse_sim_run_until(state_is_b, 5000));
+	evse_sim.cp_resistance = 880;
+	CHECK(evse_sim_run_until(state_is_c, 5000));
+	evse_sim_run_ms(1000);
+	CHECK(XMC_GPIO_GetInput(EVSE_RELAY_PIN));
+	CHECK_EQ(ads1118.cp_state_c_exit_time, 0);
+	evse_reset_contactor_off_latency();
+}
+
+static void next_cp_sample(void) {
+	const uint16_t count = ads1118.cp_adc_sum_count;
+	while(ads1118.cp_adc_sum_count == count) {
+		evse_sim_loop();
+	}
+}
+
+// The latency is measured from the start of the integration window of the first
+// sample outside of state C. The simulated ADC uses the resistance at the end of the
+// conversion for the whole window, so if the car leaves right after a sample the
+// measured latency is the actual latency (otherwise it is within one window).
+static void check_latency(const uint8_t mode) {
+	boot_state_c(mode);
+	next_cp_sample();
+
+	const uint32_t exit_time = system_timer_get_ms();
+	evse_sim.cp_resistance = 2700;
+	CHECK(evse_sim_run_until(contactor_is_off, 1000));
+	const uint32_t latency = system_timer_get_ms() - exit_time;
+
+	printf("  mode %d: contactor off after %u ms, measured %u ms\n", mode, latency, evse.contactor_off_latency_last);
+	CHECK(evse.contactor_off_latency_last + LATENCY_TOLERANCE_MS >= latency);
+	CHECK(evse.contactor_off_latency_last <= latency + LATENCY_TOLERANCE_MS);
+	CHECK(evse.contactor_off_decision_latency_max <= evse.contactor_off_latency_last);
+}
+
+static void test_latency(void) {
+	check_latency(EVSE_CP_MEASUREMENT_MODE_FREE_RUNNING);
+	check_latency(EVSE_CP_MEASUREMENT_MODE_HIGH_RATE);
+}
+
+// A short excursion above the state B threshold that the moving average does not see.
+// The exit time stays latched until ADS1118_MOVING_AVERAGE_LENGTH samples are back in state C.
+static void test_exit_time_cleared_after_state_c_confirmed(void) {
+	boot_state_c(EVSE_CP_MEASUREMENT_MODE_FREE_RUNNING);
+
+	evse_sim.cp_resistance = 1900;
+	while(ads1118.cp_state_c_exit_time == 0) {
+		next_cp_sample();
+	}
+	evse_sim.cp_resistance = 880;
+
+	const uint32_t exit_time = ads1118.cp_state_c_exit_time;
+	uint8_t samples = 0;
+	while(ads1118.cp_state_c_exit_time != 0) {
+		CHECK_EQ(ads1118.cp_state_c_exit_time, exit_time);
+		next_cp_sample();
+		samples++;
+	}
+
+	// Up to two samples may still see the excursion
+	CHECK(samples >= 4 && samples <= 6);
+	CHECK_EQ(iec61851.state, IEC61851_STATE_C);
+	CHECK(XMC_GPIO_GetInput(EVSE_RELAY_PIN));
+}
+
+// A single sample in state C after the car left does not restart the measurement
+static void test_exit_time_kept_on_single_state_c_sample(void) {
+	boot_state_c(EVSE_CP_MEASUREMENT_MODE_FREE_RUNNING);
+	next_cp_sample();
+
+	const uint32_t exit_time = system_timer_get_ms();
+	evse_sim.cp_resistance = 2700;
+	while(ads1118.cp_state_c_exit_time == 0) {
+		next_cp_sample();
+	}
+
+	// One sample in state C in between
+	evse_sim.cp_resistance = 880;
+	next_cp_sample();
+	next_cp_sample();
+	evse_sim.cp_resistance = 2700;
+
+	CHECK(evse_sim_run_until(contactor_is_off, 1000));
+	const uint32_t latency = system_timer_get_ms() - exit_time;
+	CHECK(evse.contactor_off_latency_last + LATENCY_TOLERANCE_MS >= latency);
+}
+
+int main(void) {
+	RUN_TEST(test_latency);
+	RUN_TEST(test_exit_time_cleared_after_state_c_confirmed);
+	RUN_TEST(test_exit_time_kept_on_single_state_c_sample);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,70 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_evse_sim.c: Smoke test of the host simulation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "configs/config_evse.h"
+#include "iec61851.h"
+#include "evse.h"
+#include "ads1118.h"
+
+static bool state_is_b(void) { return iec61851.state == IEC61851_STATE_B; }
+static bool state_is_c(void) { return iec61851.state == IEC61851_STATE_C; }
+static bool state_is_a(void) { return iec61851.state == IEC61851_STATE_A; }
+
+static void test_boot_state_a(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = 220; // 32A cable
+	evse_sim_boot_and_settle();
+
+	CHECK(ads1118.version_found);
+	CHECK_EQ(iec61851.state, IEC61851_STATE_A);
+	CHECK(ads1118.cp_pe_resistance > 10000);
+	CHECK(ads1118.pp_pe_resistance > 200 && ads1118.pp_pe_resistance < 240);
+}
+
+static void test_charging_cycle(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = 220;
+	evse_sim_boot_and_settle();
+
+	evse_sim.cp_resistance = 2700;
+	CHECK(evse_sim_run_until(state_is_b, 5000));
+
+	evse_sim.cp_resistance = 880;
+	CHECK(evse_sim_run_until(state_is_c, 5000));
+	evse_sim_run_ms(1000);
+	CHECK(XMC_GPIO_GetInput(EVSE_RELAY_PIN));
+
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	CHECK(evse_sim_run_until(state_is_a, 5000));
+	evse_sim_run_ms(1000);
+	CHECK(!XMC_GPIO_GetInput(EVSE_RELAY_PIN));
+}
+
+int main(void) {
+	RUN_TEST(test_boot_state_a);
+	RUN_TEST(test_charging_cycle);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,222 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_iec61851_transitions.c: Exhaustive test of the IEC61851 transition table
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "configs/config_evse.h"
+#include "bricklib2/hal/ccu4_pwm/ccu4_pwm.h"
+#include "bricklib2/warp/contactor_check.h"
+
+#include "evse.h"
+#include "ads1118.h"
+#include "iec61851.h"
+#include "charging_slot.h"
+
+#define TEST_SLOT 10
+
+typedef struct {
+	IEC61851State state;
+	bool relay;
+	uint16_t duty_cycle;
+	bool no_current;
+	bool contactor_error;
+	bool jumper_invalid;
+	uint32_t resistance;
+} TransitionCase;
+
+// The if-cascade of iec61851_tick before the transition table,
+// plus the hysteresis for staying in A (1000 ohm) and B (200 ohm).
+static IEC61851State reference_next_state(const TransitionCase *c, const bool dwell_elapsed) {
+	IEC61851State next;
+	if(c->contactor_error || c->jumper_invalid) {
+		next = IEC61851_STATE_EF;
+	} else {
+		const bool id3_mode = (c->duty_cycle != 1000) && !c->relay;
+		if(id3_mode && (c->resistance > IEC61851_CP_RESISTANCE_STATE_A*3)) {
+			next = dwell_elapsed ? IEC61851_STATE_A : c->state;
+		} else if(!c->relay && !id3_mode && (c->resistance > IEC61851_CP_RESISTANCE_STATE_A - ((c->state == IEC61851_STATE_A) ? 1000 : 0))) {
+			next = IEC61851_STATE_A;
+		} else if(c->resistance > IEC61851_CP_RESISTANCE_STATE_B - ((c->state == IEC61851_STATE_B) ? 200 : 0)) {
+			next = IEC61851_STATE_B;
+		} else if(c->resistance > IEC61851_CP_RESISTANCE_STATE_C) {
+			next = c->no_current ? IEC61851_STATE_B : IEC61851_STATE_C;
+		} else if(c->resistance > IEC61851_CP_RESISTANCE_STATE_D) {
+			next = IEC61851_STATE_D;
+		} else {
+			next = IEC61851_STATE_EF;
+		}
+	}
+
+	// C is never entered directly from D or EF
+	if((next == IEC61851_STATE_C) && ((c->state == IEC61851_STATE_D) || (c->state == IEC61851_STATE_EF))) {
+		return c->state;
+	}
+
+	return next;
+}
+
+static ChargingSlot charging_slot_settled;
+
+// The state actions of an evaluation change relay and duty cycle,
+// for the dwell time test the inputs are applied again before each evaluation.
+static void setup_inputs(const TransitionCase *c) {
+	charging_slot = charging_slot_settled;
+	charging_slot_set_max_current(TEST_SLOT, 0);
+	charging_slot_set_active(TEST_SLOT, c->no_current);
+
+	if(c->relay) {
+		XMC_GPIO_SetOutputHigh(EVSE_RELAY_PIN);
+	} else {
+		XMC_GPIO_SetOutputLow(EVSE_RELAY_PIN);
+	}
+	ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, 64000 - c->duty_cycle*64);
+
+	contactor_check.error             = c->contactor_error ? 1 : 0;
+	evse.config_jumper_current        = c->jumper_invalid ? EVSE_CONFIG_JUMPER_SOFTWARE : EVSE_CONFIG_JUMPER_CURRENT_16A;
+	ads1118.cp_pe_resistance          = c->resistance;
+	ads1118.cp_settle.invalid_counter = 0;
+}
+
+static void setup_case(const TransitionCase *c) {
+	memset(iec61851.leave_time, 0, sizeof(iec61851.leave_time));
+	iec61851.state            = c->state;
+	iec61851.transition_index = 0xFF;
+
+	setup_inputs(c);
+}
+
+static void evaluate(void) {
+	iec61851_request_evaluation();
+	iec61851_tick();
+}
+
+static uint32_t resistances[1024];
+static uint16_t resistances_num;
+
+static void add_resistance(const uint32_t r) {
+	for(uint16_t i = 0; i < resistances_num; i++) {
+		if(resistances[i] == r) {
+			return;
+		}
+	}
+	resistances[resistances_num++] = r;
+}
+
+static void test_transitions_match_reference(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = 220;
+	evse_sim_boot_and_settle();
+	charging_slot_settled = charging_slot;
+
+	// Coarse grid plus every threshold (with and without hysteresis) +-2 ohm
+	resistances_num = 0;
+	for(uint32_t r = 0; r <= 40000; r += 100) {
+		add_resistance(r);
+	}
+	const uint32_t thresholds[] = {
+		IEC61851_CP_RESISTANCE_STATE_D, IEC61851_CP_RESISTANCE_STATE_C,
+		IEC61851_CP_RESISTANCE_STATE_B - 200, IEC61851_CP_RESISTANCE_STATE_B,
+		IEC61851_CP_RESISTANCE_STATE_A - 1000, IEC61851_CP_RESISTANCE_STATE_A,
+		IEC61851_CP_RESISTANCE_STATE_A*3
+	};
+	for(uint8_t i = 0; i < sizeof(thresholds)/sizeof(thresholds[0]); i++) {
+		for(int8_t d = -2; d <= 2; d++) {
+			add_resistance(thresholds[i] + d);
+		}
+	}
+	add_resistance(0xFFFF);
+
+	const uint16_t duty_cycles[] = {1000, 266};
+	uint32_t cases = 0;
+	uint32_t dwell_cases = 0;
+
+	for(uint8_t state = 0; state < IEC61851_STATE_NUM; state++) {
+		for(uint8_t inputs = 0; inputs < 32; inputs++) {
+			// Contactor error and invalid jumper are checked before anything else, one of them is enough
+			if((inputs & 0b11000) == 0b11000) {
+				continue;
+			}
+
+			for(uint16_t r = 0; r < resistances_num; r++) {
+				TransitionCase c = {
+					.state           = state,
+					.relay           = inputs & 1,
+					.duty_cycle      = duty_cycles[(inputs >> 1) & 1],
+					.no_current      = inputs & 4,
+					.contactor_error = inputs & 8,
+					.jumper_invalid  = inputs & 16,
+					.resistance      = resistances[r],
+				};
+
+				setup_case(&c);
+				evaluate();
+				REQUIRE_EQ(iec61851.state, reference_next_state(&c, false));
+				cases++;
+
+				// Transitions with dwell time
+				if(reference_next_state(&c, true) != reference_next_state(&c, false)) {
+					setup_case(&c);
+					evaluate();
+					fake_hal_advance_ns(2600*FAKE_HAL_NS_PER_MS);
+					setup_inputs(&c);
+					evaluate();
+					REQUIRE_EQ(iec61851.state, reference_next_state(&c, true));
+					dwell_cases++;
+				}
+			}
+		}
+	}
+
+	printf("%u cases, %u with dwell time\n", cases, dwell_cases);
+	CHECK(dwell_cases > 0);
+}
+
+// The unit must not stay in C with 0A, even if the resistance is within a former hysteresis band
+static void test_no_current_leaves_state_c(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = 220;
+	evse_sim_boot_and_settle();
+	charging_slot_settled = charging_slot;
+
+	for(uint32_t r = IEC61851_CP_RESISTANCE_STATE_C - 60; r <= IEC61851_CP_RESISTANCE_STATE_C + 60; r++) {
+		TransitionCase c = {
+			.state      = IEC61851_STATE_C,
+			.relay      = true,
+			.duty_cycle = 266,
+			.no_current = true,
+			.resistance = r,
+		};
+		setup_case(&c);
+		evaluate();
+		CHECK(iec61851.state != IEC61851_STATE_C);
+	}
+}
+
+int main(void) {
+	RUN_TEST(test_transitions_match_reference);
+	RUN_TEST(test_no_current_leaves_state_c);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,225 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_replay.c: Replay of the recorded logs against the virtual clock
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "evse_sim.h"
+#include "evse_log.h"
+
+#include "configs/config_evse.h"
+#include "bricklib2/utility/util_definitions.h"
+
+#include "communication.h"
+#include "evse.h"
+#include "ads1118.h"
+#include "iec61851.h"
+
+#define REPLAY_PASSWORD            0x4223B00B
+#define REPLAY_KEEP_ALIVE_INTERVAL 500 // ms, same as tests/replay.py
+#define REPLAY_LOOP_TIME_NS        (5*1000*1000)
+
+typedef struct {
+	uint32_t samples;
+	uint32_t mismatches;
+	uint32_t logged_changes;
+	uint32_t replayed_changes;
+	uint32_t duration_ms;
+} ReplayResult;
+
+static bool api_replay_sample(const uint32_t cp_pe_resistance, const uint32_t pp_pe_resistance, ReplaySample_Response *response) {
+	ReplaySample message;
+	message.password         = REPLAY_PASSWORD;
+	message.cp_pe_resistance = MIN(0xFFFF, cp_pe_resistance);
+	message.pp_pe_resistance = MIN(0xFFFF, pp_pe_resistance);
+	memset(response, 0, sizeof(ReplaySample_Response));
+	evse_sim_message(&message, sizeof(message), FID_REPLAY_SAMPLE, response);
+	return response->success;
+}
+
+// Same procedure as tests/replay.py, but the virtual clock follows the log timestamps
+static void replay_log(const char *path, ReplayResult *result) {
+	memset(result, 0, sizeof(ReplayResult));
+
+	EVSELog log;
+	CHECK(evse_log_read(path, &log));
+	if(log.num == 0) {
+		return;
+	}
+
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = EVSE_SIM_OPEN;
+	evse_sim.loop_time_ns  = REPLAY_LOOP_TIME_NS;
+	evse_sim_boot_and_settle();
+
+	// Pending samples (sequence number and logged state) that are not yet evaluated
+	uint32_t *pending_sequence = malloc(log.num*sizeof(uint32_t));
+	uint8_t  *pending_state    = malloc(log.num*sizeof(uint8_t));
+	uint32_t pending_first = 0;
+	uint32_t pending_num   = 0;
+
+	int16_t last_logged   = -1;
+	int16_t last_replayed = -1;
+
+	const uint64_t start_ns = fake_hal_get_time_ns();
+	uint64_t last_send_ns   = start_ns;
+	const EVSELogRow *last_row = &log.rows[0];
+
+	for(uint32_t i = 0; i <= log.num; i++) {
+		// One extra round at the end for the evaluation of the last sample
+		const EVSELogRow *row = (i < log.num) ? &log.rows[i] : last_row;
+		const uint64_t due_ns = start_ns + (row->time - log.rows[0].time)*100*FAKE_HAL_NS_PER_MS + ((i < log.num) ? 0 : 100*FAKE_HAL_NS_PER_MS);
+
+		while(fake_hal_get_time_ns() < due_ns) {
+			if(fake_hal_get_time_ns() - last_send_ns >= REPLAY_KEEP_ALIVE_INTERVAL*FAKE_HAL_NS_PER_MS) {
+				ReplaySample_Response response;
+				CHECK(api_replay_sample(last_row->cp_pe_resistance, last_row->pp_pe_resistance, &response));
+				last_send_ns = fake_hal_get_time_ns();
+			}
+			evse_sim_loop();
+		}
+
+		ReplaySample_Response response;
+		if(!api_replay_sample(row->cp_pe_resistance, row->pp_pe_resistance, &response)) {
+			CHECK(false);
+			break;
+		}
+		last_send_ns = fake_hal_get_time_ns();
+
+		while((pending_first < pending_num) && (pending_sequence[pending_first] <= response.evaluated_sample_sequence)) {
+			const uint8_t logged = pending_state[pending_first++];
+			result->samples++;
+			if(logged != response.iec61851_state) {
+				result->mismatches++;
+			}
+			if(logged != last_logged) {
+				result->logged_changes += (last_logged >= 0);
+				last_logged = logged;
+			}
+			if(response.iec61851_state != last_replayed) {
+				result->replayed_changes += (last_replayed >= 0);
+				last_replayed = response.iec61851_state;
+			}
+		}
+
+		if(i < log.num) {
+			pending_sequence[pending_num] = response.sample_sequence;
+			pending_state[pending_num]    = row->iec61851_state;
+			pending_num++;
+			last_row = row;
+		}
+	}
+
+	result->duration_ms = (fake_hal_get_time_ns() - start_ns)/FAKE_HAL_NS_PER_MS;
+
+	free(pending_sequence);
+	free(pending_state);
+	evse_log_free(&log);
+}
+
+static void check_replay(const char *path, const uint32_t logged_changes, const uint32_t replayed_changes, const uint32_t max_mismatches) {
+	ReplayResult result;
+	replay_log(path, &result);
+
+	printf("%s: %u samples in %u s, %u mismatches, %u/%u state changes (logged/replayed)\n",
+	       path, result.samples, result.duration_ms/1000, result.mismatches, result.logged_changes, result.replayed_changes);
+
+	CHECK(result.samples > 0);
+	CHECK_EQ(result.logged_changes, logged_changes);
+	CHECK_EQ(result.replayed_changes, replayed_changes);
+	CHECK(result.mismatches <= max_mismatches);
+
+	// The virtual clock makes the replay deterministic
+	ReplayResult result2;
+	replay_log(path, &result2);
+	CHECK(memcmp(&result, &result2, sizeof(ReplayResult)) == 0);
+}
+
+static void test_replay_log_erik(void) {
+	// C -> B
+	check_replay(EVSE_LOG_ERIK, 1, 1, 0);
+}
+
+static void test_replay_log_olaf(void) {
+	// Logged C -> B -> C -> A, replayed C -> B -> C -> B -> A:
+	// The logging EVSE had not switched the contactor on yet when the vehicle was
+	// disconnected and went to A directly. In the replay the virtual contactor is
+	// switched on immediately, so the state machine passes through B to switch it
+	// off (14 samples). B -> C is evaluated one sample later than on the logging EVSE.
+	check_replay(EVSE_LOG_OLAF, 3, 4, 15);
+}
+
+static bool state_is_b(void) { return iec61851.state == IEC61851_STATE_B; }
+
+static void test_replay_needs_disconnected_vehicle(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = 2700;
+	evse_sim.pp_resistance = 220;
+	evse_sim.loop_time_ns  = 0;
+	evse_sim_boot_and_settle();
+	CHECK(evse_sim_run_until(state_is_b, 2000));
+
+	ReplaySample_Response response;
+	CHECK(!api_replay_sample(EVSE_SIM_OPEN, EVSE_SIM_OPEN, &response));
+	CHECK(!ads1118.replay_active);
+}
+
+static void test_replay_stop_restores_state(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim.pp_resistance = 220;
+	evse_sim.loop_time_ns  = 0;
+	evse_sim_boot_and_settle();
+	CHECK_EQ(evse_get_cp_duty_cycle(), 1000);
+
+	// Replay a vehicle that starts charging
+	ReplaySample_Response response;
+	for(uint8_t i = 0; i < 20; i++) {
+		CHECK(api_replay_sample(880, 220, &response));
+		evse_sim_run_ms(200);
+	}
+	CHECK_EQ(iec61851.state, IEC61851_STATE_C);
+	CHECK(evse_get_contactor());
+	CHECK(!XMC_GPIO_GetInput(EVSE_RELAY_PIN));
+	CHECK(evse_get_cp_duty_cycle() != 1000);
+
+	// Timeout
+	evse_sim_run_ms(ADS1118_REPLAY_TIMEOUT + 50);
+	CHECK(!ads1118.replay_active);
+	CHECK_EQ(iec61851.state, IEC61851_STATE_A);
+	CHECK_EQ(evse_get_cp_duty_cycle(), 1000);
+	CHECK(!evse_get_contactor());
+
+	// The real measurements are used again after they settled
+	evse_sim_run_ms(2000);
+	CHECK_EQ(iec61851.state, IEC61851_STATE_A);
+	CHECK(ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_A);
+	CHECK(ads1118.pp_pe_resistance > 200 && ads1118.pp_pe_resistance < 240);
+}
+
+int main(void) {
+	RUN_TEST(test_replay_needs_disconnected_vehicle);
+	RUN_TEST(test_replay_stop_restores_state);
+	RUN_TEST(test_replay_log_erik);
+	RUN_TEST(test_replay_log_olaf);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,185 @@
+/* evse-bricklet
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * test_state_journal.c: Tests of the state journal EEPROM handling
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "evse_sim.h"
+
+#include "bricklib2/warp/contactor_check.h"
+
+#include "communication.h"
+#include "evse.h"
+#include "ads1118.h"
+#include "state_journal.h"
+
+static void api_set_user_calibration(void) {
+	SetUserCalibration message;
+	memset(&message, 0, sizeof(message));
+	message.password                = 0xCA11B4A0;
+	message.user_calibration_active = true;
+	message.voltage_diff            = -80;
+	message.voltage_mul             = 1001;
+	message.voltage_div             = 1000;
+	message.resistance_2700         = 12;
+	for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
+		message.resistance_880[i] = i - 7;
+	}
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_SET_USER_CALIBRATION, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+}
+
+static void check_user_calibration(void) {
+	CHECK(ads1118.cp_user_cal_active);
+	CHECK_EQ(ads1118.cp_user_cal_diff_voltage, -80);
+	CHECK_EQ(ads1118.cp_user_cal_mul, 1001);
+	CHECK_EQ(ads1118.cp_user_cal_div, 1000);
+	CHECK_EQ(ads1118.cp_user_cal_2700ohm, 12);
+	for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
+		CHECK_EQ(ads1118.cp_user_cal_880ohm[i], i - 7);
+	}
+}
+
+static void api_set_boost_mode(const bool boost_mode_enabled) {
+	SetBoostMode message;
+	memset(&message, 0, sizeof(message));
+	message.boost_mode_enabled = boost_mode_enabled;
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_SET_BOOST_MODE, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+}
+
+static void api_reset_state_journal(const bool clear_eeprom) {
+	ResetStateJournal message;
+	memset(&message, 0, sizeof(message));
+	message.clear_eeprom = clear_eeprom;
+	CHECK_EQ(evse_sim_message(&message, sizeof(message), FID_RESET_STATE_JOURNAL, NULL), HANDLE_MESSAGE_RESPONSE_EMPTY);
+}
+
+static void freeze_journal(void) {
+	contactor_check.error = 1;
+	evse_sim_run_ms(100);
+	contactor_check.error = 0;
+}
+
+static void boot_calibrated(void) {
+	fake_hal_eeprom_erase();
+	evse_sim.cp_resistance = EVSE_SIM_OPEN;
+	evse_sim_boot_and_settle();
+	CHECK(!state_journal.frozen);
+	api_set_user_calibration();
+	api_set_boost_mode(true);
+	evse_sim_run_ms(EVSE_CONFIG_SAVE_DELAY + 100);
+	CHECK(!evse.config_save_pending);
+}
+
+static void test_journal_fits_in_front_of_slot_defaults(void) {
+	CHECK(STATE_JOURNAL_PAGE_POS*sizeof(uint32_t) + sizeof(StateJournalPage) <= EVSE_CONFIG_SLOT_DEFAULT_POS*sizeof(uint32_t));
+	CHECK(STATE_JOURNAL_PAGE_POS > EVSE_CONFIG_BOOST_POS);
+}
+
+static void test_flush_keeps_config(void) {
+	boot_calibrated();
+
+	freeze_journal();
+	CHECK(state_journal.frozen);
+	CHECK(state_journal_get_length(STATE_JOURNAL_SOURCE_EEPROM) > 0);
+
+	evse_sim_boot();
+	check_user_calibration();
+	CHECK(evse.boost_mode_enabled);
+	CHECK(state_journal_get_length(STATE_JOURNAL_SOURCE_EEPROM) > 0);
+}
+
+static void test_config_save_keeps_journal(void) {
+	boot_calibrated();
+
+	freeze_journal();
+	const uint16_t length = state_journal_get_length(STATE_JOURNAL_SOURCE_EEPROM);
+	CHECK(length > 0);
+
+	api_set_boost_mode(false);
+	evse_sim_run_ms(EVSE_CONFIG_SAVE_DELAY + 100);
+	CHECK(!evse.config_save_pending);
+
+	evse_sim_boot();
+	CHECK(!evse.boost_mode_enabled);
+	CHECK_EQ(state_journal_get_length(STATE_JOURNAL_SOURCE_EEPROM), length);
+}
+
+static void test_calibration_pages_not_written(void) {
+	boot_calibrated();
+	const uint32_t calibration_writes      = fake_hal.eeprom_write_count[EVSE_CALIBRATION_PAGE];
+	const uint32_t user_calibration_writes = fake_hal.eeprom_write_count[EVSE_USER_CALIBRATION_PAGE];
+	CHECK_EQ(calibration_writes, 0);
+
+	freeze_journal();
+	api_reset_state_journal(true);
+	CHECK_EQ(state_journal_get_length(STATE_JOURNAL_SOURCE_EEPROM), 0);
+	freeze_journal();
+	evse_sim_boot();
+
+	CHECK_EQ(fake_hal.eeprom_write_count[EVSE_CALIBRATION_PAGE], calibration_writes);
+	CHECK_EQ(fake_hal.eeprom_write_count[EVSE_USER_CALIBRATION_PAGE], user_calibration_writes);
+}
+
+static void test_unchanged_journal_not_written(void) {
+	boot_calibrated();
+
+	// Clearing an already cleared journal does not erase the page
+	api_reset_state_journal(true);
+	const uint32_t config_writes = fake_hal.eeprom_write_count[EVSE_CONFIG_PAGE];
+	api_reset_state_journal(true);
+	CHECK_EQ(fake_hal.eeprom_write_count[EVSE_CONFIG_PAGE], config_writes);
+
+	freeze_journal();
+	CHECK_EQ(fake_hal.eeprom_write_count[EVSE_CONFIG_PAGE], config_writes + 1);
+}
+
+static void test_power_loss_during_flush(void) {
+	boot_calibrated();
+
+	// Power loss right after the erase of the journal page
+	fake_hal.eeprom_power_loss_countdown = 1;
+	freeze_journal();
+	CHECK(fake_hal.eeprom_power_lost);
+	CHECK_EQ(fake_hal.eeprom[EVSE_CONFIG_PAGE][EVSE_CONFIG_MAGIC_POS], 0xFFFFFFFF);
+
+	// The calibration survives, the config falls back to the defaults and the journal is lost
+	evse_sim_boot();
+	check_user_calibration();
+	CHECK(!evse.boost_mode_enabled);
+	CHECK_EQ(state_journal_get_length(STATE_JOURNAL_SOURCE_EEPROM), 0);
+
+	// The journal works again
+	freeze_journal();
+	CHECK(state_journal_get_length(STATE_JOURNAL_SOURCE_EEPROM) > 0);
+	evse_sim_boot();
+	check_user_calibration();
+	CHECK(state_journal_get_length(STATE_JOURNAL_SOURCE_EEPROM) > 0);
+}
+
+int main(void) {
+	RUN_TEST(test_journal_fits_in_front_of_slot_defaults);
+	RUN_TEST(test_flush_keeps_config);
+	RUN_TEST(test_config_save_keeps_journal);
+	RUN_TEST(test_calibration_pages_not_written);
+	RUN_TEST(test_unchanged_journal_not_written);
+	RUN_TEST(test_power_loss_during_flush);
+	TEST_MAIN_END();
+}
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Replays a log recorded with log.py (e.g. log_erik.csv or log_olaf.csv)
+# through the IEC61851 state machine of a connected EVSE Bricklet.
+#
+# The EVSE uses the CP/PE and PP/PE resistances of the log instead of its own
+# ADC measurements and only switches the contactor virtually (the relay stays off).
+# The resulting state sequence is compared with the logged state sequence.
+#
+# The state machine uses real time (e.g. 5s/30s hold off times), so the
+# log is replayed with the original timing. A speed factor > 1 replays
+# faster, but then state changes that depend on timeouts may differ.
+# software/test/test_replay.c replays the logs deterministically against
+# the virtual clock of the host build.
+#
+# When the replay ends, the EVSE starts over in state A with its own measurements.
+#
+# Usage: ./replay.py log_erik.csv [speed]
+
+HOST = "localhost"
+PORT = 4223
+UID  = "XYZ" # Change XYZ to the UID of your EVSE Bricklet
+
+from tinkerforge.ip_connection import IPConnection
+from tinkerforge.bricklet_evse import BrickletEVSE
+
+import csv
+import sys
+import time
+import difflib
+
+LOW_LEVEL_PASSWORD = 0x4223B00B
+
+FUNCTION_REPLAY_SAMPLE = 44
+FUNCTION_STOP_REPLAY   = 45
+
+KEEP_ALIVE_INTERVAL = 0.5 # The EVSE stops the replay after 1s without sample
+
+STATE_NAMES = ['A', 'B', 'C', 'D', 'EF']
+
+def replay_sample(evse, cp_pe_resistance, pp_pe_resistance):
+    return evse.ipcon.send_request(evse, FUNCTION_REPLAY_SAMPLE, (LOW_LEVEL_PASSWORD, min(cp_pe_resistance, 0xFFFF), min(pp_pe_resistance, 0xFFFF)), 'I H H', 21, '! B H ! I I')
+
+def stop_replay(evse):
+    evse.ipcon.send_request(evse, FUNCTION_STOP_REPLAY, (), '', 0, '')
+
+def state_runs(states):
+    runs = []
+    for state in states:
+        if len(runs) == 0 or runs[-1] != state:
+            runs.append(state)
+    return runs
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("Usage: {0} <log.csv> [speed]".format(sys.argv[0]))
+        sys.exit(1)
+
+    speed = float(sys.argv[2]) if len(sys.argv) > 2 else 1.0
+
+    with open(sys.argv[1]) as f:
+        rows = [(int(row['Time'])/10.0, int(row['Resistance CP/PE']), int(row['Resistance PP/PE']), int(row['IEC61851 State'])) for row in csv.DictReader(f)]
+
+    ipcon = IPConnection() # Create IP connection
+    evse = BrickletEVSE(UID, ipcon) # Create device object
+
+    ipcon.connect(HOST, PORT) # Connect to brickd
+    # Don't use device before ipcon is connected
+
+    logged   = []
+    replayed = []
+    pending  = [] # (sample sequence, logged state) of samples that are not yet evaluated
+
+    def handle_response(response):
+        success, state, duty_cycle, contactor, sequence, evaluated_sequence = response
+        if not success:
+            raise Exception("Replay not possible (relay is on or vehicle connected?)")
+
+        while len(pending) > 0 and pending[0][0] <= evaluated_sequence:
+            logged.append(pending.pop(0)[1])
+            replayed.append(state)
+
+        return sequence
+
+    try:
+        replay_start = time.time()
+        log_start    = rows[0][0]
+        last_send    = 0
+        last_row     = rows[0]
+
+        for i, row in enumerate(rows):
+            # Wait until the sample is due, keep the replay alive in between with the last sample
+            while True:
+                now = time.time()
+                due = replay_start + (row[0] - log_start)/speed
+                if now >= due:
+                    break
+
+                if now - last_send > KEEP_ALIVE_INTERVAL:
+                    handle_response(replay_sample(evse, last_row[1], last_row[2]))
+                    last_send = now
+
+                time.sleep(min(due - now, KEEP_ALIVE_INTERVAL))
+
+            sequence = handle_response(replay_sample(evse, row[1], row[2]))
+            pending.append((sequence, row[3]))
+            last_send = time.time()
+            last_row  = row
+
+            if i % 1000 == 0:
+                print("{0}/{1} samples".format(i, len(rows)))
+
+        # Let the last sample be evaluated
+        time.sleep(0.1)
+        handle_response(replay_sample(evse, last_row[1], last_row[2]))
+        duration = time.time() - replay_start
+    finally:
+        stop_replay(evse)
+        ipcon.disconnect()
+
+    mismatches = sum(1 for l, r in zip(logged, replayed) if l != r)
+    print("")
+    print("Samples:    {0} in {1:.1f}s ({2:.1f} samples/s)".format(len(logged), duration, len(logged)/duration))
+    print("Mismatches: {0} ({1:.2f}%)".format(mismatches, 100.0*mismatches/max(1, len(logged))))
+
+    logged_runs   = [STATE_NAMES[s] for s in state_runs(logged)]
+    replayed_runs = [STATE_NAMES[s] for s in state_runs(replayed)]
+    print("State changes: logged {0}, replayed {1}".format(len(logged_runs) - 1, len(replayed_runs) - 1))
+
+    for tag, i1, i2, j1, j2 in difflib.SequenceMatcher(a=logged_runs, b=replayed_runs, autojunk=False).get_opcodes():
+        if tag != 'equal':
+            print(" {0:7s} logged {1} -> replayed {2}".format(tag, '-'.join(logged_runs[max(0, i1-1):i2+1]), '-'.join(replayed_runs[max(0, j1-1):j2+1])))
+
+    sys.exit(0 if len(logged_runs) == len(replayed_runs) and mismatches == 0 else 1)